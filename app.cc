@@ -1,13 +1,28 @@
 // app.cc
 #include <nan.h>
 #include "node_ecies_wrapper.h"
+#include "node_ecies_stream.h"
+#include "node_ecies_session.h"
+#include "node_ecies_keyring.h"
+#include "node_ecies_stats.h"
+#include "node_ecies_pool.h"
+#include "node_ecies_engine.h"
+#include "node_ecies_codec.h"
 
 namespace node_ecies {
 
 void InitAll(v8::Local<v8::Object> exports) {
 	ECIESWrapper::Init(exports);
+	ECIESStream::Init(exports);
+	ECIESSession::Init(exports);
+	Keyring::Init(exports);
+	Stats::Init(exports);
+	EphemeralPool::Init(exports);
+	ECIESEngine::Init(exports);
+	Codec::Init(exports);
 }
 
-NODE_MODULE(addon, InitAll)
+// Context-aware, so the addon may be loaded by worker_threads
+NAN_MODULE_WORKER_ENABLED(addon, InitAll)
 
 }  // namespace node_ecies
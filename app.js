@@ -31,6 +31,11 @@ var clientKeys = {
 console.log(obj.setClientPublicKey(clientKeys.pub.x, clientKeys.pub.y));
 console.log(obj.setPrivateKey(serverKeys.priv));
 
+// Dedicated engine with its own threads, built once and shared; engine.close() when done
+// var engine = new addon.ECIESEngine(4);
+// engine.setClientPublicKey(clientKeys.pub.x, clientKeys.pub.y);
+// engine.setPrivateKey(serverKeys.priv);
+
 setInterval(function() {
     // Encryption
     // var data = "test text";
@@ -55,6 +60,40 @@ setInterval(function() {
 
     // assert.deepEqual(decrypted, buf);
 
+    // Compact header, 30 bytes of overhead instead of 56
+    // var compact = obj.encrypt(buf, true);
+    // assert.deepEqual(obj.decrypt(compact, Buffer.byteLength(buf)), buf);
+
+    // Segments are encrypted and decrypted in place, without concatenating them
+    // var enc = obj.encryptIov([buf.slice(0, 4), buf.slice(4)]);
+    // assert.deepEqual(obj.decryptIov([enc.slice(0, 30), enc.slice(30)], buf.length), buf);
+
+    // Keyed header, a Keyring of many private keys picks the right one by its ID
+    // var ring = new addon.Keyring();
+    // ring.add(serverKeys.priv);
+    // assert.deepEqual(ring.decrypt(obj.encrypt(buf, 'keyed')), buf);
+
+    // Session, one handshake and then a few microseconds per message
+    // var client = new addon.ECIESSession(), server = new addon.ECIESSession();
+    // server.accept(client.start(serverKeys.pub.x, serverKeys.pub.y), serverKeys.priv);
+    // assert.deepEqual(server.open(client.seal(buf)), buf);
+    // assert.deepEqual(client.open(server.seal(buf)), buf);
+
+    // Packed container, no lengths needed
+    // var packed = obj.encryptPacked([buf, buf]);
+    // var batch = obj.decryptPacked(packed);
+    // console.log(batch.data.slice(batch.offsets[0], batch.offsets[1]), batch.status);
+
+    // Dedicated engine, results come back in batches
+    // engine.encrypt(buf, (err, enc) => engine.decrypt(enc, (err, dec) => console.log(dec)));
+
+    // Build profile and table sizes
+    // console.log(addon.getConfig());
+
+    // Text forms for JSON and logs
+    // var text = addon.base64Encode(encrypted);
+    // assert.deepEqual(addon.base64Decode(text), encrypted);
+
 }, 500);
 
 
@@ -0,0 +1,372 @@
+/*
+  Microbenchmarks of the ecc.c internals, one primitive at a time.
+
+  ecc.c is included, so the static field, point and XTEA functions are
+  reachable. Every primitive runs for a calibrated number of iterations per
+  repetition, on one pinned CPU, and the per-call cost of the fastest and of
+  the median repetition is printed as JSON. Sizes are bytes for the XTEA
+  modes and exponent bits for point_mult, 0 for fixed-size primitives.
+
+  Usage: bench [-c cpu] [-r reps] [-t ms] [name...]
+*/
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "ecc.c"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CLOCK "tsc"
+#else
+#define BENCH_CLOCK "ns"
+#endif
+
+#define BENCH_MAX_SIZE (1024*1024)
+
+/* the state the kernels chain through, so nothing gets optimised away */
+static struct {
+  elem_t x, y;
+  exp_t exp;
+  uint32_t k[4];
+  ECIES_byte_t key[16];
+  ECIES_byte_t k1[16], k2[16];
+  ECIES_byte_t *data;
+  ECIES_session_t ses, peer;
+  ECIES_byte_t frame[8192 + ECIES_SESSION_OVERHEAD];
+} st;
+
+static volatile uint32_t bench_sink;
+
+typedef struct {
+  const char *name;
+  void (*run)(unsigned long n, size_t size);
+  const size_t *sizes; /* zero terminated, NULL for fixed size */
+} bench_t;
+
+static const size_t exp_bits[] = { 16, 32, 64, 128, ECIES_DEGREE, 0 };
+static const size_t data_sizes[] = { 8, 64, 256, 1024, 8192, 65536, BENCH_MAX_SIZE, 0 };
+static const size_t frame_sizes[] = { 8, 64, 256, 1024, 8192, 0 };
+
+static void run_field_mult(unsigned long n, size_t size){
+  for(; n > 0; n--){
+    field_mult(st.x, st.x, st.y);
+  }
+  bench_sink = st.x[0];
+}
+
+static void run_field_invert(unsigned long n, size_t size){
+  for(; n > 0; n--){
+    field_invert(st.x, st.x);
+  }
+  bench_sink = st.x[0];
+}
+
+static void run_point_double(unsigned long n, size_t size){
+  for(; n > 0; n--){
+    point_double(st.x, st.y);
+  }
+  bench_sink = st.x[0];
+}
+
+static void run_point_add(unsigned long n, size_t size){
+  for(; n > 0; n--){
+    point_add(st.x, st.y, base_x, base_y);
+  }
+  bench_sink = st.x[0];
+}
+
+static void run_point_mult(unsigned long n, size_t size){
+  elem_t x, y;
+
+  point_copy(x, y, base_x, base_y);
+
+  for(; n > 0; n--){
+    point_copy(x, y, base_x, base_y);
+    point_mult(x, y, st.exp);
+    st.exp[0] ^= x[0] & 1;
+  }
+  bench_sink = x[0];
+}
+
+#if ECIES_LANES
+/* one ladder, ECIES_LANES multiplications; the time is per ladder */
+static void run_point_mult_lanes(unsigned long n, size_t size){
+  elem_t x[ECIES_LANES];
+  exp_t k[ECIES_LANES];
+  int res[ECIES_LANES], l;
+
+  for(l = 0; l < ECIES_LANES; l++){
+    bitstr_copy(x[l], base_x);
+    bitstr_copy(k[l], st.exp);
+    k[l][0] ^= l;
+  }
+
+  for(; n > 0; n--){
+    for(l = 0; l < ECIES_LANES; l++){
+      bitstr_copy(x[l], base_x);
+    }
+    point_mult_lanes(res, x, k);
+    k[0][0] ^= x[0][0] & 1;
+  }
+  bench_sink = x[0][0] ^ res[0];
+}
+#endif
+
+static void run_point_decompress(unsigned long n, size_t size){
+  elem_t y;
+
+  bitstr_clear(y);
+
+  for(; n > 0; n--){
+    point_decompress(y, base_x, st.exp[0] & 1);
+    st.exp[0] ^= y[0] & 1;
+  }
+  bench_sink = y[0];
+}
+
+static void run_kdf(unsigned long n, size_t size){
+  for(; n > 0; n--){
+    ECIES_kdf(st.k1, st.k2, st.x, base_x, base_y);
+    st.x[0] ^= st.k1[0];
+  }
+  bench_sink = st.k2[0];
+}
+
+static void run_encipher_block(unsigned long n, size_t size){
+  for(; n > 0; n--){
+    XTEA_encipher_block(st.data, st.k);
+  }
+  bench_sink = st.data[0];
+}
+
+static void run_ctr_crypt(unsigned long n, size_t size){
+  for(; n > 0; n--){
+    XTEA_ctr_crypt(st.data, size, st.key, 0);
+  }
+  bench_sink = st.data[0];
+}
+
+static void run_cbcmac(unsigned long n, size_t size){
+  for(; n > 0; n--){
+    XTEA_cbcmac(st.k1, st.data, size, st.key, 0);
+  }
+  bench_sink = st.k1[0];
+}
+
+/* one message there, the whole per-message cost of a session */
+static void run_session_frame(unsigned long n, size_t size){
+  for(; n > 0; n--){
+    ECIES_session_seal(&st.ses, st.frame, (char*)st.data, size);
+    ECIES_session_open(&st.peer, (char*)st.data, st.frame, size);
+  }
+  bench_sink = st.data[0];
+}
+
+static const bench_t benches[] = {
+  { "field_mult", run_field_mult, NULL },
+  { "field_invert", run_field_invert, NULL },
+  { "point_double", run_point_double, NULL },
+  { "point_add", run_point_add, NULL },
+  { "point_mult", run_point_mult, exp_bits },
+#if ECIES_LANES
+  { "point_mult_lanes", run_point_mult_lanes, NULL },
+#endif
+  { "point_decompress", run_point_decompress, NULL },
+  { "ECIES_kdf", run_kdf, NULL },
+  { "XTEA_encipher_block", run_encipher_block, NULL },
+  { "XTEA_ctr_crypt", run_ctr_crypt, data_sizes },
+  { "XTEA_cbcmac", run_cbcmac, data_sizes },
+  { "session_frame", run_session_frame, frame_sizes },
+};
+
+#define BENCHES (sizeof(benches) / sizeof(benches[0]))
+
+static uint64_t bench_ns(void){
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* the tsc is read after everything before it retired */
+static uint64_t bench_ticks(void){
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_lfence();
+  return __rdtsc();
+#else
+  return bench_ns();
+#endif
+}
+
+/* ticks per ns, measured over a short sleep */
+static double bench_calibrate(void){
+  struct timespec delay = { 0, 50000000 };
+  uint64_t t0 = bench_ticks(), n0 = bench_ns(), t1, n1;
+
+  nanosleep(&delay, NULL);
+  t1 = bench_ticks();
+  n1 = bench_ns();
+
+  return (double)(t1 - t0) / (double)(n1 - n0);
+}
+
+/* stay on one CPU, so the caches and the clock don't change under a run */
+static int bench_pin(int cpu){
+#ifdef __linux__
+  cpu_set_t set;
+
+  if(cpu < 0){
+    cpu = sched_getcpu();
+  }
+
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+
+  if(sched_setaffinity(0, sizeof(set), &set) < 0){
+    fprintf(stderr, "Cannot pin to CPU %d\n", cpu);
+    return -1;
+  }
+
+  return cpu;
+#else
+  return -1;
+#endif
+}
+
+static void bench_reset(size_t bits){
+  size_t i;
+
+  point_copy(st.x, st.y, base_x, base_y);
+
+  /* a random exponent of exactly 'bits' bits */
+  bitstr_clear(st.exp);
+  for(i = 0; i < bits; i++){
+    if(i == bits - 1 || (random() & 1)){
+      bitstr_setbit(st.exp, i);
+    }
+  }
+
+  for(i = 0; i < BENCH_MAX_SIZE; i++){
+    st.data[i] = random();
+  }
+
+  /* the two ends of a session on the bench key, fresh sequence numbers */
+  memset(&st.ses, 0, sizeof(st.ses));
+  memcpy(st.ses.stm.k1, st.key, 16);
+  memcpy(st.ses.stm.k2, st.key, 16);
+  st.peer = st.ses;
+  st.peer.dir = SESSION_RESPONDER;
+}
+
+static int bench_cmp(const void *a, const void *b){
+  uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+
+  return x < y ? -1 : x > y;
+}
+
+static void bench_one(const bench_t *b, size_t size, int reps, uint64_t target, double tpns, int *first){
+  uint64_t ticks[64], t;
+  unsigned long n = 1;
+  double med;
+  int r;
+
+  bench_reset(b->sizes == exp_bits ? size : ECIES_DEGREE);
+
+  /* warm up and find the iterations per repetition */
+  for(; ; n *= 2){
+    t = bench_ticks();
+    b->run(n, size);
+    t = bench_ticks() - t;
+    if(t >= target / 4){
+      break;
+    }
+  }
+
+  n = (unsigned long)((double)n * target / t) + 1;
+
+  for(r = 0; r < reps; r++){
+    t = bench_ticks();
+    b->run(n, size);
+    ticks[r] = bench_ticks() - t;
+  }
+
+  qsort(ticks, reps, sizeof(ticks[0]), bench_cmp);
+  med = (double)ticks[reps / 2] / n;
+
+  printf("%s    {\"name\": \"%s\", \"size\": %zu, \"iters\": %lu, \"ticks_min\": %.1f, \"ticks_median\": %.1f, \"ns_median\": %.1f",
+         *first ? "" : ",\n", b->name, size, n, (double)ticks[0] / n, med, med / tpns);
+  if(b->sizes == data_sizes){
+    printf(", \"ticks_per_byte\": %.2f, \"mb_s\": %.1f", med / size, size * tpns * 1000 / med);
+  }
+  printf("}");
+
+  *first = 0;
+}
+
+int main(int argc, const char *argv[]){
+  int cpu = -1, reps = 7, millis = 20, first = 1, i, j, k;
+  const size_t fixed[] = { 0, 0 };
+  const size_t *size;
+  double tpns;
+
+  for(i = 1; i < argc && argv[i][0] == '-'; i++){
+    if(!strcmp(argv[i], "-c") && i + 1 < argc){
+      cpu = atoi(argv[++i]);
+    }else if(!strcmp(argv[i], "-r") && i + 1 < argc){
+      reps = atoi(argv[++i]);
+    }else if(!strcmp(argv[i], "-t") && i + 1 < argc){
+      millis = atoi(argv[++i]);
+    }else{
+      break;
+    }
+  }
+
+  if(i < argc && argv[i][0] == '-'){
+    fprintf(stderr, "Usage: %s [-c cpu] [-r reps] [-t ms] [name...]\n", argv[0]);
+    return 1;
+  }
+
+  if(reps < 1 || reps > 64 || millis < 1){
+    fprintf(stderr, "Out of range\n");
+    return 1;
+  }
+
+  if(!(st.data = malloc(BENCH_MAX_SIZE))){
+    return 1;
+  }
+
+  srandom(1);
+  memcpy(st.key, "benchmark key 16", 16);
+  XTEA_init_key(st.k, st.key);
+
+  cpu = bench_pin(cpu);
+  tpns = bench_calibrate();
+
+  printf("{\n  \"clock\": \"%s\", \"ticks_per_ns\": %.3f, \"cpu\": %d, \"reps\": %d,\n  \"results\": [\n",
+         BENCH_CLOCK, tpns, cpu, reps);
+
+  for(j = 0; j < (int)BENCHES; j++){
+    /* only the named ones, when given */
+    for(k = i; k < argc && strcmp(argv[k], benches[j].name); k++);
+    if(i < argc && k == argc){
+      continue;
+    }
+
+    for(size = benches[j].sizes ? benches[j].sizes : fixed; ; size++){
+      bench_one(&benches[j], *size, reps, (uint64_t)(millis * 1e6 * tpns), tpns, &first);
+      if(!benches[j].sizes || !size[1]){
+        break;
+      }
+    }
+  }
+
+  printf("\n  ]\n}\n");
+
+  free(st.data);
+
+  return 0;
+}
@@ -4,8 +4,19 @@
 		"sources": [
 			"app.cc",
 			"node_ecies_wrapper.cc",
+			"node_ecies_stream.cc",
+			"node_ecies_session.cc",
+			"node_ecies_keyring.cc",
+			"node_ecies_keytable.cc",
+			"node_ecies_stats.cc",
+			"node_ecies_pool.cc",
+			"node_ecies_engine.cc",
+			"node_ecies_codec.cc",
 			"ecc.c",
 			"hex.c",
+			"keyring.c",
+			"pack.c",
+			"pool.c",
 			# "apps/myApps/RPi_VREX/src/EyeTracker/EyeTracker.cpp",
 			# "apps/myApps/RPi_VREX/src/EyeTracker/Calibration.cpp",
 			# "apps/myApps/RPi_VREX/src/EyeTracker/imageProc/PupilDetector.cpp",
@@ -58,6 +69,8 @@
 		"cflags_cc!": [ "-fno-rtti", "-fno-exceptions" ],
 		"cflags": [ 
 			# "-D__VREX__",
+			# "-DECIES_PROFILING=1",
+			# "-DECIES_CONFIG_PROFILE=ECIES_PROFILE_TINY",
 			# "-std=c++11" 
 			]
 	}]
@@ -0,0 +1,800 @@
+/*
+  Differential tests of the ecc.c kernels against the frozen reference in
+  ecc_ref.c, plus known-answer vectors of ECIES_encrypt. Sessions, keyrings
+  and framed streams are checked against what they must accept and reject.
+
+  Every test case is decoded from a byte string: the first byte picks the
+  kernel, the rest gives its operands. The random mode feeds it random
+  strings, the fuzz build feeds it whatever libFuzzer finds, so any input
+  that breaks a kernel can be replayed in both.
+
+  Usage: difftest [-n cases] [-s seed]
+         difftest --print-kat   (the vectors of the current code, only for a
+                                 deliberate change of the wire format)
+
+  libFuzzer target, aborts on the first mismatch:
+
+    make difftest-fuzz
+*/
+
+#include <stdio.h>
+
+#include "ecc.c"
+#include "ecc_ref.h"
+#include "keyring.h"
+
+/* the curve points the point tests start from, k * G for fixed k */
+#define POINTS 8
+
+static struct {
+  int ready;
+  elem_t x[POINTS], y[POINTS];
+  ECIES_pubkey_table_t *tab[POINTS];
+} points;
+
+static unsigned long failures;
+
+/* the operands, read from the test case, zeros past its end */
+typedef struct {
+  const uint8_t *p;
+  size_t n;
+} src_t;
+
+static uint8_t src_byte(src_t *src){
+  if(src->n == 0){
+    return 0;
+  }
+  src->n--;
+  return *src->p++;
+}
+
+static void src_bytes(src_t *src, void *buf, size_t len){
+  uint8_t *b = buf;
+
+  for(; len > 0; len--){
+    *b++ = src_byte(src);
+  }
+}
+
+/* a field element, or often a corner case */
+static void src_elem(src_t *src, elem_t e){
+  switch(src_byte(src) % 8){
+  case 0:
+    bitstr_clear(e);
+    break;
+  case 1:
+    field_set1(e);
+    break;
+  default:
+    src_bytes(src, e, sizeof(elem_t));
+    e[ECIES_NUMWORDS - 1] &= ((uint32_t)1 << (ECIES_DEGREE % 32)) - 1;
+  }
+}
+
+/* an exponent of any length up to the field size */
+static void src_exp(src_t *src, exp_t e){
+  int bits = src_byte(src) % (ECIES_DEGREE + 1), i;
+
+  src_bytes(src, e, sizeof(exp_t));
+  for(i = bits; i < 32 * ECIES_NUMWORDS; i++){
+    bitstr_clrbit(e, i);
+  }
+}
+
+static void points_init(void){
+  exp_t k;
+  int i;
+
+  if(points.ready){
+    return;
+  }
+
+  for(i = 0; i < POINTS; i++){
+    bitstr_clear(k);
+    k[0] = 0x9e3779b9 * (i + 1);
+    k[3] = 0x7f4a7c15 ^ i;
+    point_copy(points.x[i], points.y[i], base_x, base_y);
+    ref_point_mult(points.x[i], points.y[i], k);
+  }
+
+  points.ready = 1;
+}
+
+/* a point on the curve: the zero point, a pool point, its negation or the base */
+static void src_point(src_t *src, elem_t x, elem_t y){
+  uint8_t sel = src_byte(src);
+  int i = (sel >> 2) % POINTS;
+
+  switch(sel & 3){
+  case 0:
+    point_set_zero(x, y);
+    break;
+  case 1:
+    point_copy(x, y, points.x[i], points.y[i]);
+    break;
+  case 2:
+    point_copy(x, y, points.x[i], points.y[i]);
+    field_add(y, y, x);
+    break;
+  default:
+    point_copy(x, y, base_x, base_y);
+  }
+}
+
+static void fail(const char *name, const uint8_t *data, size_t size){
+  size_t i;
+
+  fprintf(stderr, "MISMATCH %s, case ", name);
+  for(i = 0; i < size; i++){
+    fprintf(stderr, "%02x", data[i]);
+  }
+  fprintf(stderr, "\n");
+
+#ifdef DIFFTEST_FUZZ
+  abort();
+#endif
+
+  failures++;
+}
+
+#define CHECK(name, ok) MACRO( if (! (ok)) fail(name, data, size) )
+
+/* a deterministic RNG, xorshift64*, never stuck at zero */
+static void xorshift_rng(void *ctx, ECIES_byte_t *buf, ECIES_size_t len){
+  uint64_t *s = ctx;
+
+  for(; len > 0; len--){
+    *s ^= *s >> 12;
+    *s ^= *s << 25;
+    *s ^= *s >> 27;
+    *buf++ = (*s * 0x2545f4914f6cdd1dULL) >> 56;
+  }
+}
+
+static void test_keys_batch(src_t *src, const uint8_t *data, size_t size){
+  ECIES_privkey_t priv[8];
+  ECIES_pubkey_t pub[8];
+  elem_t x, y, ex, ey;
+  exp_t k;
+  uint64_t state;
+  int n = 4 + src_byte(src) % 5, i;
+
+  src_bytes(src, &state, sizeof(state));
+  state |= 1;
+  ECIES_set_rng(xorshift_rng, &state);
+  ECIES_generate_keys_batch(priv, pub, n);
+  ECIES_set_rng(ECIES_rng_default, NULL);
+
+  for(i = 0; i < n; i++){
+    bitstr_load(k, priv[i].k, ECIES_KEY_SIZE);
+    bitstr_load(x, pub[i].x, ECIES_KEY_SIZE);
+    bitstr_load(y, pub[i].y, ECIES_KEY_SIZE);
+    point_copy(ex, ey, base_x, base_y);
+    ref_point_mult(ex, ey, k);
+    CHECK("ECIES_generate_keys_batch", bitstr_is_equal(x, ex) && bitstr_is_equal(y, ey));
+  }
+}
+
+#if ECIES_LANES
+/* one ladder over a point and an exponent per lane, against 2 * k * P one by one */
+static void test_mult_lanes(src_t *src, const uint8_t *data, size_t size){
+  elem_t x[ECIES_LANES], rx[ECIES_LANES], y, ry;
+  exp_t k[ECIES_LANES];
+  int res[ECIES_LANES], zero[ECIES_LANES], l;
+
+  for(l = 0; l < ECIES_LANES; l++){
+    src_point(src, x[l], y);
+    if(bitstr_is_clear(x[l])){
+      point_copy(x[l], y, base_x, base_y);
+    }
+    src_exp(src, k[l]);
+    point_copy(rx[l], ry, x[l], y);
+    ref_point_mult(rx[l], ry, k[l]);
+    ref_point_double(rx[l], ry);
+    zero[l] = point_is_zero(rx[l], ry);
+  }
+
+  point_mult_lanes(res, x, k);
+
+  for(l = 0; l < ECIES_LANES; l++){
+    CHECK("point_mult_lanes", zero[l] ? res[l] < 0 : res[l] > 0 && bitstr_is_equal(x[l], rx[l]));
+  }
+}
+#endif
+
+/* the incremental CTR and CBC-MAC over pieces of random sizes against the one-shot reference */
+static void test_xtea_pieces(src_t *src, const uint8_t *data, size_t size){
+  ECIES_stream_t stm;
+  ECIES_ctr_t ctr;
+  ECIES_mac_t ctx;
+  ECIES_byte_t buf[256], ref[256], mac[8], rmac[8];
+  ECIES_size_t len, off, m;
+  uint32_t nonce;
+
+  src_bytes(src, stm.k1, sizeof(stm.k1));
+  src_bytes(src, stm.k2, sizeof(stm.k2));
+  src_bytes(src, &nonce, sizeof(nonce));
+  len = src_byte(src);
+  src_bytes(src, buf, len);
+  memcpy(ref, buf, len);
+
+  ECIES_ctr_init(&ctr, &stm, nonce);
+  ECIES_mac_init(&ctx, &stm, nonce, len);
+  for(off = 0; off < len; off += m){
+    m = 1 + src_byte(src) % 24;
+    if(m > len - off){
+      m = len - off;
+    }
+    ECIES_ctr_update(&ctr, buf + off, buf + off, m);
+    ECIES_mac_update(&ctx, buf + off, m);
+  }
+  ECIES_mac_final(&ctx, mac);
+
+  ref_XTEA_ctr_crypt(ref, len, stm.k1, nonce);
+  ref_XTEA_cbcmac(rmac, ref, len, stm.k2, nonce);
+
+  CHECK("ECIES_ctr_update", !memcmp(buf, ref, len));
+  CHECK("ECIES_mac_update", !memcmp(mac, rmac, 8));
+}
+
+/* the frames of one peer, opened by the other in order, as the case picks them against
+   a model of the replay window, and forged, reflected or too old */
+#define SESSION_FRAMES 72
+#define SESSION_LEN 16
+
+static void test_session(src_t *src, const uint8_t *data, size_t size){
+  ECIES_byte_t start[ECIES_SESSION_START_OVERHEAD], raws[SESSION_FRAMES][SESSION_LEN];
+  ECIES_byte_t frames[SESSION_FRAMES][SESSION_LEN + ECIES_SESSION_OVERHEAD], forged[SESSION_LEN + ECIES_SESSION_OVERHEAD];
+  ECIES_size_t lens[SESSION_FRAMES];
+  ECIES_session_t a, b, fresh;
+  ECIES_privkey_t priv;
+  ECIES_pubkey_t pub;
+  uint8_t opened[SESSION_FRAMES];
+  char raw[SESSION_LEN];
+  uint64_t state;
+  int top = 0, i, j, res, want;
+
+  src_bytes(src, &state, sizeof(state));
+  state |= 1;
+  ECIES_set_rng(xorshift_rng, &state);
+  ECIES_generate_keys(&priv, &pub);
+  ECIES_session_start(&a, start, &pub);
+  ECIES_set_rng(ECIES_rng_default, NULL);
+
+  res = ECIES_session_accept(&b, start, &priv);
+  CHECK("ECIES_session_accept", res > 0);
+  if(res < 0){
+    return;
+  }
+  fresh = b;
+
+  for(i = 0; i < SESSION_FRAMES; i++){
+    lens[i] = src_byte(src) % (SESSION_LEN + 1);
+    src_bytes(src, raws[i], lens[i]);
+    ECIES_session_seal(&a, frames[i], (const char*)raws[i], lens[i]);
+  }
+
+  for(i = 0; i < SESSION_FRAMES; i++){
+    res = ECIES_session_open(&b, raw, frames[i], lens[i]);
+    CHECK("ECIES_session_open in order", res > 0 && !memcmp(raw, raws[i], lens[i]));
+  }
+
+  /* frame i has sequence number i + 1, it opens once unless 64 or more behind the newest */
+  b = fresh;
+  memset(opened, 0, sizeof(opened));
+  for(j = 0; j < 2 * SESSION_FRAMES; j++){
+    i = src_byte(src) % SESSION_FRAMES;
+    want = opened[i] || (i + 1 <= top && top - (i + 1) >= 64) ? -3 : 1;
+    res = ECIES_session_open(&b, raw, frames[i], lens[i]);
+    CHECK("ECIES_session_open window", res == want && (res < 0 || !memcmp(raw, raws[i], lens[i])));
+    if(want > 0){
+      opened[i] = 1;
+      top = i + 1 > top ? i + 1 : top;
+    }
+  }
+
+  /* age 64 is out of the window, 63 still in */
+  b = fresh;
+  CHECK("ECIES_session_open ahead", ECIES_session_open(&b, raw, frames[64], lens[64]) > 0);
+  CHECK("ECIES_session_open age 64", ECIES_session_open(&b, raw, frames[0], lens[0]) == -3);
+  CHECK("ECIES_session_open age 63", ECIES_session_open(&b, raw, frames[1], lens[1]) > 0);
+  CHECK("ECIES_session_open replay", ECIES_session_open(&b, raw, frames[1], lens[1]) == -3);
+
+  /* a frame sent back to its sealer */
+  CHECK("ECIES_session_open reflected", ECIES_session_open(&a, raw, frames[2], lens[2]) == -3);
+
+  /* one bit flipped, in the sequence number it may also change the direction or make it 0;
+     the forgery does not move the window */
+  b = fresh;
+  i = src_byte(src) % SESSION_FRAMES;
+  j = src_byte(src) % ((lens[i] + ECIES_SESSION_OVERHEAD) * 8);
+  memcpy(forged, frames[i], lens[i] + ECIES_SESSION_OVERHEAD);
+  forged[j / 8] ^= 1 << (j % 8);
+  res = ECIES_session_open(&b, raw, forged, lens[i]);
+  CHECK("ECIES_session_open forged", j < 32 ? res < 0 : res == -2);
+  CHECK("ECIES_session_open after forged", ECIES_session_open(&b, raw, frames[i], lens[i]) > 0);
+
+  ECIES_session_end(&a);
+  ECIES_session_end(&b);
+  ECIES_session_end(&fresh);
+}
+
+/* the keys of the keyring tests and a keyed and a plain message to each, made once */
+#define KEYRING_KEYS 6
+#define KEYRING_LEN 8
+
+static struct {
+  int ready;
+  ECIES_privkey_t priv[KEYRING_KEYS];
+  ECIES_pubkey_t pub[KEYRING_KEYS];
+  ECIES_byte_t keyed[KEYRING_KEYS][KEYRING_LEN + ECIES_KEYED_OVERHEAD];
+  ECIES_byte_t plain[KEYRING_KEYS][KEYRING_LEN + ECIES_OVERHEAD];
+  char raw[KEYRING_LEN];
+} keyring;
+
+static void keyring_init(void){
+  uint64_t state = 0x6b657972696e67ULL;
+  int i;
+
+  if(keyring.ready){
+    return;
+  }
+
+  memcpy(keyring.raw, "keyring", KEYRING_LEN);
+  ECIES_set_rng(xorshift_rng, &state);
+  ECIES_generate_keys_batch(keyring.priv, keyring.pub, KEYRING_KEYS);
+  for(i = 0; i < KEYRING_KEYS; i++){
+    ECIES_encrypt_keyed(keyring.keyed[i], keyring.raw, KEYRING_LEN, &keyring.pub[i]);
+    ECIES_encrypt(keyring.plain[i], keyring.raw, KEYRING_LEN, &keyring.pub[i]);
+  }
+  ECIES_set_rng(ECIES_rng_default, NULL);
+
+  keyring.ready = 1;
+}
+
+/* some of the keys added in the order the case gives, added again, one removed and the rest
+   relinked, keyed messages found by ID and unkeyed ones by trial, the removed key added back */
+static void test_keyring(src_t *src, const uint8_t *data, size_t size){
+  ECIES_keyring_t *ring;
+  char dec[KEYRING_LEN];
+  int n = 2 + src_byte(src) % (KEYRING_KEYS - 1), first = src_byte(src), pick, gone, i, k, res;
+
+  keyring_init();
+
+  CHECK("ECIES_keyring_new", (ring = ECIES_keyring_new()) != NULL);
+  if(!ring){
+    return;
+  }
+
+  for(i = 0; i < n; i++){
+    CHECK("ECIES_keyring_add", ECIES_keyring_add(ring, &keyring.priv[(first + i) % n]) == 1);
+  }
+  pick = src_byte(src) % n;
+  CHECK("ECIES_keyring_add duplicate", ECIES_keyring_add(ring, &keyring.priv[pick]) == 0 &&
+                                       ECIES_keyring_count(ring) == (size_t)n);
+
+  gone = src_byte(src) % n;
+  CHECK("ECIES_keyring_remove", ECIES_keyring_remove(ring, &keyring.pub[gone]) == 1);
+  CHECK("ECIES_keyring_remove twice", ECIES_keyring_remove(ring, &keyring.pub[gone]) == 0 &&
+                                      ECIES_keyring_count(ring) == (size_t)n - 1);
+
+  /* a key never added is unknown too */
+  for(k = 0; k <= n && k < KEYRING_KEYS; k++){
+    res = ECIES_decrypt_keyring(dec, KEYRING_LEN, keyring.keyed[k], ring);
+    CHECK("ECIES_decrypt_keyring keyed", k == gone || k == n ? res == -4 : res > 0 && !memcmp(dec, keyring.raw, KEYRING_LEN));
+  }
+  res = ECIES_decrypt_keyring(dec, KEYRING_LEN, keyring.plain[pick], ring);
+  CHECK("ECIES_decrypt_keyring unkeyed", pick == gone ? res < 0 : res > 0 && !memcmp(dec, keyring.raw, KEYRING_LEN));
+
+  CHECK("ECIES_keyring_add removed", ECIES_keyring_add(ring, &keyring.priv[gone]) == 1);
+  res = ECIES_decrypt_keyring(dec, KEYRING_LEN, keyring.keyed[gone], ring);
+  CHECK("ECIES_decrypt_keyring added back", res > 0 && !memcmp(dec, keyring.raw, KEYRING_LEN));
+
+  ECIES_keyring_free(ring);
+}
+
+/* a framed stream of up to FRAMES frames and the empty end frame */
+#define FRAMES 8
+#define FRAME_LEN 40
+
+/* decode a whole stream as tool.c does, -1 when it is cut short, else the raw length
+   or the error of ECIES_frame_length() or ECIES_decrypt_frame(); decrypts in place */
+static int frames_decode(const ECIES_stream_t *stm, ECIES_byte_t *buf, size_t size, ECIES_byte_t *raw){
+  ECIES_size_t index;
+  size_t pos = 0, total = 0;
+  int len;
+
+  for(index = 0; ; index++){
+    if(size - pos < ECIES_FRAME_HEADER){
+      return -1;
+    }
+    if((len = ECIES_frame_length(buf + pos)) < 0){
+      return len;
+    }
+    if(size - pos < (size_t)len + ECIES_FRAME_OVERHEAD){
+      return -1;
+    }
+    if((len = ECIES_decrypt_frame(stm, index, buf + pos)) < 0){
+      return len;
+    }
+    memcpy(raw + total, buf + pos + ECIES_FRAME_HEADER, len);
+    total += len;
+    pos += len + ECIES_FRAME_OVERHEAD;
+    if(len == 0){
+      return pos == size ? (int)total : -1;
+    }
+  }
+}
+
+static void test_frames(src_t *src, const uint8_t *data, size_t size){
+  ECIES_stream_t stm;
+  ECIES_byte_t enc[(FRAMES + 1) * (FRAME_LEN + ECIES_FRAME_OVERHEAD)], buf[sizeof(enc)];
+  ECIES_byte_t raw[FRAMES * FRAME_LEN], dec[sizeof(raw)];
+  size_t off[FRAMES + 2], total = 0, len, cut;
+  int n = 1 + src_byte(src) % FRAMES, i, j, k;
+
+  src_bytes(src, stm.k1, sizeof(stm.k1));
+  src_bytes(src, stm.k2, sizeof(stm.k2));
+
+  /* the data frames are never empty, an empty one ends the stream */
+  off[0] = 0;
+  for(i = 0; i <= n; i++){
+    len = i < n ? 1 + src_byte(src) % FRAME_LEN : 0;
+    src_bytes(src, raw + total, len);
+    memcpy(enc + off[i] + ECIES_FRAME_HEADER, raw + total, len);
+    ECIES_encrypt_frame(&stm, i, enc + off[i], len);
+    total += len;
+    off[i + 1] = off[i] + len + ECIES_FRAME_OVERHEAD;
+  }
+
+  memcpy(buf, enc, off[n + 1]);
+  CHECK("ECIES_decrypt_frame", frames_decode(&stm, buf, off[n + 1], dec) == (int)total && !memcmp(dec, raw, total));
+
+  /* cut anywhere before the end of the end frame */
+  cut = (src_byte(src) << 8 | src_byte(src)) % off[n + 1];
+  memcpy(buf, enc, cut);
+  CHECK("ECIES_decrypt_frame truncated", frames_decode(&stm, buf, cut, dec) < 0);
+
+  /* two frames swapped, the end frame may be one of them */
+  i = src_byte(src) % (n + 1);
+  j = (i + 1 + src_byte(src) % n) % (n + 1);
+  for(k = 0, len = 0; k <= n; k++){
+    int f = k == i ? j : k == j ? i : k;
+    memcpy(buf + len, enc + off[f], off[f + 1] - off[f]);
+    len += off[f + 1] - off[f];
+  }
+  CHECK("ECIES_decrypt_frame reordered", frames_decode(&stm, buf, len, dec) < 0);
+}
+
+#define TEST_FIELD_MULT 0
+#define TEST_FIELD_SQUARE 1
+#define TEST_FIELD_INVERT 2
+#define TEST_POINT_DOUBLE 3
+#define TEST_POINT_ADD 4
+#define TEST_POINT_MULT 5
+#define TEST_POINT_MULT_TABLE 6
+#define TEST_KEYS_BATCH 7
+#define TEST_KDF 8
+#define TEST_XTEA_BLOCK 9
+#define TEST_XTEA_CTR 10
+#define TEST_XTEA_CBCMAC 11
+#define TEST_POINT_DECOMPRESS 12
+#define TEST_POINT_MULT_LANES 13
+#define TEST_XTEA_PIECES 14
+#define TEST_SESSION 15
+#define TEST_KEYRING 16
+#define TEST_FRAMES 17
+#define TESTS 18
+
+static void difftest_one(const uint8_t *data, size_t size){
+  src_t src = { data, size };
+  elem_t x, y, x2, y2, rx, ry, z, rz;
+  exp_t k;
+  ECIES_byte_t key[16], buf[256], ref[256], mac[8], rmac[8], k1[16], k2[16], r1[16], r2[16];
+  uint32_t kw[4], nonce;
+  ECIES_size_t len;
+  int i;
+
+  points_init();
+
+  switch(src_byte(&src) % TESTS){
+  case TEST_FIELD_MULT:
+    src_elem(&src, x);
+    src_elem(&src, y);
+    field_mult(z, x, y);
+    ref_field_mult(rz, x, y);
+    CHECK("field_mult", bitstr_is_equal(z, rz));
+    bitstr_copy(z, x);
+    field_mult(z, z, y); /* in place */
+    CHECK("field_mult in place", bitstr_is_equal(z, rz));
+    break;
+  case TEST_FIELD_SQUARE:
+    src_elem(&src, x);
+    field_mult(z, x, x);
+    ref_field_mult(rz, x, x);
+    CHECK("field_mult square", bitstr_is_equal(z, rz));
+    break;
+  case TEST_FIELD_INVERT:
+    src_elem(&src, x);
+    if(bitstr_is_clear(x)){
+      break;
+    }
+    field_invert(z, x);
+    ref_field_invert(rz, x);
+    CHECK("field_invert", bitstr_is_equal(z, rz));
+    break;
+  case TEST_POINT_DOUBLE:
+    src_point(&src, x, y);
+    point_copy(rx, ry, x, y);
+    point_double(x, y);
+    ref_point_double(rx, ry);
+    CHECK("point_double", bitstr_is_equal(x, rx) && bitstr_is_equal(y, ry));
+    break;
+  case TEST_POINT_ADD:
+    src_point(&src, x, y);
+    src_point(&src, x2, y2);
+    point_copy(rx, ry, x, y);
+    point_add(x, y, x2, y2);
+    ref_point_add(rx, ry, x2, y2);
+    CHECK("point_add", bitstr_is_equal(x, rx) && bitstr_is_equal(y, ry));
+    break;
+  case TEST_POINT_MULT:
+    src_point(&src, x, y);
+    src_exp(&src, k);
+    point_copy(rx, ry, x, y);
+    point_mult(x, y, k);
+    ref_point_mult(rx, ry, k);
+    CHECK("point_mult", bitstr_is_equal(x, rx) && bitstr_is_equal(y, ry));
+    CHECK("point_mult on curve", ref_is_point_on_curve(x, y));
+    break;
+  case TEST_POINT_DECOMPRESS:
+    /* a known point, then any x */
+    src_point(&src, x, y);
+    if(!bitstr_is_clear(x)){
+      CHECK("point_decompress", point_decompress(y2, x, point_ybit(x, y)) > 0 && bitstr_is_equal(y, y2));
+    }
+    src_elem(&src, x);
+    i = src_byte(&src) & 1;
+    if(point_decompress(y, x, i) > 0){
+      ref_field_invert(rz, x);
+      ref_field_mult(z, rz, y);
+      CHECK("point_decompress any x", ref_is_point_on_curve(x, y) && (int)(z[0] & 1) == i);
+    }
+    break;
+  case TEST_POINT_MULT_TABLE:
+    i = src_byte(&src) % POINTS;
+    src_exp(&src, k);
+    if(!points.tab[i]){
+      if(!(points.tab[i] = malloc(sizeof(ECIES_pubkey_table_t)))){
+        break;
+      }
+      point_table_init(points.tab[i]->xy, points.x[i], points.y[i]);
+    }
+    point_mult_table(x, y, points.tab[i]->xy, k);
+    point_copy(rx, ry, points.x[i], points.y[i]);
+    ref_point_mult(rx, ry, k);
+    CHECK("point_mult_table", bitstr_is_equal(x, rx) && bitstr_is_equal(y, ry));
+    break;
+  case TEST_KEYS_BATCH:
+    test_keys_batch(&src, data, size);
+    break;
+  case TEST_POINT_MULT_LANES:
+#if ECIES_LANES
+    test_mult_lanes(&src, data, size);
+#endif
+    break;
+  case TEST_XTEA_PIECES:
+    test_xtea_pieces(&src, data, size);
+    break;
+  case TEST_SESSION:
+    test_session(&src, data, size);
+    break;
+  case TEST_KEYRING:
+    test_keyring(&src, data, size);
+    break;
+  case TEST_FRAMES:
+    test_frames(&src, data, size);
+    break;
+  case TEST_KDF:
+    src_elem(&src, z);
+    src_point(&src, x, y);
+    ECIES_kdf(k1, k2, z, x, y);
+    ref_kdf(r1, r2, z, x, y);
+    CHECK("ECIES_kdf", !memcmp(k1, r1, 16) && !memcmp(k2, r2, 16));
+    break;
+  case TEST_XTEA_BLOCK:
+    src_bytes(&src, key, sizeof(key));
+    src_bytes(&src, buf, 8);
+    memcpy(ref, buf, 8);
+    XTEA_init_key(kw, key);
+    XTEA_encipher_block(buf, kw);
+    ref_XTEA_encipher_block(ref, kw);
+    CHECK("XTEA_encipher_block", !memcmp(buf, ref, 8));
+    break;
+  case TEST_XTEA_CTR:
+  case TEST_XTEA_CBCMAC:
+    src_bytes(&src, key, sizeof(key));
+    src_bytes(&src, &nonce, sizeof(nonce));
+    len = src_byte(&src);
+    src_bytes(&src, buf, len);
+    memcpy(ref, buf, len);
+    if(data[0] % TESTS == TEST_XTEA_CTR){
+      XTEA_ctr_crypt(buf, len, key, nonce);
+      ref_XTEA_ctr_crypt(ref, len, key, nonce);
+      CHECK("XTEA_ctr_crypt", !memcmp(buf, ref, len));
+    }else{
+      XTEA_cbcmac(mac, buf, len, key, nonce);
+      ref_XTEA_cbcmac(rmac, ref, len, key, nonce);
+      CHECK("XTEA_cbcmac", !memcmp(mac, rmac, 8));
+    }
+    break;
+  }
+}
+
+/*
+ * Known answers of ECIES_encrypt and ECIES_encrypt_compact with the key pair
+ * of demo.c, the ephemeral keys drawn from a xorshift64* RNG seeded per
+ * vector. They pin the wire format.
+ */
+
+typedef struct {
+  uint64_t seed;
+  int compact;        /* ECIES_encrypt_compact() */
+  ECIES_size_t len;   /* message bytes (i * 7 + 1) */
+  const char *enc;    /* hex */
+} kat_t;
+
+static const kat_t kats[] = {
+  { 0x0000000000000001ULL, 0, 0,
+    "00000005baf5654cfc33ab69113670fbc879942525a4eb2600000007af7e04c63a471044336c59f377c248a92adc6790"
+    "4fd8d13f73886274" },
+  { 0x0000000000000002ULL, 0, 1,
+    "000000029dcaa73e6a5eff05503cb2154c3135018802684b00000006171d03b94bc381a325a681b17bc5c6d5f8f61bc3"
+    "57e243728b534d280e" },
+  { 0x0000000000000003ULL, 0, 8,
+    "00000002433c4fccfa8800a0b108cd2a9a9ae13bce68d7bf000000066972a6a14453053af03eaa8386b28726e6f68e77"
+    "9df4bc7e835823f30c69346d34631361" },
+  { 0x0000000000000004ULL, 0, 21,
+    "000000009f06d384ca135a0f357ce357d9cfb09a71dfdd0d00000003423e844b69114c132079012a67a0139a2cfe3213"
+    "9810c3e631310dd02c88dfeed846eab80031bd7caab6df4cbf75ae10f1" },
+  { 0x0000000000000005ULL, 0, 100,
+    "000000031aa34c85254429d7138a8ee9ca9b49812e6363c1000000065824f459ed2e4e535244eedba83adb793ff5d286"
+    "c2113561497e6453558653b1f03e8de8728392224ee60d8ba2e59481aafada3625960c144eb430286f4dc364c1e6b64a"
+    "8cab553907fe4076a024ebf2408a9860f7b0c8e2e516e71b401a35252b5774358109797822f6ed84e4f190a6075257f3"
+    "d8d7036bd3c935cd56d9e5d4" },
+  { 0x0123456789abcdefULL, 0, 255,
+    "000000054dbf5c1e7cac0695ea6cab2baa7dfc7c229b745b00000000af1831397e2b7ce6166ba5d189e615269eebf448"
+    "0350309d978ac3a0cd5bbbee79d77f6f95fa04c9125ea116f3e5699c9591b26ef27a757cbff64ad45791836f56b297ca"
+    "d42554b138d22c2a4ff47a261785a3da731d63b3bf4f4914b97e06c167f1c88fffb0f7d932fa2a2ee13dfffd6b922c55"
+    "b36764fef89938dedf736d7393406d9fc245e568fef38b5333960106e358b19e7a5410ac26ae9b202b8c356687532e03"
+    "9e0eb80c2e4e7104c3c3ae0508c671fd59b5dfcc66693789d88d25bc8b130f69aaeecea011d02944f3c7bba51225c528"
+    "9e41c5452e7bf88d790e8624fd6c2f6d30e3438b26b7df1e0496f79ad77f0fb63e625912ea6d21b69b1b06fddd81e6f0"
+    "9cda57b15f0950f7ed2f1f0f2d4f23aad68df6c63509c1" },
+  { 0x0000000000000006ULL, 1, 0,
+    "0201db043fbcaa8d61040d2c4905d823286d45aa6b47b3ea707bb632f65d" },
+  { 0x0000000000000007ULL, 1, 21,
+    "020341bed54b334fa78ef3573487f641ee2fc71fabaff9b2df347e10ff8e6decea2b58cfb0fbe71c1bfb0b1438c91786"
+    "7bfdd3" },
+  { 0x0000000000000008ULL, 1, 100,
+    "0306e0ef72f6931e2a6c5966f473ca533b9048aa7da86f2ed343cb8927a995322e3b6cc040bb1f98b15b302b1f6918f4"
+    "819a761d0ee01707958ecb9f7c7c42daf659a4f162d799d83eb4ede704e30e73febf715025fe42a0492338c29c340f45"
+    "cc49e93a94632df12e13d93cf771d101a83211ee5305216bc29c2a6dbe6c5dc29c52" },
+};
+
+#define KATS (sizeof(kats) / sizeof(kats[0]))
+
+static const ECIES_pubkey_t kat_pub = {
+  { 0x01, 0xc5, 0x6d, 0x30, 0x2c, 0xf6, 0x42, 0xa8, 0xe1, 0xba, 0x4b, 0x48, 0xcc, 0x4f, 0xbe, 0x28, 0x45, 0xee, 0x32, 0xdc, 0xe7 },
+  { 0x04, 0x5f, 0x46, 0xeb, 0x30, 0x3e, 0xdf, 0x2e, 0x62, 0xf7, 0x4b, 0xd6, 0x83, 0x68, 0xd9, 0x79, 0xe2, 0x65, 0xee, 0x3c, 0x03 },
+};
+
+static const ECIES_privkey_t kat_priv = {
+  { 0x00, 0xe1, 0x0e, 0x78, 0x70, 0x36, 0x94, 0x1e, 0x6c, 0x78, 0xda, 0xf8, 0xa0, 0xe8, 0xe1, 0xdb, 0xfa, 0xc6, 0x8e, 0x26, 0xd2 },
+};
+
+static int kat_run(int print){
+  ECIES_byte_t msg[256], enc[256 + ECIES_OVERHEAD];
+  char dec[256], hex[2 * (256 + ECIES_OVERHEAD) + 1];
+  uint64_t state;
+  ECIES_size_t i, j;
+  int res = 0;
+
+  for(i = 0; i < KATS; i++){
+    for(j = 0; j < kats[i].len; j++){
+      msg[j] = j * 7 + 1;
+    }
+
+    state = kats[i].seed;
+    ECIES_set_rng(xorshift_rng, &state);
+    if(kats[i].compact){
+      ECIES_encrypt_compact(enc, (const char*)msg, kats[i].len, &kat_pub);
+    }else{
+      ECIES_encrypt(enc, (const char*)msg, kats[i].len, &kat_pub);
+    }
+    ECIES_set_rng(ECIES_rng_default, NULL);
+
+    for(j = 0; j < kats[i].len + (kats[i].compact ? ECIES_COMPACT_OVERHEAD : ECIES_OVERHEAD); j++){
+      sprintf(hex + 2 * j, "%02x", enc[j]);
+    }
+
+    if(print){
+      printf("  { 0x%016llxULL, %d, %u, \"%s\" },\n", (unsigned long long)kats[i].seed, kats[i].compact, kats[i].len, hex);
+      continue;
+    }
+
+    if(strcmp(hex, kats[i].enc)){
+      fprintf(stderr, "KAT %u: ECIES_encrypt differs\n", i);
+      res = -1;
+    }
+
+    if(ECIES_decrypt(dec, kats[i].len, enc, &kat_priv) < 0 || memcmp(dec, msg, kats[i].len)){
+      fprintf(stderr, "KAT %u: ECIES_decrypt differs\n", i);
+      res = -1;
+    }
+  }
+
+  return res;
+}
+
+#ifdef DIFFTEST_FUZZ
+
+int LLVMFuzzerInitialize(int *argc, char ***argv){
+  if(kat_run(0) < 0){
+    abort();
+  }
+  return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size){
+  if(size > 0){
+    difftest_one(data, size);
+  }
+  return 0;
+}
+
+#else/*DIFFTEST_FUZZ*/
+
+int main(int argc, const char *argv[]){
+  unsigned long cases = 1000, seed = 1, n, c;
+  uint64_t state;
+  uint8_t data[512];
+  size_t size;
+  int i;
+
+  for(i = 1; i < argc; i++){
+    if(!strcmp(argv[i], "-n") && i + 1 < argc){
+      cases = strtoul(argv[++i], NULL, 0);
+    }else if(!strcmp(argv[i], "-s") && i + 1 < argc){
+      seed = strtoul(argv[++i], NULL, 0);
+    }else if(!strcmp(argv[i], "--print-kat")){
+      return kat_run(1) < 0;
+    }else{
+      fprintf(stderr, "Usage: %s [-n cases] [-s seed]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if(kat_run(0) < 0){
+    failures++;
+  }
+
+  state = seed * 0x9e3779b97f4a7c15ULL + 1;
+
+  for(c = 0; c < cases; c++){
+    size = 1 + c % sizeof(data);
+    xorshift_rng(&state, data, size);
+    /* every kernel in turn, whatever the first byte says */
+    data[0] = c % TESTS;
+    difftest_one(data, size);
+  }
+
+  for(n = 0; n < POINTS; n++){
+    free(points.tab[n]);
+  }
+
+  printf("%lu cases, %u known answers, %lu failures\n", cases, (unsigned)KATS, failures);
+
+  return failures != 0;
+}
+
+#endif/*DIFFTEST_FUZZ*/
@@ -4,5 +4,9 @@
  * @section toc Content
  * -# @ref ecc
  * -# @ref hex
+ * -# @ref keyring
+ * -# @ref pack
+ * -# @ref pool
+ * -# @ref store
  *
  */
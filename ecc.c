@@ -39,6 +39,51 @@ static inline uint32_t __swap32(uint32_t val){
 #define CHARS2INT(ptr) ( be32toh(*(uint32_t*)(ptr)) )
 #define INT2CHARS(ptr, val) MACRO( (*(uint32_t*)(ptr)) = htobe32(val) )
 
+#ifndef ECIES_PROFILING
+#define ECIES_PROFILING 0
+#endif
+
+#if ECIES_PROFILING
+/* phase timers and field counters, shared by all threads */
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROF_CLOCK "tsc"
+#define prof_ticks() __rdtsc()
+#else
+#include <time.h>
+#define PROF_CLOCK "ns"
+static uint64_t prof_ticks(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+#endif
+
+static ECIES_profile_t prof;
+static __thread int prof_in_mult;
+
+#define prof_add(var, val) __atomic_fetch_add(&(var), (val), __ATOMIC_RELAXED)
+
+#define PROF_BEGIN(phase) uint64_t prof_start_##phase = prof_ticks()
+#define PROF_END(phase) MACRO( prof_add(prof.ticks[phase], prof_ticks() - prof_start_##phase); \
+                               prof_add(prof.calls[phase], 1) )
+#define PROF_FIELD(op) MACRO( prof_add(prof.field[op], 1); \
+                              if (prof_in_mult) prof_add(prof.field_in_mult[op], 1) )
+#define PROF_MULT_ENTER() (prof_in_mult++)
+#define PROF_MULT_LEAVE() (prof_in_mult--)
+
+#else/*ECIES_PROFILING*/
+
+#define PROF_BEGIN(phase)
+#define PROF_END(phase)
+#define PROF_FIELD(op)
+#define PROF_MULT_ENTER()
+#define PROF_MULT_LEAVE()
+
+#endif/*ECIES_PROFILING*/
+
 /* the following type will represent bit vectors of length (ECIES_DEGREE+MARGIN) */
 typedef uint32_t bitstr_t[ECIES_NUMWORDS];
 
@@ -181,6 +226,7 @@ static void field_mult(elem_t z, const elem_t x, const elem_t y)
   elem_t b;
   int i, j;
   /* assert(z != y); */
+  PROF_FIELD(x == y ? ECIES_FIELD_SQUARE : ECIES_FIELD_MULT);
   bitstr_copy(b, x);
   if (bitstr_getbit(y, 0))
     bitstr_copy(z, x);
@@ -202,6 +248,8 @@ static void field_invert(elem_t z, const elem_t x)
 {
   elem_t u, v, g, h;
   int i;
+  PROF_BEGIN(ECIES_PHASE_FIELD_INVERT);
+  PROF_FIELD(ECIES_FIELD_INVERT);
   bitstr_copy(u, x);
   bitstr_copy(v, poly);
   bitstr_clear(g);
@@ -216,6 +264,7 @@ static void field_invert(elem_t z, const elem_t x)
     bitstr_lshift(h, g, i);
     field_add(z, z, h);
   }
+  PROF_END(ECIES_PHASE_FIELD_INVERT);
 }
 
 /* The following routines do the ECC arithmetic. Elliptic curve points
@@ -231,6 +280,50 @@ static const elem_t coeff_b = { ECIES_COEFF_B }, base_x = { ECIES_BASE_X }, base
 #define point_copy(x1, y1, x2, y2) MACRO( bitstr_copy(x1, x2); \
                                           bitstr_copy(y1, y2) )
 
+/* the y bit of a compressed point, the lowest bit of y / x */
+static int point_ybit(const elem_t x, const elem_t y)
+{
+  elem_t a, b;
+  field_invert(a, x);
+  field_mult(b, a, y);
+  return b[0] & 1;
+}
+
+/* half-trace, a solution of z^2 + z = x when Tr(x) = 0, ECIES_DEGREE is odd */
+static void field_half_trace(elem_t z, const elem_t x)
+{
+  elem_t t;
+  int i;
+  bitstr_copy(z, x);
+  for(i = 0; i < (ECIES_DEGREE - 1) / 2; i++) {
+    field_mult(t, z, z);
+    field_mult(z, t, t);
+    field_add(z, z, x);
+  }
+}
+
+/* recompute y from x and the y bit: y = x * z with z^2 + z = x + 1 + coeff_b / x^2 */
+static int point_decompress(elem_t y, const elem_t x, int ybit)
+{
+  elem_t a, b, z;
+  if (bitstr_is_clear(x) || bitstr_sizeinbits(x) > ECIES_DEGREE)
+    return -1;
+  field_mult(a, x, x);
+  field_invert(b, a);
+  field_mult(a, b, coeff_b);
+  field_add(a, a, x);
+  field_add1(a);
+  field_half_trace(z, a);
+  field_mult(b, z, z);
+  field_add(b, b, z);
+  if (! bitstr_is_equal(a, b)) /* Tr(a) = 1, x is not on the curve */
+    return -1;
+  if ((int)(z[0] & 1) != ybit)
+    field_add1(z);
+  field_mult(y, x, z);
+  return 1;
+}
+
 /* check if y^2 + x*y = x^3 + *x^2 + coeff_b holds */
 static int is_point_on_curve(const elem_t x, const elem_t y)
 {
@@ -308,6 +401,8 @@ static void point_mult(elem_t x, elem_t y, const exp_t exp)
 {
   elem_t X, Y;
   int i;
+  PROF_BEGIN(ECIES_PHASE_POINT_MULT);
+  PROF_MULT_ENTER();
   point_set_zero(X, Y);
   for(i = bitstr_sizeinbits(exp) - 1; i >= 0; i--) {
     point_double(X, Y);
@@ -315,8 +410,239 @@ static void point_mult(elem_t x, elem_t y, const exp_t exp)
       point_add(X, Y, x, y);
   }
   point_copy(x, y, X, Y);
+  PROF_MULT_LEAVE();
+  PROF_END(ECIES_PHASE_POINT_MULT);
+}
+
+#define COMB_DIGITS ((1 << ECIES_COMB_WIDTH) - 1)
+
+/* the window of 'exp' starting at bit 'pos' */
+static unsigned int exp_window(const exp_t exp, int pos)
+{
+  uint32_t w = exp[pos / 32] >> (pos % 32);
+  if (pos % 32 + ECIES_COMB_WIDTH > 32 && pos / 32 + 1 < ECIES_NUMWORDS)
+    w |= exp[pos / 32 + 1] << (32 - pos % 32);
+  return w & COMB_DIGITS;
+}
+
+/* fill the fixed-point table: xy[i][j - 1] = j * 2^(ECIES_COMB_WIDTH * i) * (x,y) */
+static void point_table_init(uint32_t (*xy)[2][ECIES_NUMWORDS], const elem_t x, const elem_t y)
+{
+  elem_t X, Y;
+  int i, j;
+  point_copy(X, Y, x, y);
+  for(i = 0; i < ECIES_COMB_WINDOWS; i++, xy += COMB_DIGITS) {
+    point_copy(xy[0][0], xy[0][1], X, Y);
+    for(j = 1; j < COMB_DIGITS; j++) {
+      point_copy(xy[j][0], xy[j][1], xy[j - 1][0], xy[j - 1][1]);
+      point_add(xy[j][0], xy[j][1], X, Y);
+    }
+    for(j = 0; j < ECIES_COMB_WIDTH; j++)
+      point_double(X, Y);
+  }
+}
+
+/* point multiplication via fixed-point table, one addition per window;
+   'exp' must be shorter than ECIES_COMB_WINDOWS * ECIES_COMB_WIDTH bits */
+static void point_mult_table(elem_t x, elem_t y, const uint32_t (*xy)[2][ECIES_NUMWORDS], const exp_t exp)
+{
+  unsigned int d;
+  int i;
+  PROF_BEGIN(ECIES_PHASE_POINT_MULT);
+  PROF_MULT_ENTER();
+  point_set_zero(x, y);
+  for(i = 0; i < ECIES_COMB_WINDOWS; i++, xy += COMB_DIGITS)
+    if ((d = exp_window(exp, i * ECIES_COMB_WIDTH)))
+      point_add(x, y, xy[d - 1][0], xy[d - 1][1]);
+  PROF_MULT_LEAVE();
+  PROF_END(ECIES_PHASE_POINT_MULT);
+}
+
+#if ECIES_LANES
+
+/* Several independent point multiplications at once: every word of a field
+   element holds one word of each of ECIES_LANES elements, so one vector
+   operation works on all lanes. The lanes run the Montgomery ladder on x
+   alone (Lopez-Dahab), whose steps depend on no data, and field_mult()
+   without branches; bits only select through masks, all lanes stay in step. */
+
+typedef uint32_t lane_t __attribute__((vector_size(4 * ECIES_LANES)));
+typedef lane_t lane_elem_t[ECIES_NUMWORDS];
+
+/* the body is inlined into each target clone, the clones only pass plain arrays */
+#define LANE_INLINE static inline __attribute__((always_inline))
+
+/* the word loops have to be straight code for the words to stay in registers */
+#if defined(__clang__)
+#define LANE_UNROLL _Pragma("unroll")
+#elif __GNUC__ >= 8
+#define LANE_UNROLL _Pragma("GCC unroll 8")
+#else
+#define LANE_UNROLL
+#endif
+
+/* the scalars of the ladder are this long, whatever their value */
+#define LANE_BITS (8 * ECIES_KEY_SIZE)
+
+LANE_INLINE void lane_add(lane_elem_t z, const lane_elem_t x, const lane_elem_t y)
+{
+  int i;
+  for(i = 0; i < ECIES_NUMWORDS; i++)
+    z[i] = x[i] ^ y[i];
+}
+
+/* field_mult() on every lane, z may be x or y */
+LANE_INLINE void lane_mult(lane_elem_t z, const lane_elem_t x, const lane_elem_t y)
+{
+  lane_elem_t b, r;
+  lane_t m, w = y[0] >> 1;
+  int i, j;
+  m = -(y[0] & 1);
+  for(j = 0; j < ECIES_NUMWORDS; j++) {
+    b[j] = x[j];
+    r[j] = x[j] & m;
+  }
+  for(i = 1; i < ECIES_DEGREE; i++) {
+    LANE_UNROLL
+    for(j = ECIES_NUMWORDS - 1; j > 0; j--)
+      b[j] = (b[j] << 1) | (b[j - 1] >> 31);
+    b[0] <<= 1;
+    m = -((b[ECIES_DEGREE / 32] >> (ECIES_DEGREE % 32)) & 1);
+    LANE_UNROLL
+    for(j = 0; j < ECIES_NUMWORDS; j++)
+      b[j] ^= poly[j] & m;
+    if (i % 32 == 0)
+      w = y[i / 32];
+    m = -(w & 1);
+    w >>= 1;
+    LANE_UNROLL
+    for(j = 0; j < ECIES_NUMWORDS; j++)
+      r[j] ^= b[j] & m;
+  }
+  for(j = 0; j < ECIES_NUMWORDS; j++)
+    z[j] = r[j];
+}
+
+/* swap a and b on the lanes where *m is all ones */
+LANE_INLINE void lane_cswap(lane_elem_t a, lane_elem_t b, const lane_t *m)
+{
+  lane_t t;
+  int i;
+  for(i = 0; i < ECIES_NUMWORDS; i++) {
+    t = (a[i] ^ b[i]) & *m;
+    a[i] ^= t;
+    b[i] ^= t;
+  }
+}
+
+/* (X, Z) := 2 * (X, Z) */
+LANE_INLINE void lane_double(lane_elem_t X, lane_elem_t Z, const lane_elem_t b)
+{
+  lane_elem_t t;
+  int i;
+  lane_mult(X, X, X);
+  lane_mult(Z, Z, Z);
+  lane_mult(t, X, Z);
+  lane_mult(X, X, X);
+  lane_mult(Z, Z, Z);
+  lane_mult(Z, Z, b);
+  lane_add(X, X, Z);
+  for(i = 0; i < ECIES_NUMWORDS; i++)
+    Z[i] = t[i];
+}
+
+/* (X1, Z1) := (X1, Z1) + (X2, Z2), where x is the x of their difference */
+LANE_INLINE void lane_madd(lane_elem_t X1, lane_elem_t Z1, const lane_elem_t X2, const lane_elem_t Z2,
+                           const lane_elem_t x)
+{
+  lane_elem_t t, u;
+  lane_mult(t, X1, Z2);
+  lane_mult(u, X2, Z1);
+  lane_add(Z1, t, u);
+  lane_mult(Z1, Z1, Z1);
+  lane_mult(X1, t, u);
+  lane_mult(t, x, Z1);
+  lane_add(X1, X1, t);
+}
+
+/* (X, Z) := 2 * k * (x, .) on every lane, Z is zero where the result is the point at infinity */
+LANE_INLINE void lane_ladder(uint32_t (*X)[ECIES_NUMWORDS], uint32_t (*Z)[ECIES_NUMWORDS],
+                             const uint32_t (*x)[ECIES_NUMWORDS], const uint32_t (*k)[ECIES_NUMWORDS])
+{
+  lane_elem_t px, X1, Z1, X2, Z2, b;
+  lane_t m;
+  int i, l;
+  for(i = 0; i < ECIES_NUMWORDS; i++)
+    for(l = 0; l < ECIES_LANES; l++) {
+      px[i][l] = x[l][i];
+      b[i][l] = coeff_b[i];
+      X1[i][l] = i == 0;     /* the point at infinity */
+      Z1[i][l] = 0;
+      X2[i][l] = x[l][i];    /* the point */
+      Z2[i][l] = i == 0;
+    }
+  for(i = LANE_BITS - 1; i >= 0; i--) {
+    for(l = 0; l < ECIES_LANES; l++)
+      m[l] = -((k[l][i / 32] >> (i % 32)) & 1);
+    lane_cswap(X1, X2, &m);
+    lane_cswap(Z1, Z2, &m);
+    lane_madd(X2, Z2, X1, Z1, px);
+    lane_double(X1, Z1, b);
+    lane_cswap(X1, X2, &m);
+    lane_cswap(Z1, Z2, &m);
+  }
+  lane_double(X1, Z1, b); /* cofactor h = 2 on B163 */
+  for(i = 0; i < ECIES_NUMWORDS; i++)
+    for(l = 0; l < ECIES_LANES; l++) {
+      X[l][i] = X1[i][l];
+      Z[l][i] = Z1[i][l];
+    }
+}
+
+static void lane_ladder_generic(uint32_t (*X)[ECIES_NUMWORDS], uint32_t (*Z)[ECIES_NUMWORDS],
+                                const uint32_t (*x)[ECIES_NUMWORDS], const uint32_t (*k)[ECIES_NUMWORDS])
+{
+  lane_ladder(X, Z, x, k);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static void lane_ladder_avx2(uint32_t (*X)[ECIES_NUMWORDS], uint32_t (*Z)[ECIES_NUMWORDS],
+                             const uint32_t (*x)[ECIES_NUMWORDS], const uint32_t (*k)[ECIES_NUMWORDS])
+{
+  lane_ladder(X, Z, x, k);
+}
+
+#define LANE_HAS_AVX2 __builtin_cpu_supports("avx2")
+#else
+#define lane_ladder_avx2 lane_ladder_generic
+#define LANE_HAS_AVX2 0
+#endif
+
+/* x[l] := the x of 2 * k[l] * (x[l], .) for every lane, -1 where that is the point at infinity;
+   k[l] must be shorter than LANE_BITS bits and x[l] must not be zero */
+static void point_mult_lanes(int *res, elem_t *x, const exp_t *k)
+{
+  elem_t X[ECIES_LANES], Z[ECIES_LANES], t;
+  int l;
+  PROF_BEGIN(ECIES_PHASE_POINT_MULT);
+  PROF_MULT_ENTER();
+  if (LANE_HAS_AVX2)
+    lane_ladder_avx2(X, Z, (const uint32_t (*)[ECIES_NUMWORDS])x, (const uint32_t (*)[ECIES_NUMWORDS])k);
+  else
+    lane_ladder_generic(X, Z, (const uint32_t (*)[ECIES_NUMWORDS])x, (const uint32_t (*)[ECIES_NUMWORDS])k);
+  for(l = 0; l < ECIES_LANES; l++) {
+    if ((res[l] = bitstr_is_clear(Z[l]) ? -1 : 1) > 0) {
+      field_invert(t, Z[l]);
+      field_mult(x[l], X[l], t);
+    }
+  }
+  PROF_MULT_LEAVE();
+  PROF_END(ECIES_PHASE_POINT_MULT);
 }
 
+#endif/*ECIES_LANES*/
+
 #if RAND_MAX >= ((1 << 32) - 1) /* 4 random bytes */
 #define RAND_BYTES 4
 #elif RAND_MAX >= ((1 << 24) - 1) /* 3 random bytes */
@@ -329,35 +655,177 @@ static void point_mult(elem_t x, elem_t y, const exp_t exp)
 #error "RAND_MAX too small!"
 #endif
 
-/* draw a random value 'exp' with 1 <= exp < n */
-static void get_random_exponent(exp_t exp)
+/* fill the buffer backwards with random(), like the original code did */
+void ECIES_rng_libc(void *ctx, ECIES_byte_t *buf, ECIES_size_t len)
 {
-  ECIES_byte_t buf[4 * ECIES_NUMWORDS];
-  ECIES_byte_t *ptr = buf + 4 * ECIES_NUMWORDS - 1;
+  ECIES_byte_t *ptr = buf + len - 1;
   int r;
   long int val;
   
-  do {
-    for(; ptr >= buf + RAND_BYTES; ){
-      val = random();
+  for(; ptr >= buf + RAND_BYTES; ){
+    val = random();
+    *ptr-- = val;
+    for(r = 1; r < RAND_BYTES; r++){
+      val >>= 8;
       *ptr-- = val;
-      for(r = 1; r < RAND_BYTES; r++){
-        val >>= 8;
-        *ptr-- = val;
-      }
     }
-    if(ptr >= buf){
-      val = random();
-      for(; ptr >= buf; ){
-        *ptr-- = val;
-        val >>= 8;
-      }
+  }
+  if(ptr >= buf){
+    val = random();
+    for(; ptr >= buf; ){
+      *ptr-- = val;
+      val >>= 8;
+    }
+  }
+}
+
+/* the size of the per-thread keystream buffer, a multiple of the ChaCha20 block */
+#ifndef ECIES_RNG_BUFFER
+#define ECIES_RNG_BUFFER ECIES_PROFILE_PICK(64, 512, 4096)
+#endif
+
+#define CHACHA_ROTL(a, b) (((a) << (b)) | ((a) >> (32 - (b))))
+#define CHACHA_QR(a, b, c, d) MACRO( \
+  a += b; d ^= a; d = CHACHA_ROTL(d, 16); \
+  c += d; b ^= c; b = CHACHA_ROTL(b, 12); \
+  a += b; d ^= a; d = CHACHA_ROTL(d, 8);  \
+  c += d; b ^= c; b = CHACHA_ROTL(b, 7) )
+
+/* one ChaCha20 block with zero nonce */
+static void chacha20_block(ECIES_byte_t *out, const uint32_t *key, uint64_t ctr)
+{
+  uint32_t in[16], x[16];
+  int i;
+  in[0] = 0x61707865; in[1] = 0x3320646e; in[2] = 0x79622d32; in[3] = 0x6b206574;
+  memcpy(in + 4, key, 32);
+  in[12] = (uint32_t)ctr; in[13] = (uint32_t)(ctr >> 32);
+  in[14] = 0; in[15] = 0;
+  memcpy(x, in, sizeof(x));
+  for(i = 0; i < 10; i++) {
+    CHACHA_QR(x[0], x[4], x[8], x[12]);
+    CHACHA_QR(x[1], x[5], x[9], x[13]);
+    CHACHA_QR(x[2], x[6], x[10], x[14]);
+    CHACHA_QR(x[3], x[7], x[11], x[15]);
+    CHACHA_QR(x[0], x[5], x[10], x[15]);
+    CHACHA_QR(x[1], x[6], x[11], x[12]);
+    CHACHA_QR(x[2], x[7], x[8], x[13]);
+    CHACHA_QR(x[3], x[4], x[9], x[14]);
+  }
+  for(i = 0; i < 16; i++)
+    memcpy(out + 4 * i, (x[i] += in[i], &x[i]), 4);
+}
+
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/random.h>
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__)
+#include <sys/random.h>
+#define getrandom(buf, len, flags) (getentropy(buf, len) ? -1 : (ssize_t)(len))
+#else
+#include <stdio.h>
+static ssize_t getrandom(void *buf, size_t len, unsigned int flags)
+{
+  FILE *f = fopen("/dev/urandom", "rb");
+  size_t n = f ? fread(buf, 1, len, f) : 0;
+  if (f) fclose(f);
+  return n == len ? (ssize_t)len : -1;
+}
+#endif
+
+static __thread struct {
+  uint32_t key[8];
+  ECIES_byte_t buf[ECIES_RNG_BUFFER];
+  ECIES_size_t pos;
+  unsigned gen;
+} rng_state;
+
+/* bumped in every forked child, a thread whose state is of another generation reseeds;
+   it starts at 1 so a thread's zeroed state is never current */
+static volatile unsigned rng_gen = 1;
+static pthread_once_t rng_once = PTHREAD_ONCE_INIT;
+
+static void rng_forked(void)
+{
+  rng_gen++;
+}
+
+static void rng_atfork(void)
+{
+  pthread_atfork(NULL, NULL, rng_forked);
+}
+
+/* fill 'buf' from the OS, retrying interrupted and short reads; without
+   a working source there is nothing safe to hand out */
+static void rng_seed(void *buf, size_t len)
+{
+  ECIES_byte_t *p = buf;
+  ssize_t n;
+  while (len > 0) {
+    n = getrandom(p, len, 0);
+    if (n > 0) {
+      p += n;
+      len -= n;
     }
+    else if (n == 0 || errno != EINTR)
+      abort();
+  }
+}
+
+/* refill the buffer, the first 32 bytes of the new keystream become the next key */
+static void rng_refill(void)
+{
+  uint64_t ctr;
+  if (rng_state.gen != rng_gen) { /* first use in this thread or forked child */
+    pthread_once(&rng_once, rng_atfork);
+    rng_seed(rng_state.key, sizeof(rng_state.key));
+    rng_state.gen = rng_gen;
+  }
+  for(ctr = 0; ctr < ECIES_RNG_BUFFER / 64; ctr++)
+    chacha20_block(rng_state.buf + 64 * ctr, rng_state.key, ctr);
+  memcpy(rng_state.key, rng_state.buf, sizeof(rng_state.key));
+  memset(rng_state.buf, 0, sizeof(rng_state.key));
+  rng_state.pos = sizeof(rng_state.key);
+}
+
+void ECIES_rng_default(void *ctx, ECIES_byte_t *buf, ECIES_size_t len)
+{
+  ECIES_size_t n;
+  for(; len > 0; len -= n, buf += n) {
+    if (rng_state.pos >= ECIES_RNG_BUFFER || rng_state.gen != rng_gen)
+      rng_refill();
+    n = MIN(len, ECIES_RNG_BUFFER - rng_state.pos);
+    memcpy(buf, rng_state.buf + rng_state.pos, n);
+    memset(rng_state.buf + rng_state.pos, 0, n); /* never hand out the same bytes twice */
+    rng_state.pos += n;
+  }
+}
+
+static ECIES_rng_t rng = ECIES_rng_default;
+static void *rng_ctx = NULL;
+
+void ECIES_set_rng(ECIES_rng_t fn, void *ctx)
+{
+  rng = fn ? fn : ECIES_rng_default;
+  rng_ctx = ctx;
+}
+
+/* draw a random value 'exp' with 1 <= exp < n */
+static void get_random_exponent(exp_t exp)
+{
+  ECIES_byte_t buf[4 * ECIES_NUMWORDS];
+  int r;
+  
+  do {
+    rng(rng_ctx, buf, sizeof(buf));
     
     bitstr_import(exp, buf);
     for(r = bitstr_sizeinbits(base_order) - 1; r < ECIES_NUMWORDS * 32; r++)
       bitstr_clrbit(exp, r);
   } while(bitstr_is_clear(exp));
+  
+  memset(buf, 0, sizeof(buf));
 }
 
 static void XTEA_init_key(uint32_t *k, const ECIES_byte_t *key)
@@ -379,30 +847,33 @@ static void XTEA_encipher_block(ECIES_byte_t *data, const uint32_t *k)
   }
   INT2CHARS(data, y); INT2CHARS(data + 4, z);
 }
-/* encrypt in CTR mode */
-static void XTEA_ctr_crypt(ECIES_byte_t *data, ECIES_size_t size, const ECIES_byte_t *key)
+/* encrypt in CTR mode, the nonce takes the upper half of the counter block */
+static void XTEA_ctr_crypt(ECIES_byte_t *data, ECIES_size_t size, const ECIES_byte_t *key, uint32_t nonce)
 {
   uint32_t k[4], ctr = 0;
   ECIES_size_t len, i;
   ECIES_byte_t buf[8];
+  PROF_BEGIN(ECIES_PHASE_CTR_CRYPT);
   XTEA_init_key(k, key);
   while(size) {
-    INT2CHARS(buf, 0); INT2CHARS(buf + 4, ctr++);
+    INT2CHARS(buf, nonce); INT2CHARS(buf + 4, ctr++);
     XTEA_encipher_block(buf, k);
     len = MIN(8, size);
     for(i = 0; i < len; i++)
       *data++ ^= buf[i];
     size -= len;
   }
+  PROF_END(ECIES_PHASE_CTR_CRYPT);
 }
 
-/* calculate the CBC MAC */
-static void XTEA_cbcmac(ECIES_byte_t *mac, const ECIES_byte_t *data, ECIES_size_t size, const ECIES_byte_t *key)
+/* calculate the CBC MAC, the nonce goes into the length block */
+static void XTEA_cbcmac(ECIES_byte_t *mac, const ECIES_byte_t *data, ECIES_size_t size, const ECIES_byte_t *key, uint32_t nonce)
 {
   uint32_t k[4];
   ECIES_size_t len, i;
+  PROF_BEGIN(ECIES_PHASE_CBCMAC);
   XTEA_init_key(k, key);
-  INT2CHARS(mac, 0);
+  INT2CHARS(mac, nonce);
   INT2CHARS(mac + 4, size);
   XTEA_encipher_block(mac, k);
   while(size) {
@@ -412,6 +883,7 @@ static void XTEA_cbcmac(ECIES_byte_t *mac, const ECIES_byte_t *data, ECIES_size_
     XTEA_encipher_block(mac, k);
     size -= len;
   }
+  PROF_END(ECIES_PHASE_CBCMAC);
 }
 
 /* modified(!) Davies-Meyer construction.*/
@@ -447,6 +919,111 @@ void ECIES_generate_keys(ECIES_privkey_t *priv,
   bitstr_dump(priv->k, ECIES_KEY_SIZE, k);
 }
 
+/* the number of keys which share one field inversion */
+#ifndef ECIES_KEYGEN_BATCH
+#define ECIES_KEYGEN_BATCH ECIES_PROFILE_PICK(8, 64, 128)
+#endif
+
+/* add the table points (x2[i], y2[i]) to (x1[i], y1[i]) for all i < n at once,
+   the inversions of all generic additions are merged into one (Montgomery's trick) */
+static void point_add_batch(elem_t *x1, elem_t *y1, const uint32_t **x2, const uint32_t **y2, int n)
+{
+  elem_t b[ECIES_KEYGEN_BATCH], c[ECIES_KEYGEN_BATCH], inv, t, d;
+  int idx[ECIES_KEYGEN_BATCH], i, m = 0;
+  
+  for(i = 0; i < n; i++) {
+    if (! x2[i])
+      continue;
+    if (point_is_zero(x1[i], y1[i]) || bitstr_is_equal(x1[i], x2[i]))
+      point_add(x1[i], y1[i], x2[i], y2[i]); /* special cases */
+    else {
+      field_add(b[m], x1[i], x2[i]);
+      if (m)
+        field_mult(c[m], c[m - 1], b[m]);
+      else
+        bitstr_copy(c[m], b[m]);
+      idx[m++] = i;
+    }
+  }
+  
+  if (! m)
+    return;
+  
+  field_invert(inv, c[m - 1]);
+  
+  for(; m--; ) {
+    i = idx[m];
+    /* t = 1 / b[m] */
+    if (m) {
+      field_mult(t, inv, c[m - 1]);
+      field_mult(inv, inv, b[m]);
+    } else
+      bitstr_copy(t, inv);
+    /* same steps as point_add() from here */
+    field_add(d, y1[i], y2[i]);
+    field_mult(c[m], t, d);
+    field_mult(d, c[m], c[m]);
+    field_add(d, d, c[m]);
+    field_add(d, d, b[m]);
+    field_add1(d);
+    field_add(x1[i], x1[i], d);
+    field_mult(t, x1[i], c[m]);
+    field_add(t, t, d);
+    field_add(y1[i], y1[i], t);
+    bitstr_copy(x1[i], d);
+  }
+}
+
+int ECIES_generate_keys_batch(ECIES_privkey_t *priv, ECIES_pubkey_t *pub, ECIES_size_t n)
+{
+  elem_t x[ECIES_KEYGEN_BATCH], y[ECIES_KEYGEN_BATCH];
+  exp_t k[ECIES_KEYGEN_BATCH];
+  const uint32_t *tx[ECIES_KEYGEN_BATCH], *ty[ECIES_KEYGEN_BATCH];
+  ECIES_pubkey_table_t *base;
+  unsigned int d;
+  int i, j, m;
+  
+  if (n < 4) { /* the table does not pay off */
+    for(; n--; )
+      ECIES_generate_keys(priv++, pub++);
+    return 1;
+  }
+  
+  if (! (base = malloc(sizeof(ECIES_pubkey_table_t))))
+    return -1;
+  
+  point_table_init(base->xy, base_x, base_y);
+  
+  for(; n > 0; n -= m, priv += m, pub += m) {
+    m = n < ECIES_KEYGEN_BATCH ? n : ECIES_KEYGEN_BATCH;
+    
+    for(i = 0; i < m; i++) {
+      get_random_exponent(k[i]);
+      point_set_zero(x[i], y[i]);
+    }
+    
+    for(j = 0; j < ECIES_COMB_WINDOWS; j++) {
+      for(i = 0; i < m; i++) {
+        d = exp_window(k[i], j * ECIES_COMB_WIDTH);
+        tx[i] = d ? base->xy[j * COMB_DIGITS + d - 1][0] : NULL;
+        ty[i] = d ? base->xy[j * COMB_DIGITS + d - 1][1] : NULL;
+      }
+      point_add_batch(x, y, tx, ty, m);
+    }
+    
+    for(i = 0; i < m; i++) {
+      bitstr_dump(pub[i].x, ECIES_KEY_SIZE, x[i]);
+      bitstr_dump(pub[i].y, ECIES_KEY_SIZE, y[i]);
+      bitstr_dump(priv[i].k, ECIES_KEY_SIZE, k[i]);
+    }
+  }
+  
+  memset(k, 0, sizeof(k));
+  free(base);
+  
+  return 1;
+}
+
 /* check that a given elem_t-pair is a valid point on the curve != 'o' */
 static int ECIES_intern_validate_pubkey(const elem_t Px, const elem_t Py)
 {
@@ -476,6 +1053,7 @@ static void ECIES_kdf(ECIES_byte_t *k1, ECIES_byte_t *k2, const elem_t Zx,
 {
   ECIES_size_t bufsize = (3 * (4 * ECIES_NUMWORDS) + 1 + 15) & ~15;
   ECIES_byte_t buf[bufsize];
+  PROF_BEGIN(ECIES_PHASE_KDF);
   memset(buf, 0, bufsize);
   bitstr_export(buf, Zx);
   bitstr_export(buf + 4 * ECIES_NUMWORDS, Rx);
@@ -484,6 +1062,51 @@ static void ECIES_kdf(ECIES_byte_t *k1, ECIES_byte_t *k2, const elem_t Zx,
   buf[12 * ECIES_NUMWORDS] = 1; XTEA_davies_meyer(k1 + 8, buf, bufsize / 16);
   buf[12 * ECIES_NUMWORDS] = 2; XTEA_davies_meyer(k2, buf, bufsize / 16);
   buf[12 * ECIES_NUMWORDS] = 3; XTEA_davies_meyer(k2 + 8, buf, bufsize / 16);
+  PROF_END(ECIES_PHASE_KDF);
+}
+
+/* the key ID, the first bytes of a hash of the public key, domain separated from the KDF */
+static uint32_t ECIES_intern_key_id(const elem_t Px, const elem_t Py)
+{
+  ECIES_byte_t buf[(2 * (4 * ECIES_NUMWORDS) + 1 + 15) & ~15], out[8];
+  memset(buf, 0, sizeof(buf));
+  bitstr_export(buf, Px);
+  bitstr_export(buf + 4 * ECIES_NUMWORDS, Py);
+  buf[8 * ECIES_NUMWORDS] = 'I';
+  XTEA_davies_meyer(out, buf, sizeof(buf) / 16);
+  return CHARS2INT(out);
+}
+
+uint32_t ECIES_key_id(const ECIES_pubkey_t *pubkey)
+{
+  elem_t x, y;
+  
+  bitstr_load(x, pubkey->x, ECIES_KEY_SIZE);
+  bitstr_load(y, pubkey->y, ECIES_KEY_SIZE);
+  
+  return ECIES_intern_key_id(x, y);
+}
+
+int ECIES_derive_pubkey(ECIES_pubkey_t *pub, const ECIES_privkey_t *priv)
+{
+  elem_t x, y;
+  exp_t d;
+  
+  bitstr_load(d, priv->k, ECIES_KEY_SIZE);
+  if (bitstr_is_clear(d))
+    return -1;
+  
+  point_copy(x, y, base_x, base_y);
+  point_mult(x, y, d);
+  memset(d, 0, sizeof(d));
+  
+  if (point_is_zero(x, y))
+    return -1;
+  
+  bitstr_dump(pub->x, ECIES_KEY_SIZE, x);
+  bitstr_dump(pub->y, ECIES_KEY_SIZE, y);
+  
+  return 1;
 }
 
 void ECIES_encrypt(ECIES_byte_t *msg, const char *raw, ECIES_size_t len, const ECIES_pubkey_t *pubkey){
@@ -496,67 +1119,352 @@ void ECIES_encrypt(ECIES_byte_t *msg, const char *raw, ECIES_size_t len, const E
   ECIES_encrypt_chunk(&stm, msg + ECIES_START_OVERHEAD, len);
 }
 
-int ECIES_decrypt(char *raw, ECIES_size_t len, const ECIES_byte_t *msg, const ECIES_privkey_t *privkey){
-  int res;
-  ECIES_stream_t stm;
+/* the data part of ECIES_decrypt() once the keys are known */
+static int ECIES_intern_decrypt_data(const ECIES_stream_t *stm, char *raw, ECIES_size_t len, const ECIES_byte_t *msg){
+  int start = ECIES_start_size(msg);
   ECIES_byte_t mac[ECIES_CHUNK_OVERHEAD];
   
-  if((res = ECIES_decrypt_start(&stm, msg, privkey)) < 0){
-    return res;
-  }
-  
-  XTEA_cbcmac(mac, msg + ECIES_START_OVERHEAD, len, stm.k2);
+  XTEA_cbcmac(mac, msg + start, len, stm->k2, 0);
   
-  if(memcmp(mac, msg + ECIES_START_OVERHEAD + len, ECIES_CHUNK_OVERHEAD)){
+  if(memcmp(mac, msg + start + len, ECIES_CHUNK_OVERHEAD)){
     return -2;
   }
   
-  memcpy(raw, msg + ECIES_START_OVERHEAD, len);
+  memcpy(raw, msg + start, len);
   
-  XTEA_ctr_crypt((ECIES_byte_t*)raw, len, stm.k1);
+  XTEA_ctr_crypt((ECIES_byte_t*)raw, len, stm->k1, 0);
   
   return 1;
 }
 
-void ECIES_encrypt_start(ECIES_stream_t *stm, ECIES_byte_t *msg, const ECIES_pubkey_t *pubkey)
-{
-  elem_t Rx, Ry, Zx, Zy;
-  exp_t k;
+int ECIES_decrypt(char *raw, ECIES_size_t len, const ECIES_byte_t *msg, const ECIES_privkey_t *privkey){
+  int res;
+  ECIES_stream_t stm;
   
-  do {
-    get_random_exponent(k);
-    bitstr_load(Zx, pubkey->x, ECIES_KEY_SIZE);
-    bitstr_load(Zy, pubkey->y, ECIES_KEY_SIZE);
-    point_mult(Zx, Zy, k);
-    point_double(Zx, Zy); /* cofactor h = 2 on B163 */
-  } while(point_is_zero(Zx, Zy));
-  point_copy(Rx, Ry, base_x, base_y);
-  point_mult(Rx, Ry, k);
-  ECIES_kdf(stm->k1, stm->k2, Zx, Rx, Ry);
+  if((res = ECIES_decrypt_start(&stm, msg, privkey)) < 0){
+    return res;
+  }
   
-  bitstr_export(msg, Rx);
-  bitstr_export(msg + 4 * ECIES_NUMWORDS, Ry);
+  return ECIES_intern_decrypt_data(&stm, raw, len, msg);
 }
 
-void ECIES_encrypt_chunk(const ECIES_stream_t *stm, ECIES_byte_t *msg, ECIES_size_t len)
-{
-  XTEA_ctr_crypt(msg, len, stm->k1);
-  XTEA_cbcmac(msg + len, msg, len, stm->k2);
-}
+/* the messages of ECIES_decrypt_batch() which share one ladder */
+#define DECRYPT_BATCH (ECIES_LANES > 0 ? ECIES_LANES : 1)
 
-/* ECIES decryption */
-int ECIES_decrypt_start(ECIES_stream_t *stm, const ECIES_byte_t *msg, const ECIES_privkey_t *privkey)
-{
-  elem_t Rx, Ry, Zx, Zy;
-  exp_t d;
+int ECIES_decrypt_batch(int *res, char *const *raw, const ECIES_size_t *len, const ECIES_byte_t *const *msg,
+                        ECIES_size_t n, const ECIES_privkey_t *privkey){
+  ECIES_stream_t stm[DECRYPT_BATCH];
+  int i, m, ok = 0;
   
-  bitstr_import(Rx, msg);
-  bitstr_import(Ry, msg + 4 * ECIES_NUMWORDS);
-  
-  if (ECIES_intern_validate_pubkey(Rx, Ry) < 0)
-    return -1;
-  
-  bitstr_load(d, privkey->k, ECIES_KEY_SIZE);
+  for(; n > 0; n -= m, res += m, raw += m, len += m, msg += m){
+    m = n < DECRYPT_BATCH ? n : DECRYPT_BATCH;
+    
+    ECIES_decrypt_start_batch(stm, res, msg, m, privkey);
+    
+    for(i = 0; i < m; i++){
+      if(res[i] > 0 && (res[i] = ECIES_intern_decrypt_data(&stm[i], raw[i], len[i], msg[i])) > 0){
+        ok++;
+      }
+    }
+  }
+  
+  memset(stm, 0, sizeof(stm));
+  
+  return ok;
+}
+
+/* the source and its context are published together as one pointer; a pair is never freed,
+   an encryption may still be reading the previous one, and setting the same pair again reuses it */
+typedef struct ephemeral_pair {
+  ECIES_ephemeral_source_t src;
+  void *ctx;
+  struct ephemeral_pair *next;
+} ephemeral_pair_t;
+
+static ephemeral_pair_t *ephemeral_source = NULL;
+static ephemeral_pair_t *ephemeral_pairs = NULL;
+static pthread_mutex_t ephemeral_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void ECIES_set_ephemeral_source(ECIES_ephemeral_source_t src, void *ctx)
+{
+  ephemeral_pair_t *pair = NULL;
+  
+  pthread_mutex_lock(&ephemeral_lock);
+  if (src) {
+    for(pair = ephemeral_pairs; pair; pair = pair->next)
+      if (pair->src == src && pair->ctx == ctx)
+        break;
+    if (!pair && (pair = malloc(sizeof(ephemeral_pair_t)))) {
+      pair->src = src;
+      pair->ctx = ctx;
+      pair->next = ephemeral_pairs;
+      ephemeral_pairs = pair;
+    }
+  }
+  /* out of memory leaves no source, encryption then generates its own keys */
+  __atomic_store_n(&ephemeral_source, pair, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&ephemeral_lock);
+}
+
+void ECIES_generate_ephemeral(ECIES_ephemeral_t *eph)
+{
+  ECIES_generate_keys(&eph->k, &eph->R);
+}
+
+/* Z = 2 * k * P, via the table when given */
+static void ECIES_intern_shared_point(elem_t Zx, elem_t Zy, const elem_t Px, const elem_t Py,
+                                      const ECIES_pubkey_table_t *tab, const exp_t k)
+{
+  if (tab)
+    point_mult_table(Zx, Zy, tab->xy, k);
+  else {
+    point_copy(Zx, Zy, Px, Py);
+    point_mult(Zx, Zy, k);
+  }
+  point_double(Zx, Zy); /* cofactor h = 2 on B163 */
+}
+
+/* the forms of a single-recipient starting sequence */
+#define START_PLAIN 0
+#define START_COMPACT 1
+#define START_KEYED 2
+
+/* the shared part of the encryption start, uses the table when given, writes R in the given form */
+static void ECIES_intern_encrypt_start(ECIES_stream_t *stm, ECIES_byte_t *msg, const elem_t Px, const elem_t Py,
+                                       const ECIES_pubkey_table_t *tab, int form)
+{
+  elem_t Rx, Ry, Zx, Zy;
+  exp_t k;
+  ECIES_ephemeral_t eph;
+  const ephemeral_pair_t *source = __atomic_load_n(&ephemeral_source, __ATOMIC_ACQUIRE);
+  
+  /* a precomputed (k, R) saves the k * G half */
+  if (source && source->src(source->ctx, &eph) > 0) {
+    bitstr_load(k, eph.k.k, ECIES_KEY_SIZE);
+    bitstr_load(Rx, eph.R.x, ECIES_KEY_SIZE);
+    bitstr_load(Ry, eph.R.y, ECIES_KEY_SIZE);
+    memset(&eph, 0, sizeof(eph));
+    ECIES_intern_shared_point(Zx, Zy, Px, Py, tab, k);
+  }
+  else
+    point_set_zero(Zx, Zy);
+  
+  if (point_is_zero(Zx, Zy)) {
+    do {
+      get_random_exponent(k);
+      ECIES_intern_shared_point(Zx, Zy, Px, Py, tab, k);
+    } while(point_is_zero(Zx, Zy));
+    point_copy(Rx, Ry, base_x, base_y);
+    point_mult(Rx, Ry, k);
+  }
+  
+  memset(k, 0, sizeof(k));
+  ECIES_kdf(stm->k1, stm->k2, Zx, Rx, Ry);
+  
+  switch (form) {
+  case START_COMPACT:
+    msg[0] = ECIES_COMPACT_TAG | point_ybit(Rx, Ry);
+    bitstr_dump(msg + 1, ECIES_KEY_SIZE, Rx);
+    break;
+  case START_KEYED:
+    msg[0] = ECIES_KEYED_TAG | point_ybit(Rx, Ry);
+    /* the prepared table starts with P itself */
+    INT2CHARS(msg + 1, tab ? ECIES_intern_key_id(tab->xy[0][0], tab->xy[0][1]) : ECIES_intern_key_id(Px, Py));
+    bitstr_dump(msg + 1 + ECIES_KEY_ID_SIZE, ECIES_KEY_SIZE, Rx);
+    break;
+  default:
+    bitstr_export(msg, Rx);
+    bitstr_export(msg + 4 * ECIES_NUMWORDS, Ry);
+  }
+}
+
+void ECIES_encrypt_start(ECIES_stream_t *stm, ECIES_byte_t *msg, const ECIES_pubkey_t *pubkey)
+{
+  elem_t Px, Py;
+  
+  bitstr_load(Px, pubkey->x, ECIES_KEY_SIZE);
+  bitstr_load(Py, pubkey->y, ECIES_KEY_SIZE);
+  
+  ECIES_intern_encrypt_start(stm, msg, Px, Py, NULL, START_PLAIN);
+}
+
+void ECIES_encrypt_start_compact(ECIES_stream_t *stm, ECIES_byte_t *msg, const ECIES_pubkey_t *pubkey)
+{
+  elem_t Px, Py;
+  
+  bitstr_load(Px, pubkey->x, ECIES_KEY_SIZE);
+  bitstr_load(Py, pubkey->y, ECIES_KEY_SIZE);
+  
+  ECIES_intern_encrypt_start(stm, msg, Px, Py, NULL, START_COMPACT);
+}
+
+void ECIES_encrypt_start_keyed(ECIES_stream_t *stm, ECIES_byte_t *msg, const ECIES_pubkey_t *pubkey)
+{
+  elem_t Px, Py;
+  
+  bitstr_load(Px, pubkey->x, ECIES_KEY_SIZE);
+  bitstr_load(Py, pubkey->y, ECIES_KEY_SIZE);
+  
+  ECIES_intern_encrypt_start(stm, msg, Px, Py, NULL, START_KEYED);
+}
+
+int ECIES_prepare_pubkey(ECIES_pubkey_table_t *tab, const ECIES_pubkey_t *pubkey)
+{
+  elem_t Px, Py;
+  
+  if (ECIES_validate_pubkey(pubkey) < 0)
+    return -1;
+  
+  bitstr_load(Px, pubkey->x, ECIES_KEY_SIZE);
+  bitstr_load(Py, pubkey->y, ECIES_KEY_SIZE);
+  
+  point_table_init(tab->xy, Px, Py);
+  
+  return 1;
+}
+
+/* the first entry of the table is 1 * P */
+int ECIES_prepared_is_of(const ECIES_pubkey_table_t *tab, const ECIES_pubkey_t *pubkey)
+{
+  elem_t Px, Py;
+  
+  bitstr_load(Px, pubkey->x, ECIES_KEY_SIZE);
+  bitstr_load(Py, pubkey->y, ECIES_KEY_SIZE);
+  
+  return bitstr_is_equal(tab->xy[0][0], Px) && bitstr_is_equal(tab->xy[0][1], Py);
+}
+
+void ECIES_encrypt_start_prepared(ECIES_stream_t *stm, ECIES_byte_t *msg, const ECIES_pubkey_table_t *tab)
+{
+  ECIES_intern_encrypt_start(stm, msg, NULL, NULL, tab, START_PLAIN);
+}
+
+void ECIES_encrypt_start_compact_prepared(ECIES_stream_t *stm, ECIES_byte_t *msg, const ECIES_pubkey_table_t *tab)
+{
+  ECIES_intern_encrypt_start(stm, msg, NULL, NULL, tab, START_COMPACT);
+}
+
+void ECIES_encrypt_start_keyed_prepared(ECIES_stream_t *stm, ECIES_byte_t *msg, const ECIES_pubkey_table_t *tab)
+{
+  ECIES_intern_encrypt_start(stm, msg, NULL, NULL, tab, START_KEYED);
+}
+
+void ECIES_encrypt_prepared(ECIES_byte_t *msg, const char *raw, ECIES_size_t len, const ECIES_pubkey_table_t *tab){
+  ECIES_stream_t stm;
+  
+  ECIES_encrypt_start_prepared(&stm, msg, tab);
+  
+  memcpy(msg + ECIES_START_OVERHEAD, raw, len);
+  
+  ECIES_encrypt_chunk(&stm, msg + ECIES_START_OVERHEAD, len);
+}
+
+void ECIES_encrypt_compact(ECIES_byte_t *msg, const char *raw, ECIES_size_t len, const ECIES_pubkey_t *pubkey){
+  ECIES_stream_t stm;
+  
+  ECIES_encrypt_start_compact(&stm, msg, pubkey);
+  
+  memcpy(msg + ECIES_COMPACT_START_OVERHEAD, raw, len);
+  
+  ECIES_encrypt_chunk(&stm, msg + ECIES_COMPACT_START_OVERHEAD, len);
+}
+
+void ECIES_encrypt_compact_prepared(ECIES_byte_t *msg, const char *raw, ECIES_size_t len, const ECIES_pubkey_table_t *tab){
+  ECIES_stream_t stm;
+  
+  ECIES_encrypt_start_compact_prepared(&stm, msg, tab);
+  
+  memcpy(msg + ECIES_COMPACT_START_OVERHEAD, raw, len);
+  
+  ECIES_encrypt_chunk(&stm, msg + ECIES_COMPACT_START_OVERHEAD, len);
+}
+
+void ECIES_encrypt_keyed(ECIES_byte_t *msg, const char *raw, ECIES_size_t len, const ECIES_pubkey_t *pubkey){
+  ECIES_stream_t stm;
+  
+  ECIES_encrypt_start_keyed(&stm, msg, pubkey);
+  
+  memcpy(msg + ECIES_KEYED_START_OVERHEAD, raw, len);
+  
+  ECIES_encrypt_chunk(&stm, msg + ECIES_KEYED_START_OVERHEAD, len);
+}
+
+void ECIES_encrypt_keyed_prepared(ECIES_byte_t *msg, const char *raw, ECIES_size_t len, const ECIES_pubkey_table_t *tab){
+  ECIES_stream_t stm;
+  
+  ECIES_encrypt_start_keyed_prepared(&stm, msg, tab);
+  
+  memcpy(msg + ECIES_KEYED_START_OVERHEAD, raw, len);
+  
+  ECIES_encrypt_chunk(&stm, msg + ECIES_KEYED_START_OVERHEAD, len);
+}
+
+void ECIES_encrypt_chunk(const ECIES_stream_t *stm, ECIES_byte_t *msg, ECIES_size_t len)
+{
+  XTEA_ctr_crypt(msg, len, stm->k1, 0);
+  XTEA_cbcmac(msg + len, msg, len, stm->k2, 0);
+}
+
+/* chunk i of an indexed stream uses nonce i + 1, nonce 0 is the position-free legacy chunk */
+void ECIES_encrypt_chunk_at(const ECIES_stream_t *stm, ECIES_size_t index, ECIES_byte_t *msg, ECIES_size_t len)
+{
+  XTEA_ctr_crypt(msg, len, stm->k1, index + 1);
+  XTEA_cbcmac(msg + len, msg, len, stm->k2, index + 1);
+}
+
+/* a plain start sequence begins with the zero top byte of Rx */
+int ECIES_start_size(const ECIES_byte_t *msg)
+{
+  if ((msg[0] & ~1) == ECIES_COMPACT_TAG)
+    return ECIES_COMPACT_START_OVERHEAD;
+  if ((msg[0] & ~1) == ECIES_KEYED_TAG)
+    return ECIES_KEYED_START_OVERHEAD;
+  return msg[0] ? -1 : ECIES_START_OVERHEAD;
+}
+
+int ECIES_start_key_id(const ECIES_byte_t *msg, uint32_t *id)
+{
+  if ((msg[0] & ~1) != ECIES_KEYED_TAG)
+    return 0;
+  *id = CHARS2INT(msg + 1);
+  return 1;
+}
+
+/* R of a starting sequence, plain, compact or keyed, checked to be on the curve */
+static int ECIES_intern_decode_start(elem_t Rx, elem_t Ry, const ECIES_byte_t *msg)
+{
+  switch (ECIES_start_size(msg)) {
+  case ECIES_COMPACT_START_OVERHEAD:
+    bitstr_load(Rx, msg + 1, ECIES_KEY_SIZE);
+    if (point_decompress(Ry, Rx, msg[0] & 1) < 0)
+      return -1;
+    break;
+  case ECIES_KEYED_START_OVERHEAD:
+    bitstr_load(Rx, msg + 1 + ECIES_KEY_ID_SIZE, ECIES_KEY_SIZE);
+    if (point_decompress(Ry, Rx, msg[0] & 1) < 0)
+      return -1;
+    break;
+  case ECIES_START_OVERHEAD:
+    bitstr_import(Rx, msg);
+    bitstr_import(Ry, msg + 4 * ECIES_NUMWORDS);
+    break;
+  default:
+    return -1;
+  }
+  
+  return ECIES_intern_validate_pubkey(Rx, Ry);
+}
+
+/* ECIES decryption */
+int ECIES_decrypt_start(ECIES_stream_t *stm, const ECIES_byte_t *msg, const ECIES_privkey_t *privkey)
+{
+  elem_t Rx, Ry, Zx, Zy;
+  exp_t d;
+  
+  if (ECIES_intern_decode_start(Rx, Ry, msg) < 0)
+    return -1;
+  
+  bitstr_load(d, privkey->k, ECIES_KEY_SIZE);
   point_copy(Zx, Zy, Rx, Ry);
   point_mult(Zx, Zy, d);
   point_double(Zx, Zy); /* cofactor h = 2 on B163 */
@@ -569,16 +1477,575 @@ int ECIES_decrypt_start(ECIES_stream_t *stm, const ECIES_byte_t *msg, const ECIE
   return 1;
 }
 
+int ECIES_decrypt_start_batch(ECIES_stream_t *stm, int *res, const ECIES_byte_t *const *msg, ECIES_size_t n,
+                              const ECIES_privkey_t *privkey)
+{
+#if ECIES_LANES
+  elem_t Rx[ECIES_LANES], Ry[ECIES_LANES], Zx[ECIES_LANES];
+  exp_t d[ECIES_LANES];
+  int valid[ECIES_LANES], zres[ECIES_LANES], i, m, ok = 0;
+  
+  bitstr_load(d[0], privkey->k, ECIES_KEY_SIZE);
+  for(i = 1; i < ECIES_LANES; i++)
+    bitstr_copy(d[i], d[0]);
+  
+  for(; n > 0; n -= m, stm += m, res += m, msg += m) {
+    m = n < ECIES_LANES ? n : ECIES_LANES;
+    
+    /* the lanes of bad or missing messages multiply the base point;
+       an R of order two, x = 0, ends at the point at infinity as in ECIES_decrypt_start() */
+    for(i = 0; i < ECIES_LANES; i++) {
+      valid[i] = i < m && ECIES_intern_decode_start(Rx[i], Ry[i], msg[i]) > 0 && ! bitstr_is_clear(Rx[i]);
+      bitstr_copy(Zx[i], valid[i] ? Rx[i] : base_x);
+    }
+    
+    point_mult_lanes(zres, Zx, d);
+    
+    for(i = 0; i < m; i++) {
+      if ((res[i] = valid[i] ? zres[i] : -1) > 0) {
+        ECIES_kdf(stm[i].k1, stm[i].k2, Zx[i], Rx[i], Ry[i]);
+        ok++;
+      }
+    }
+  }
+  
+  memset(d, 0, sizeof(d));
+  
+  return ok;
+#else
+  int ok = 0;
+  
+  for(; n > 0; n--)
+    if ((*res++ = ECIES_decrypt_start(stm++, *msg++, privkey)) > 0)
+      ok++;
+  
+  return ok;
+#endif
+}
+
 int ECIES_decrypt_chunk(const ECIES_stream_t *stm, ECIES_byte_t *msg, ECIES_size_t len)
 {
   ECIES_byte_t mac[ECIES_CHUNK_OVERHEAD];
   
-  XTEA_cbcmac(mac, msg, len, stm->k2);
+  XTEA_cbcmac(mac, msg, len, stm->k2, 0);
   
   if (memcmp(mac, msg + len, ECIES_CHUNK_OVERHEAD))
     return -2;
   
-  XTEA_ctr_crypt(msg, len, stm->k1);
+  XTEA_ctr_crypt(msg, len, stm->k1, 0);
+  
+  return 1;
+}
+
+int ECIES_decrypt_chunk_at(const ECIES_stream_t *stm, ECIES_size_t index, ECIES_byte_t *msg, ECIES_size_t len)
+{
+  ECIES_byte_t mac[ECIES_CHUNK_OVERHEAD];
+  
+  XTEA_cbcmac(mac, msg, len, stm->k2, index + 1);
+  
+  if (memcmp(mac, msg + len, ECIES_CHUNK_OVERHEAD))
+    return -2;
+  
+  XTEA_ctr_crypt(msg, len, stm->k1, index + 1);
+  
+  return 1;
+}
+
+/* the trailer nonce, out of reach of chunk indices */
+#define INDEX_NONCE 0xffffffff
+
+void ECIES_index_encode(const ECIES_stream_t *stm, ECIES_byte_t *msg, ECIES_size_t chunk_size, uint64_t length)
+{
+  memcpy(msg, ECIES_INDEX_MAGIC, 4);
+  INT2CHARS(msg + 4, chunk_size);
+  INT2CHARS(msg + 8, length >> 32);
+  INT2CHARS(msg + 12, length);
+  XTEA_cbcmac(msg + 16, msg, 16, stm->k2, INDEX_NONCE);
+}
+
+int ECIES_index_decode(const ECIES_stream_t *stm, const ECIES_byte_t *msg, ECIES_size_t *chunk_size, uint64_t *length)
+{
+  ECIES_byte_t mac[ECIES_CHUNK_OVERHEAD];
+  
+  if (memcmp(msg, ECIES_INDEX_MAGIC, 4))
+    return -3;
+  
+  XTEA_cbcmac(mac, msg, 16, stm->k2, INDEX_NONCE);
+  
+  if (memcmp(mac, msg + 16, ECIES_CHUNK_OVERHEAD))
+    return -2;
+  
+  *chunk_size = CHARS2INT(msg + 4);
+  *length = (uint64_t)CHARS2INT(msg + 8) << 32 | CHARS2INT(msg + 12);
+  
+  return *chunk_size > 0 && *chunk_size < INDEX_NONCE ? 1 : -3;
+}
+
+/* the MAC of a frame covers its length too, the key stream starts after it */
+void ECIES_encrypt_frame(const ECIES_stream_t *stm, ECIES_size_t index, ECIES_byte_t *msg, ECIES_size_t len)
+{
+  INT2CHARS(msg, len);
+  XTEA_ctr_crypt(msg + ECIES_FRAME_HEADER, len, stm->k1, index + 1);
+  XTEA_cbcmac(msg + ECIES_FRAME_HEADER + len, msg, ECIES_FRAME_HEADER + len, stm->k2, index + 1);
+}
+
+int ECIES_frame_length(const ECIES_byte_t *msg)
+{
+  uint32_t len = CHARS2INT(msg);
+  
+  return len > ECIES_FRAME_MAX ? -3 : (int)len;
+}
+
+int ECIES_decrypt_frame(const ECIES_stream_t *stm, ECIES_size_t index, ECIES_byte_t *msg)
+{
+  ECIES_byte_t mac[ECIES_CHUNK_OVERHEAD];
+  int len = ECIES_frame_length(msg);
+  
+  if (len < 0)
+    return len;
+  
+  XTEA_cbcmac(mac, msg, ECIES_FRAME_HEADER + len, stm->k2, index + 1);
+  
+  if (memcmp(mac, msg + ECIES_FRAME_HEADER + len, ECIES_CHUNK_OVERHEAD))
+    return -2;
+  
+  XTEA_ctr_crypt(msg + ECIES_FRAME_HEADER, len, stm->k1, index + 1);
+  
+  return len;
+}
+
+void ECIES_mac_init(ECIES_mac_t *ctx, const ECIES_stream_t *stm, uint32_t nonce, ECIES_size_t len)
+{
+  XTEA_init_key(ctx->k, stm->k2);
+  INT2CHARS(ctx->mac, nonce);
+  INT2CHARS(ctx->mac + 4, len);
+  XTEA_encipher_block(ctx->mac, ctx->k);
+  ctx->fill = 0;
+}
+
+/* same blocks as XTEA_cbcmac(), a block is enciphered once it is full */
+void ECIES_mac_update(ECIES_mac_t *ctx, const ECIES_byte_t *data, ECIES_size_t len)
+{
+  ECIES_size_t i;
+  PROF_BEGIN(ECIES_PHASE_CBCMAC);
+  while(len && ctx->fill) {
+    ctx->mac[ctx->fill++] ^= *data++;
+    len--;
+    if (ctx->fill == 8) {
+      XTEA_encipher_block(ctx->mac, ctx->k);
+      ctx->fill = 0;
+    }
+  }
+  for(; len >= 8; len -= 8) {
+    for(i = 0; i < 8; i++)
+      ctx->mac[i] ^= *data++;
+    XTEA_encipher_block(ctx->mac, ctx->k);
+  }
+  while(len--)
+    ctx->mac[ctx->fill++] ^= *data++;
+  PROF_END(ECIES_PHASE_CBCMAC);
+}
+
+void ECIES_mac_final(ECIES_mac_t *ctx, ECIES_byte_t *mac)
+{
+  if (ctx->fill)
+    XTEA_encipher_block(ctx->mac, ctx->k);
+  memcpy(mac, ctx->mac, ECIES_CHUNK_OVERHEAD);
+  memset(ctx, 0, sizeof(*ctx));
+}
+
+void ECIES_ctr_init(ECIES_ctr_t *ctx, const ECIES_stream_t *stm, uint32_t nonce)
+{
+  XTEA_init_key(ctx->k, stm->k1);
+  ctx->nonce = nonce;
+  ctx->ctr = 0;
+  ctx->pos = 8;
+}
+
+/* the key stream block in use is kept, so it continues in the next call */
+void ECIES_ctr_update(ECIES_ctr_t *ctx, ECIES_byte_t *out, const ECIES_byte_t *in, ECIES_size_t len)
+{
+  PROF_BEGIN(ECIES_PHASE_CTR_CRYPT);
+  while(len--) {
+    if (ctx->pos == 8) {
+      INT2CHARS(ctx->buf, ctx->nonce); INT2CHARS(ctx->buf + 4, ctx->ctr++);
+      XTEA_encipher_block(ctx->buf, ctx->k);
+      ctx->pos = 0;
+    }
+    *out++ = *in++ ^ ctx->buf[ctx->pos++];
+  }
+  PROF_END(ECIES_PHASE_CTR_CRYPT);
+}
+
+/* a position in a list of segments */
+typedef struct {
+  const ECIES_iovec_t *iov;
+  ECIES_size_t n, i, off;
+} iov_cursor_t;
+
+/* the next contiguous piece of at most *len bytes, NULL past the last segment */
+static const ECIES_byte_t *iov_next(iov_cursor_t *cur, ECIES_size_t *len)
+{
+  const ECIES_byte_t *p;
+  
+  while(cur->i < cur->n && cur->off == cur->iov[cur->i].len) {
+    cur->i++;
+    cur->off = 0;
+  }
+  if (cur->i == cur->n)
+    return NULL;
+  
+  p = (const ECIES_byte_t*)cur->iov[cur->i].base + cur->off;
+  if (*len > cur->iov[cur->i].len - cur->off)
+    *len = cur->iov[cur->i].len - cur->off;
+  cur->off += *len;
+  
+  return p;
+}
+
+static void iov_gather(iov_cursor_t *cur, ECIES_byte_t *dst, ECIES_size_t len)
+{
+  const ECIES_byte_t *p;
+  ECIES_size_t m;
+  
+  for(; len > 0; len -= m, dst += m) {
+    m = len;
+    p = iov_next(cur, &m);
+    memcpy(dst, p, m);
+  }
+}
+
+static uint64_t iov_length(const ECIES_iovec_t *iov, ECIES_size_t n)
+{
+  uint64_t len = 0;
+  
+  while(n--)
+    len += iov[n].len;
+  
+  return len;
+}
+
+ECIES_size_t ECIES_encrypt_chunk_iov(const ECIES_stream_t *stm, ECIES_byte_t *msg, const ECIES_iovec_t *iov, ECIES_size_t n)
+{
+  ECIES_ctr_t ctr;
+  ECIES_size_t i, len = 0;
+  
+  /* the segments are encrypted straight into place, the MAC runs over the result */
+  ECIES_ctr_init(&ctr, stm, 0);
+  for(i = 0; i < n; i++) {
+    ECIES_ctr_update(&ctr, msg + len, iov[i].base, iov[i].len);
+    len += iov[i].len;
+  }
+  memset(&ctr, 0, sizeof(ctr));
+  
+  XTEA_cbcmac(msg + len, msg, len, stm->k2, 0);
+  
+  return len;
+}
+
+void ECIES_encrypt_iov(ECIES_byte_t *msg, const ECIES_iovec_t *iov, ECIES_size_t n, const ECIES_pubkey_t *pubkey){
+  ECIES_stream_t stm;
+  
+  ECIES_encrypt_start(&stm, msg, pubkey);
+  
+  ECIES_encrypt_chunk_iov(&stm, msg + ECIES_START_OVERHEAD, iov, n);
+}
+
+void ECIES_encrypt_iov_prepared(ECIES_byte_t *msg, const ECIES_iovec_t *iov, ECIES_size_t n, const ECIES_pubkey_table_t *tab){
+  ECIES_stream_t stm;
+  
+  ECIES_encrypt_start_prepared(&stm, msg, tab);
+  
+  ECIES_encrypt_chunk_iov(&stm, msg + ECIES_START_OVERHEAD, iov, n);
+}
+
+int ECIES_decrypt_iov(char *raw, ECIES_size_t len, const ECIES_iovec_t *iov, ECIES_size_t n, const ECIES_privkey_t *privkey){
+  ECIES_byte_t head[ECIES_START_OVERHEAD], mac[ECIES_CHUNK_OVERHEAD], tag[ECIES_CHUNK_OVERHEAD];
+  iov_cursor_t cur = { iov, n, 0, 0 }, body;
+  const ECIES_byte_t *p;
+  ECIES_stream_t stm;
+  ECIES_mac_t ctx;
+  ECIES_ctr_t ctr;
+  ECIES_size_t m, left;
+  uint64_t total = iov_length(iov, n);
+  int start, res;
+  
+  /* all sizes are checked before any work */
+  if(total < 1){
+    return -1;
+  }
+  iov_gather(&cur, head, 1);
+  if((start = ECIES_start_size(head)) < 0 || total < (uint64_t)start + len + ECIES_CHUNK_OVERHEAD){
+    return -1;
+  }
+  iov_gather(&cur, head + 1, start - 1);
+  
+  if((res = ECIES_decrypt_start(&stm, head, privkey)) < 0){
+    return res;
+  }
+  
+  body = cur;
+  
+  ECIES_mac_init(&ctx, &stm, 0, len);
+  for(left = len; left > 0; left -= m){
+    m = left;
+    p = iov_next(&cur, &m);
+    ECIES_mac_update(&ctx, p, m);
+  }
+  ECIES_mac_final(&ctx, mac);
+  
+  iov_gather(&cur, tag, ECIES_CHUNK_OVERHEAD);
+  
+  if(memcmp(mac, tag, ECIES_CHUNK_OVERHEAD)){
+    memset(&stm, 0, sizeof(stm));
+    return -2;
+  }
+  
+  ECIES_ctr_init(&ctr, &stm, 0);
+  for(left = len; left > 0; left -= m, raw += m){
+    m = left;
+    p = iov_next(&body, &m);
+    ECIES_ctr_update(&ctr, (ECIES_byte_t*)raw, p, m);
+  }
+  
+  memset(&ctr, 0, sizeof(ctr));
+  memset(&stm, 0, sizeof(stm));
+  
+  return 1;
+}
+
+/* random stream keys, wrapped for each recipient */
+static void ECIES_intern_encrypt_start_multi(ECIES_stream_t *stm, ECIES_byte_t *msg, const ECIES_pubkey_t *pubkeys,
+                                             const ECIES_pubkey_table_t *const *tabs, ECIES_size_t n)
+{
+  ECIES_stream_t slot;
+  ECIES_size_t i;
+  
+  rng(rng_ctx, stm->k1, sizeof(stm->k1));
+  rng(rng_ctx, stm->k2, sizeof(stm->k2));
+  
+  msg[0] = ECIES_MULTI_TAG;
+  msg[1] = n >> 8;
+  msg[2] = n;
+  
+  for (i = 0, msg += 3; i < n; i++, msg += ECIES_MULTI_SLOT_SIZE) {
+    if (tabs)
+      ECIES_encrypt_start_prepared(&slot, msg, tabs[i]);
+    else
+      ECIES_encrypt_start(&slot, msg, &pubkeys[i]);
+    memcpy(msg + ECIES_START_OVERHEAD, stm->k1, 16);
+    memcpy(msg + ECIES_START_OVERHEAD + 16, stm->k2, 16);
+    ECIES_encrypt_chunk(&slot, msg + ECIES_START_OVERHEAD, 32);
+  }
+  
+  memset(&slot, 0, sizeof(slot));
+}
+
+void ECIES_encrypt_start_multi(ECIES_stream_t *stm, ECIES_byte_t *msg, const ECIES_pubkey_t *pubkeys, ECIES_size_t n)
+{
+  ECIES_intern_encrypt_start_multi(stm, msg, pubkeys, NULL, n);
+}
+
+void ECIES_encrypt_start_multi_prepared(ECIES_stream_t *stm, ECIES_byte_t *msg,
+                                        const ECIES_pubkey_table_t *const *tabs, ECIES_size_t n)
+{
+  ECIES_intern_encrypt_start_multi(stm, msg, NULL, tabs, n);
+}
+
+int ECIES_multi_count(const ECIES_byte_t *msg)
+{
+  int n = msg[1] << 8 | msg[2];
+  
+  return msg[0] == ECIES_MULTI_TAG && n > 0 ? n : -3;
+}
+
+int ECIES_decrypt_start_multi(ECIES_stream_t *stm, const ECIES_byte_t *msg, const ECIES_privkey_t *privkey)
+{
+  ECIES_stream_t slot;
+  ECIES_byte_t keys[32 + ECIES_CHUNK_OVERHEAD];
+  int i, n, res = -2;
+  
+  if ((n = ECIES_multi_count(msg)) < 0)
+    return n;
+  
+  for (i = 0, msg += 3; i < n && res < 0; i++, msg += ECIES_MULTI_SLOT_SIZE) {
+    if (ECIES_decrypt_start(&slot, msg, privkey) < 0)
+      continue;
+    memcpy(keys, msg + ECIES_START_OVERHEAD, sizeof(keys));
+    if (ECIES_decrypt_chunk(&slot, keys, 32) < 0)
+      continue;
+    memcpy(stm->k1, keys, 16);
+    memcpy(stm->k2, keys + 16, 16);
+    res = 1;
+  }
+  
+  memset(&slot, 0, sizeof(slot));
+  memset(keys, 0, sizeof(keys));
+  
+  return res;
+}
+
+void ECIES_encrypt_multi(ECIES_byte_t *msg, const char *raw, ECIES_size_t len, const ECIES_pubkey_t *pubkeys, ECIES_size_t n){
+  ECIES_stream_t stm;
+  
+  ECIES_encrypt_start_multi(&stm, msg, pubkeys, n);
+  
+  msg += ECIES_MULTI_START_OVERHEAD(n);
+  memcpy(msg, raw, len);
+  
+  ECIES_encrypt_chunk(&stm, msg, len);
+}
+
+int ECIES_decrypt_multi(char *raw, ECIES_size_t len, const ECIES_byte_t *msg, const ECIES_privkey_t *privkey){
+  int res;
+  ECIES_stream_t stm;
+  ECIES_byte_t mac[ECIES_CHUNK_OVERHEAD];
+  
+  if((res = ECIES_decrypt_start_multi(&stm, msg, privkey)) < 0){
+    return res;
+  }
+  
+  msg += ECIES_MULTI_START_OVERHEAD(ECIES_multi_count(msg));
+  
+  XTEA_cbcmac(mac, msg, len, stm.k2, 0);
+  
+  if(memcmp(mac, msg + len, ECIES_CHUNK_OVERHEAD)){
+    return -2;
+  }
+  
+  memcpy(raw, msg, len);
+  
+  XTEA_ctr_crypt((ECIES_byte_t*)raw, len, stm.k1, 0);
   
   return 1;
 }
+
+/* the direction bit of the frames the responder seals, the initiator's have it clear */
+#define SESSION_RESPONDER 0x80000000
+
+void ECIES_session_start(ECIES_session_t *ses, ECIES_byte_t *msg, const ECIES_pubkey_t *pubkey)
+{
+  memset(ses, 0, sizeof(*ses));
+  ECIES_encrypt_start_compact(&ses->stm, msg, pubkey);
+}
+
+int ECIES_session_accept(ECIES_session_t *ses, const ECIES_byte_t *msg, const ECIES_privkey_t *privkey)
+{
+  memset(ses, 0, sizeof(*ses));
+  if (ECIES_decrypt_start(&ses->stm, msg, privkey) < 0)
+    return -1;
+  ses->dir = SESSION_RESPONDER;
+  return 1;
+}
+
+/* frame: sequence number | ciphertext | MAC, the direction and sequence number are the nonce */
+int ECIES_session_seal(ECIES_session_t *ses, ECIES_byte_t *msg, const char *raw, ECIES_size_t len)
+{
+  uint32_t nonce;
+  
+  if (ses->seq >= ECIES_SESSION_SEQ_MAX)
+    return -1;
+  
+  nonce = ses->dir | ++ses->seq;
+  
+  memmove(msg + 4, raw, len);
+  INT2CHARS(msg, nonce);
+  XTEA_ctr_crypt(msg + 4, len, ses->stm.k1, nonce);
+  XTEA_cbcmac(msg + 4 + len, msg + 4, len, ses->stm.k2, nonce);
+  
+  return 1;
+}
+
+int ECIES_session_open(ECIES_session_t *ses, char *raw, const ECIES_byte_t *msg, ECIES_size_t len)
+{
+  ECIES_byte_t mac[ECIES_CHUNK_OVERHEAD];
+  uint32_t nonce = CHARS2INT(msg), seq = nonce & ECIES_SESSION_SEQ_MAX, age = 0;
+  
+  /* the peer seals with the other direction bit */
+  if ((nonce & SESSION_RESPONDER) == ses->dir || seq == 0)
+    return -3;
+  
+  if (seq <= ses->top) {
+    age = ses->top - seq;
+    if (age >= 64 || (ses->window >> age) & 1)
+      return -3;
+  }
+  
+  XTEA_cbcmac(mac, msg + 4, len, ses->stm.k2, nonce);
+  
+  if (memcmp(mac, msg + 4 + len, ECIES_CHUNK_OVERHEAD))
+    return -2;
+  
+  memmove(raw, msg + 4, len);
+  XTEA_ctr_crypt((ECIES_byte_t*)raw, len, ses->stm.k1, nonce);
+  
+  /* only authentic frames move the window */
+  if (seq > ses->top) {
+    ses->window = seq - ses->top >= 64 ? 0 : ses->window << (seq - ses->top);
+    ses->window |= 1;
+    ses->top = seq;
+  }
+  else
+    ses->window |= (uint64_t)1 << age;
+  
+  return 1;
+}
+
+void ECIES_session_end(ECIES_session_t *ses)
+{
+  memset(ses, 0, sizeof(*ses));
+}
+
+void ECIES_config_get(ECIES_config_t *cfg)
+{
+  cfg->profile = ECIES_CONFIG_PROFILE == ECIES_PROFILE_TINY ? "tiny" :
+                 ECIES_CONFIG_PROFILE == ECIES_PROFILE_FAST ? "fast" : "balanced";
+  cfg->comb_width = ECIES_COMB_WIDTH;
+  cfg->table_size = sizeof(ECIES_pubkey_table_t);
+  cfg->rng_buffer = ECIES_RNG_BUFFER;
+  cfg->keygen_batch = ECIES_KEYGEN_BATCH;
+  cfg->lanes = ECIES_LANES;
+}
+
+#if ECIES_PROFILING
+
+int ECIES_profile_get(ECIES_profile_t *out)
+{
+  uint64_t *dst = (uint64_t*)out, *src = (uint64_t*)&prof;
+  ECIES_size_t i;
+  for(i = 0; i < sizeof(prof) / sizeof(uint64_t); i++)
+    dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+  return 1;
+}
+
+void ECIES_profile_reset(void)
+{
+  uint64_t *dst = (uint64_t*)&prof;
+  ECIES_size_t i;
+  for(i = 0; i < sizeof(prof) / sizeof(uint64_t); i++)
+    __atomic_store_n(&dst[i], 0, __ATOMIC_RELAXED);
+}
+
+const char *ECIES_profile_clock(void)
+{
+  return PROF_CLOCK;
+}
+
+#else/*ECIES_PROFILING*/
+
+int ECIES_profile_get(ECIES_profile_t *out)
+{
+  memset(out, 0, sizeof(*out));
+  return 0;
+}
+
+void ECIES_profile_reset(void)
+{
+}
+
+const char *ECIES_profile_clock(void)
+{
+  return "none";
+}
+
+#endif/*ECIES_PROFILING*/
@@ -28,6 +28,8 @@ extern "C"
 #ifndef _ECC_H_
 #define _ECC_H_ "ecc.h"
 
+#include <stdint.h>
+
 /* the degree of the field polynomial */
 #define ECIES_DEGREE 163
 
@@ -46,6 +48,39 @@ extern "C"
 
 #define ECIES_KEY_SIZE ((ECIES_DEGREE + 7) / 8)
 
+/**
+ * @brief The build profiles, see ECIES_CONFIG_PROFILE.
+ */
+#define ECIES_PROFILE_TINY 1
+#define ECIES_PROFILE_BALANCED 2
+#define ECIES_PROFILE_FAST 3
+
+/**
+ * @brief The profile which sets the default size of every table and buffer.
+ *
+ * - `ECIES_PROFILE_TINY`: the smallest tables, for targets with little cache and memory.
+ * - `ECIES_PROFILE_BALANCED`: the sizes of earlier versions, the default.
+ * - `ECIES_PROFILE_FAST`: bigger tables and batches, for servers.
+ *
+ * Build with e.g. `-DECIES_CONFIG_PROFILE=ECIES_PROFILE_TINY`. A size defined
+ * on its own (ECIES_COMB_WIDTH, ECIES_LANES, ...) still wins over the profile.
+ * ECIES_config_get() reports what the library was built with.
+ */
+#ifndef ECIES_CONFIG_PROFILE
+#define ECIES_CONFIG_PROFILE ECIES_PROFILE_BALANCED
+#endif
+
+#if ECIES_CONFIG_PROFILE != ECIES_PROFILE_TINY && ECIES_CONFIG_PROFILE != ECIES_PROFILE_BALANCED && \
+    ECIES_CONFIG_PROFILE != ECIES_PROFILE_FAST
+#error "ECIES_CONFIG_PROFILE must be ECIES_PROFILE_TINY, ECIES_PROFILE_BALANCED or ECIES_PROFILE_FAST"
+#endif
+
+/**
+ * @brief The value of a size for the tiny, balanced and fast profiles.
+ */
+#define ECIES_PROFILE_PICK(tiny, balanced, fast) \
+  (ECIES_CONFIG_PROFILE == ECIES_PROFILE_TINY ? (tiny) : ECIES_CONFIG_PROFILE == ECIES_PROFILE_FAST ? (fast) : (balanced))
+
 typedef unsigned int ECIES_size_t;
 typedef unsigned char ECIES_byte_t;
 typedef ECIES_byte_t ECIES_key_t[ECIES_KEY_SIZE];
@@ -64,16 +99,66 @@ typedef struct {
   ECIES_key_t k;
 } ECIES_privkey_t;
 
+/**
+ * @brief Random number generator.
+ *
+ * Fills @p buf with @p len random bytes.
+ */
+typedef void (*ECIES_rng_t)(void *ctx, ECIES_byte_t *buf, ECIES_size_t len);
+
+/**
+ * @brief Set random number generator.
+ *
+ * All scalars (private keys and ephemeral keys) are drawn from it.
+ * Set it before any other thread uses the library.
+ *
+ * @param[in] rng The generator, NULL restores ECIES_rng_default().
+ * @param[in] ctx The user data passed to @p rng.
+ */
+void ECIES_set_rng(ECIES_rng_t rng, void *ctx);
+
+/**
+ * @brief The default random number generator.
+ *
+ * ChaCha20 keystream, one generator per thread, seeded from the OS (`getrandom()`)
+ * and reseeded after `fork()`. It refills a buffer in bulk and rekeys itself on every refill,
+ * so there is no lock and no shared state between threads.
+ * It aborts the process when the OS has no random source to seed it.
+ */
+void ECIES_rng_default(void *ctx, ECIES_byte_t *buf, ECIES_size_t len);
+
+/**
+ * @brief The `random()` based generator of the original code.
+ *
+ * Not cryptographically secure, it exists for reproducible keys and tests: after `srandom(seed)`
+ * it gives the same scalars as older versions of the library.
+ */
+void ECIES_rng_libc(void *ctx, ECIES_byte_t *buf, ECIES_size_t len);
+
 /**
  * @brief Generate public/private key pair.
  *
- * It uses `random()` function to get random numbers, so you may use `srandom()` to set initial random seed.
+ * The private key is drawn from the generator set by ECIES_set_rng().
  *
  * @param[out] priv The result private key.
  * @param[out] pub The result public key.
  */
 void ECIES_generate_keys(ECIES_privkey_t *priv, ECIES_pubkey_t *pub);
 
+/**
+ * @brief Generate many public/private key pairs.
+ *
+ * Uses a fixed-base table of the base point and shares one field inversion
+ * between all point additions of a block of keys, so bulk generation is much
+ * cheaper than calling ECIES_generate_keys() @p n times.
+ *
+ * @param[out] priv The result private keys, @p n entries.
+ * @param[out] pub The result public keys, @p n entries.
+ * @param[in] n The number of key pairs.
+ * @return 1 when success, < 0 when out of memory.
+ */
+int ECIES_generate_keys_batch(ECIES_privkey_t *priv, ECIES_pubkey_t *pub, ECIES_size_t n);
+
 /**
  * @brief Validate public key.
  *
@@ -102,7 +187,7 @@ void ECIES_encrypt(ECIES_byte_t *msg, const char *raw, ECIES_size_t len, const E
  * @param[in] privkey The private key wich will be used for decryption.
  * @return 1 when success, < 0 when error reached.
  *
- * Encrypted data must be `len + ECIES_OVERHEAD` bytes long.
+ * Encrypted data must be `len + ECIES_OVERHEAD` bytes long, `len + ECIES_COMPACT_OVERHEAD` when compact.
  */
 int ECIES_decrypt(char *raw, ECIES_size_t len, const ECIES_byte_t *msg, const ECIES_privkey_t *privkey);
 
@@ -134,6 +219,46 @@ typedef struct {
  */
 void ECIES_encrypt_start(ECIES_stream_t *stm, ECIES_byte_t *msg, const ECIES_pubkey_t *pubkey);
 
+/**
+ * @brief Ephemeral key of one encryption.
+ *
+ * The random scalar `k` and `R = k * G`, which do not depend on the recipient.
+ */
+typedef struct {
+  ECIES_privkey_t k;
+  ECIES_pubkey_t R;
+} ECIES_ephemeral_t;
+
+/**
+ * @brief Generate ephemeral key.
+ *
+ * @param[out] eph The result ephemeral key.
+ */
+void ECIES_generate_ephemeral(ECIES_ephemeral_t *eph);
+
+/**
+ * @brief Source of precomputed ephemeral keys.
+ *
+ * Moves one unused ephemeral key to @p eph.
+ * Must never return the same key twice.
+ *
+ * @return 1 when success, 0 when there is no key ready.
+ */
+typedef int (*ECIES_ephemeral_source_t)(void *ctx, ECIES_ephemeral_t *eph);
+
+/**
+ * @brief Set source of precomputed ephemeral keys.
+ *
+ * When set, ECIES_encrypt_start() and friends take `k` and `R` from it and only compute `k * P`,
+ * which halves the cost of starting an encryption. When the source is empty,
+ * a fresh ephemeral key is generated as usual. See `pool.h` for a ready-made source.
+ * It may be changed while other threads encrypt, they see either the old or the new source.
+ *
+ * @param[in] src The source, NULL to disable.
+ * @param[in] ctx The user data passed to @p src.
+ */
+void ECIES_set_ephemeral_source(ECIES_ephemeral_source_t src, void *ctx);
+
 /**
  * @brief Encrypt data chunk.
  *
@@ -146,6 +271,83 @@ void ECIES_encrypt_start(ECIES_stream_t *stm, ECIES_byte_t *msg, const ECIES_pub
  */
 void ECIES_encrypt_chunk(const ECIES_stream_t *stm, ECIES_byte_t *msg, ECIES_size_t len);
 
+/**
+ * @brief Window width of the fixed-point precomputation tables in bits.
+ *
+ * Each table holds `(2^ECIES_COMB_WIDTH - 1)` multiples of the point for every window:
+ * 2 makes 12 KB tables and 82 additions per multiplication, 4 makes 29 KB and 41,
+ * 6 makes 83 KB and 28.
+ */
+#ifndef ECIES_COMB_WIDTH
+#define ECIES_COMB_WIDTH ECIES_PROFILE_PICK(2, 4, 6)
+#endif
+
+/**
+ * @brief The number of windows which covers any scalar below the base order.
+ */
+#define ECIES_COMB_WINDOWS ((ECIES_DEGREE + ECIES_COMB_WIDTH - 1) / ECIES_COMB_WIDTH)
+
+/**
+ * @brief The number of precomputed points in one table.
+ */
+#define ECIES_COMB_POINTS (ECIES_COMB_WINDOWS * ((1 << ECIES_COMB_WIDTH) - 1))
+
+/**
+ * @brief Prepared public key.
+ *
+ * Holds `j * 2^(ECIES_COMB_WIDTH * i) * P` for each window `i` and digit `j`,
+ * so multiplying the key by a scalar needs no point doublings.
+ * The table does not reference any other memory and may be shared read-only between threads.
+ */
+typedef struct {
+  uint32_t xy[ECIES_COMB_POINTS][2][ECIES_NUMWORDS];
+} ECIES_pubkey_table_t;
+
+/**
+ * @brief Prepare public key for repeated encryption.
+ *
+ * @param[out] tab The result precomputation table.
+ * @param[in] pubkey The public key which will be used for encryption.
+ * @return 1 when success, < 0 when the key is not valid.
+ *
+ * Costs about three plain encryptions, so it pays off from the fourth message to the same key.
+ */
+int ECIES_prepare_pubkey(ECIES_pubkey_table_t *tab, const ECIES_pubkey_t *pubkey);
+
+/**
+ * @brief Check that a prepared public key is the one of a public key.
+ *
+ * @param[in] tab The prepared public key, e.g. read from a file.
+ * @param[in] pubkey The public key.
+ * @return 1 when the first point of @p tab is @p pubkey, 0 when not.
+ *
+ * Only the first point is compared, it tells a table of another key, not a damaged table.
+ */
+int ECIES_prepared_is_of(const ECIES_pubkey_table_t *tab, const ECIES_pubkey_t *pubkey);
+
+/**
+ * @brief Start the encryption using prepared public key.
+ *
+ * @param[out] stm The stream data.
+ * @param[out] msg The destination encrypted data buffer.
+ * @param[in] tab The prepared public key.
+ *
+ * Same as ECIES_encrypt_start().
+ */
+void ECIES_encrypt_start_prepared(ECIES_stream_t *stm, ECIES_byte_t *msg, const ECIES_pubkey_table_t *tab);
+
+/**
+ * @brief Encrypt data using prepared public key.
+ *
+ * @param[out] msg The destination buffer for the encrypted data.
+ * @param[in] raw The source data buffer.
+ * @param[in] len The source data length in chars.
+ * @param[in] tab The prepared public key.
+ *
+ * Same as ECIES_encrypt().
+ */
+void ECIES_encrypt_prepared(ECIES_byte_t *msg, const char *raw, ECIES_size_t len, const ECIES_pubkey_table_t *tab);
+
 /**
  * @brief Start the decryption.
  *
@@ -154,10 +356,61 @@ void ECIES_encrypt_chunk(const ECIES_stream_t *stm, ECIES_byte_t *msg, ECIES_siz
  * @param[in] privkey The private key wich will be used for decryption.
  * @return 1 when success, < 0 when error reached.
  *
- * Starting sequence (@p msg) must be `ECIES_START_OVERHEAD` bytes long.
+ * Starting sequence (@p msg) must be `ECIES_START_OVERHEAD` bytes long,
+ * `ECIES_COMPACT_START_OVERHEAD` when compact, `ECIES_KEYED_START_OVERHEAD` when keyed, see ECIES_start_size().
  */
 int ECIES_decrypt_start(ECIES_stream_t *stm, const ECIES_byte_t *msg, const ECIES_privkey_t *privkey);
 
+/**
+ * @brief The number of messages ECIES_decrypt_start_batch() multiplies at once.
+ *
+ * Every word of a field element becomes a vector of ECIES_LANES words. 4 fill
+ * 128-bit NEON or SSE registers, the tiny profile; 8 fill the 256 bits of AVX2,
+ * which is picked at run time on x86; 16 fill AVX-512 but only pay off when the
+ * whole build targets it (-mavx512f).
+ * 0 leaves only the one by one path, the default when vector extensions are missing.
+ */
+#ifndef ECIES_LANES
+#if defined(__GNUC__)
+#define ECIES_LANES ECIES_PROFILE_PICK(4, 8, 8)
+#else
+#define ECIES_LANES 0
+#endif
+#endif
+
+/**
+ * @brief Start the decryption of many messages to one key.
+ *
+ * @param[out] stm The stream data of each message, @p n entries.
+ * @param[out] res The result of each message, as ECIES_decrypt_start() returns it, @p n entries.
+ * @param[in] msg The starting sequence of each message, plain, compact or keyed.
+ * @param[in] n The number of messages.
+ * @param[in] privkey The private key which will be used for decryption.
+ * @return The number of messages started successfully.
+ *
+ * Same keys as ECIES_decrypt_start() for each message. The messages go through
+ * one constant-time Montgomery ladder, ECIES_LANES at a time; a full batch of 8
+ * costs less than a single ECIES_decrypt_start().
+ */
+int ECIES_decrypt_start_batch(ECIES_stream_t *stm, int *res, const ECIES_byte_t *const *msg, ECIES_size_t n,
+                              const ECIES_privkey_t *privkey);
+
+/**
+ * @brief Decrypt many messages to one key.
+ *
+ * @param[out] res The result of each message, as ECIES_decrypt() returns it, @p n entries.
+ * @param[out] raw The destination buffer of each message.
+ * @param[in] len The destination data length of each message.
+ * @param[in] msg The source encrypted data of each message, plain, compact or keyed.
+ * @param[in] n The number of messages.
+ * @param[in] privkey The private key which will be used for decryption.
+ * @return The number of messages decrypted successfully.
+ *
+ * Same as ECIES_decrypt() on each message, the starts go through ECIES_decrypt_start_batch().
+ */
+int ECIES_decrypt_batch(int *res, char *const *raw, const ECIES_size_t *len, const ECIES_byte_t *const *msg,
+                        ECIES_size_t n, const ECIES_privkey_t *privkey);
+
 /**
  * @brief Decrypt data chunk.
  *
@@ -171,6 +424,663 @@ int ECIES_decrypt_start(ECIES_stream_t *stm, const ECIES_byte_t *msg, const ECIE
  */
 int ECIES_decrypt_chunk(const ECIES_stream_t *stm, ECIES_byte_t *msg, ECIES_size_t len);
 
+/**
+ * @brief The first byte of a compact starting sequence, or-ed with the y bit of R.
+ *
+ * A plain starting sequence begins with the zero top byte of Rx.
+ */
+#define ECIES_COMPACT_TAG 0x02
+
+/**
+ * @brief The starting overhead of compact encrypted data in bytes, the tag and Rx.
+ */
+#define ECIES_COMPACT_START_OVERHEAD (1 + ECIES_KEY_SIZE)
+
+/**
+ * @brief The overhead of compact encrypted data in bytes.
+ */
+#define ECIES_COMPACT_OVERHEAD (ECIES_COMPACT_START_OVERHEAD + ECIES_CHUNK_OVERHEAD)
+
+/**
+ * @brief Start the encryption with a compact starting sequence.
+ *
+ * @param[out] stm The stream data.
+ * @param[out] msg The destination encrypted data buffer.
+ * @param[in] pubkey The public key which will be used for encryption.
+ *
+ * R is sent compressed, as x and one bit of y, and ECIES_decrypt_start() recovers y
+ * by solving a quadratic equation with the half-trace. The keys and the chunks are
+ * the same as after ECIES_encrypt_start().
+ * Starting sequence (@p msg) will be `ECIES_COMPACT_START_OVERHEAD` bytes long.
+ */
+void ECIES_encrypt_start_compact(ECIES_stream_t *stm, ECIES_byte_t *msg, const ECIES_pubkey_t *pubkey);
+
+/**
+ * @brief Start the encryption with a compact starting sequence using prepared public key.
+ *
+ * Same as ECIES_encrypt_start_compact().
+ */
+void ECIES_encrypt_start_compact_prepared(ECIES_stream_t *stm, ECIES_byte_t *msg, const ECIES_pubkey_table_t *tab);
+
+/**
+ * @brief Encrypt data with a compact starting sequence.
+ *
+ * @param[out] msg The destination buffer for the encrypted data.
+ * @param[in] raw The source data buffer.
+ * @param[in] len The source data length in chars.
+ * @param[in] pubkey The public key which will be used for encryption.
+ *
+ * Encrypted data will be `len + ECIES_COMPACT_OVERHEAD` bytes long, ECIES_decrypt() takes it as is.
+ */
+void ECIES_encrypt_compact(ECIES_byte_t *msg, const char *raw, ECIES_size_t len, const ECIES_pubkey_t *pubkey);
+
+/**
+ * @brief Encrypt data with a compact starting sequence using prepared public key.
+ *
+ * Same as ECIES_encrypt_compact().
+ */
+void ECIES_encrypt_compact_prepared(ECIES_byte_t *msg, const char *raw, ECIES_size_t len, const ECIES_pubkey_table_t *tab);
+
+/**
+ * @brief The size of a single-recipient starting sequence.
+ *
+ * @param[in] msg The first byte of the starting sequence.
+ * @return `ECIES_START_OVERHEAD`, `ECIES_COMPACT_START_OVERHEAD`, `ECIES_KEYED_START_OVERHEAD`,
+ * or < 0 when it is none of them.
+ */
+int ECIES_start_size(const ECIES_byte_t *msg);
+
+/**
+ * @brief The first byte of a keyed starting sequence, or-ed with the y bit of R.
+ *
+ * A keyed starting sequence is a compact one with the key ID of the recipient
+ * between the tag and Rx, so a holder of many private keys picks the right one
+ * before any EC work, see ECIES_decrypt_keyring().
+ */
+#define ECIES_KEYED_TAG 0x04
+
+/**
+ * @brief The size of a key ID in bytes.
+ */
+#define ECIES_KEY_ID_SIZE 4
+
+/**
+ * @brief The starting overhead of keyed encrypted data in bytes, the tag, the key ID and Rx.
+ */
+#define ECIES_KEYED_START_OVERHEAD (1 + ECIES_KEY_ID_SIZE + ECIES_KEY_SIZE)
+
+/**
+ * @brief The overhead of keyed encrypted data in bytes.
+ */
+#define ECIES_KEYED_OVERHEAD (ECIES_KEYED_START_OVERHEAD + ECIES_CHUNK_OVERHEAD)
+
+/**
+ * @brief The key ID of a public key.
+ *
+ * @param[in] pubkey The public key.
+ * @return The first 32 bits of a hash of the public key.
+ *
+ * The ID only narrows the search, different keys may share one.
+ */
+uint32_t ECIES_key_id(const ECIES_pubkey_t *pubkey);
+
+/**
+ * @brief Compute the public key of a private key.
+ *
+ * @param[out] pub The public key.
+ * @param[in] priv The private key.
+ * @return 1 when success, < 0 when the private key is zero.
+ */
+int ECIES_derive_pubkey(ECIES_pubkey_t *pub, const ECIES_privkey_t *priv);
+
+/**
+ * @brief Start the encryption with a keyed starting sequence.
+ *
+ * @param[out] stm The stream data.
+ * @param[out] msg The destination encrypted data buffer.
+ * @param[in] pubkey The public key which will be used for encryption.
+ *
+ * Same as ECIES_encrypt_start_compact(), with the key ID of @p pubkey in the clear.
+ * Starting sequence (@p msg) will be `ECIES_KEYED_START_OVERHEAD` bytes long.
+ */
+void ECIES_encrypt_start_keyed(ECIES_stream_t *stm, ECIES_byte_t *msg, const ECIES_pubkey_t *pubkey);
+
+/**
+ * @brief Start the encryption with a keyed starting sequence using prepared public key.
+ *
+ * Same as ECIES_encrypt_start_keyed().
+ */
+void ECIES_encrypt_start_keyed_prepared(ECIES_stream_t *stm, ECIES_byte_t *msg, const ECIES_pubkey_table_t *tab);
+
+/**
+ * @brief Encrypt data with a keyed starting sequence.
+ *
+ * @param[out] msg The destination buffer for the encrypted data.
+ * @param[in] raw The source data buffer.
+ * @param[in] len The source data length in chars.
+ * @param[in] pubkey The public key which will be used for encryption.
+ *
+ * Encrypted data will be `len + ECIES_KEYED_OVERHEAD` bytes long, ECIES_decrypt() takes it as is.
+ */
+void ECIES_encrypt_keyed(ECIES_byte_t *msg, const char *raw, ECIES_size_t len, const ECIES_pubkey_t *pubkey);
+
+/**
+ * @brief Encrypt data with a keyed starting sequence using prepared public key.
+ *
+ * Same as ECIES_encrypt_keyed().
+ */
+void ECIES_encrypt_keyed_prepared(ECIES_byte_t *msg, const char *raw, ECIES_size_t len, const ECIES_pubkey_table_t *tab);
+
+/**
+ * @brief The key ID of a starting sequence.
+ *
+ * @param[in] msg The starting sequence.
+ * @param[out] id The key ID.
+ * @return 1 when the starting sequence is keyed, 0 when it carries no key ID.
+ */
+int ECIES_start_key_id(const ECIES_byte_t *msg, uint32_t *id);
+
+/**
+ * @brief The first byte of an indexed stream.
+ *
+ * An indexed (seekable) stream is this byte, a start sequence (single or multi-recipient),
+ * the chunks encrypted with ECIES_encrypt_chunk_at() and an `ECIES_INDEX_SIZE` bytes long index trailer.
+ * All chunks but the last one hold the same number of bytes, so chunk `i` starts at
+ * `i * (chunk_size + ECIES_CHUNK_OVERHEAD)` after the start sequence.
+ */
+#define ECIES_INDEXED_TAG 0x10
+
+/**
+ * @brief The size of the index trailer in bytes.
+ */
+#define ECIES_INDEX_SIZE 24
+
+/**
+ * @brief The first bytes of the index trailer.
+ */
+#define ECIES_INDEX_MAGIC "ECIX"
+
+/**
+ * @brief Encrypt data chunk of an indexed stream.
+ *
+ * @param[in] stm The stream data.
+ * @param[in] index The position of the chunk in the stream, from 0.
+ * @param[in,out] msg The source raw data and destination encrypted data buffer.
+ * @param[in] len The length of source raw data in bytes.
+ *
+ * Same as ECIES_encrypt_chunk(), but both the key stream and the MAC depend on @p index,
+ * so chunks cannot be reordered and the key stream is never reused.
+ */
+void ECIES_encrypt_chunk_at(const ECIES_stream_t *stm, ECIES_size_t index, ECIES_byte_t *msg, ECIES_size_t len);
+
+/**
+ * @brief Decrypt data chunk of an indexed stream.
+ *
+ * @return 1 when success, < 0 when error reached.
+ *
+ * Same as ECIES_decrypt_chunk(), any chunk may be decrypted on its own.
+ */
+int ECIES_decrypt_chunk_at(const ECIES_stream_t *stm, ECIES_size_t index, ECIES_byte_t *msg, ECIES_size_t len);
+
+/**
+ * @brief Make the index trailer.
+ *
+ * @param[in] stm The stream data.
+ * @param[out] msg The destination, `ECIES_INDEX_SIZE` bytes.
+ * @param[in] chunk_size The raw size of every chunk but the last one.
+ * @param[in] length The total raw length of the stream.
+ *
+ * The trailer is authenticated, so a truncated stream is detected.
+ */
+void ECIES_index_encode(const ECIES_stream_t *stm, ECIES_byte_t *msg, ECIES_size_t chunk_size, uint64_t length);
+
+/**
+ * @brief Read the index trailer.
+ *
+ * @return 1 when success, -2 when the MAC does not match, -3 when it isn't a trailer.
+ */
+int ECIES_index_decode(const ECIES_stream_t *stm, const ECIES_byte_t *msg, ECIES_size_t *chunk_size, uint64_t *length);
+
+/**
+ * @brief The first byte of a framed stream.
+ *
+ * A framed stream is this byte, a start sequence (single or multi-recipient) and
+ * frames made by ECIES_encrypt_frame(), each one a chunk of its own size carrying
+ * that size in its header. It ends with an empty frame, so a truncated stream is
+ * detected. The encryptor may change the size at every frame, small ones keep
+ * the latency of interactive streams low, large ones the overhead of bulk ones.
+ */
+#define ECIES_FRAMED_TAG 0x20
+
+/**
+ * @brief The size of the frame header in bytes, the big-endian length of the raw data.
+ */
+#define ECIES_FRAME_HEADER 4
+
+/**
+ * @brief The overhead of a frame in bytes.
+ */
+#define ECIES_FRAME_OVERHEAD (ECIES_FRAME_HEADER + ECIES_CHUNK_OVERHEAD)
+
+/**
+ * @brief The largest raw length of a frame, longer ones are rejected before they are read.
+ */
+#define ECIES_FRAME_MAX (16*1024*1024)
+
+/**
+ * @brief Encrypt frame of a framed stream.
+ *
+ * @param[in] stm The stream data.
+ * @param[in] index The position of the frame in the stream, from 0.
+ * @param[in,out] msg The frame buffer, the source raw data at `msg + ECIES_FRAME_HEADER`.
+ * @param[in] len The length of source raw data in bytes, at most `ECIES_FRAME_MAX`, 0 for the last frame.
+ *
+ * The frame will be `len + ECIES_FRAME_OVERHEAD` bytes long. The key stream depends
+ * on @p index as in ECIES_encrypt_chunk_at(), the MAC covers the header too.
+ */
+void ECIES_encrypt_frame(const ECIES_stream_t *stm, ECIES_size_t index, ECIES_byte_t *msg, ECIES_size_t len);
+
+/**
+ * @brief The raw length of a frame.
+ *
+ * @param[in] msg The frame header, `ECIES_FRAME_HEADER` bytes.
+ * @return The length, not authenticated yet, -3 when it is over `ECIES_FRAME_MAX`.
+ *
+ * The whole frame is `length + ECIES_FRAME_OVERHEAD` bytes long.
+ */
+int ECIES_frame_length(const ECIES_byte_t *msg);
+
+/**
+ * @brief Decrypt frame of a framed stream.
+ *
+ * @param[in] stm The stream data.
+ * @param[in] index The position of the frame in the stream, from 0.
+ * @param[in,out] msg The whole frame, the decrypted raw data is left at `msg + ECIES_FRAME_HEADER`.
+ * @return The raw length, 0 for the last frame, -2 when the MAC does not match, -3 when it isn't a frame.
+ */
+int ECIES_decrypt_frame(const ECIES_stream_t *stm, ECIES_size_t index, ECIES_byte_t *msg);
+
+/**
+ * @brief The first byte of a multi-recipient start sequence.
+ *
+ * The start sequence of a single recipient always begins with a zero byte.
+ */
+#define ECIES_MULTI_TAG 0x01
+
+/**
+ * @brief The maximum number of recipients.
+ */
+#define ECIES_MULTI_MAX 0xffff
+
+/**
+ * @brief The size of one recipient slot in bytes.
+ *
+ * A slot is a single-recipient start sequence followed by the content keys
+ * encrypted as one chunk under the keys of that start sequence.
+ */
+#define ECIES_MULTI_SLOT_SIZE (ECIES_START_OVERHEAD + 32 + ECIES_CHUNK_OVERHEAD)
+
+/**
+ * @brief The starting overhead of encrypted data for @p n recipients in bytes.
+ */
+#define ECIES_MULTI_START_OVERHEAD(n) (3 + (n) * ECIES_MULTI_SLOT_SIZE)
+
+/**
+ * @brief Start the encryption for many recipients.
+ *
+ * @param[out] stm The stream data.
+ * @param[out] msg The destination encrypted data buffer.
+ * @param[in] pubkeys The public keys of the recipients.
+ * @param[in] n The number of recipients, 1 to `ECIES_MULTI_MAX`.
+ *
+ * The stream keys are random, each recipient gets them wrapped with ECIES_encrypt_start(),
+ * so the data is encrypted and authenticated once with ECIES_encrypt_chunk() no matter how many recipients.
+ * Starting sequence (@p msg) will be `ECIES_MULTI_START_OVERHEAD(n)` bytes long.
+ */
+void ECIES_encrypt_start_multi(ECIES_stream_t *stm, ECIES_byte_t *msg, const ECIES_pubkey_t *pubkeys, ECIES_size_t n);
+
+/**
+ * @brief Start the encryption for many recipients using prepared public keys.
+ *
+ * Same as ECIES_encrypt_start_multi().
+ */
+void ECIES_encrypt_start_multi_prepared(ECIES_stream_t *stm, ECIES_byte_t *msg,
+                                        const ECIES_pubkey_table_t *const *tabs, ECIES_size_t n);
+
+/**
+ * @brief The number of recipients.
+ *
+ * @param[in] msg The first 3 bytes of the starting sequence.
+ * @return The number of recipients, < 0 when it isn't a multi-recipient sequence.
+ */
+int ECIES_multi_count(const ECIES_byte_t *msg);
+
+/**
+ * @brief Start the decryption of multi-recipient data.
+ *
+ * @param[out] stm The stream data.
+ * @param[in] msg The source encrypted data buffer.
+ * @param[in] privkey The private key wich will be used for decryption.
+ * @return 1 when success, -2 when no slot belongs to the key, -3 when it isn't a multi-recipient sequence.
+ *
+ * Tries the slots in turn, one scalar multiplication each, until one opens with @p privkey.
+ * Starting sequence (@p msg) must be `ECIES_MULTI_START_OVERHEAD(n)` bytes long,
+ * see ECIES_multi_count().
+ */
+int ECIES_decrypt_start_multi(ECIES_stream_t *stm, const ECIES_byte_t *msg, const ECIES_privkey_t *privkey);
+
+/**
+ * @brief Encrypt data for many recipients.
+ *
+ * Encrypted data will be `ECIES_MULTI_START_OVERHEAD(n) + len + ECIES_CHUNK_OVERHEAD` bytes long.
+ */
+void ECIES_encrypt_multi(ECIES_byte_t *msg, const char *raw, ECIES_size_t len, const ECIES_pubkey_t *pubkeys, ECIES_size_t n);
+
+/**
+ * @brief Decrypt multi-recipient data.
+ *
+ * @return 1 when success, < 0 when error reached.
+ *
+ * Encrypted data must be `ECIES_MULTI_START_OVERHEAD(n) + len + ECIES_CHUNK_OVERHEAD` bytes long.
+ */
+int ECIES_decrypt_multi(char *raw, ECIES_size_t len, const ECIES_byte_t *msg, const ECIES_privkey_t *privkey);
+
+/**
+ * @brief Session of two peers.
+ *
+ * One key agreement, then any number of messages both ways with symmetric crypto only.
+ * Every frame carries a sequence number, the nonce of its CTR encryption and CBC-MAC,
+ * whose top bit tells the direction, so the two peers never share a nonce.
+ * A session is not thread-safe.
+ */
+typedef struct {
+  ECIES_stream_t stm;
+  uint32_t dir;     /* the direction bit of the frames this side seals */
+  uint32_t seq;     /* the last sealed sequence number */
+  uint32_t top;     /* the highest opened sequence number */
+  uint64_t window;  /* bit i set when top - i was opened */
+} ECIES_session_t;
+
+/**
+ * @brief The size of the session handshake in bytes.
+ */
+#define ECIES_SESSION_START_OVERHEAD ECIES_COMPACT_START_OVERHEAD
+
+/**
+ * @brief The per-frame overhead of a session in bytes, the sequence number and the MAC.
+ */
+#define ECIES_SESSION_OVERHEAD (4 + ECIES_CHUNK_OVERHEAD)
+
+/**
+ * @brief The number of frames one side may seal.
+ */
+#define ECIES_SESSION_SEQ_MAX 0x7fffffff
+
+/**
+ * @brief Start a session, the initiator side.
+ *
+ * @param[out] ses The session.
+ * @param[out] msg The handshake for the peer, `ECIES_SESSION_START_OVERHEAD` bytes.
+ * @param[in] pubkey The public key of the peer.
+ *
+ * The handshake is a compact starting sequence, see ECIES_encrypt_start_compact(),
+ * and the session keys are the stream keys it derives.
+ */
+void ECIES_session_start(ECIES_session_t *ses, ECIES_byte_t *msg, const ECIES_pubkey_t *pubkey);
+
+/**
+ * @brief Accept a session, the responder side.
+ *
+ * @param[out] ses The session.
+ * @param[in] msg The handshake of the initiator.
+ * @param[in] privkey The private key the initiator started the session to.
+ * @return 1 when success, < 0 when the handshake is not valid.
+ */
+int ECIES_session_accept(ECIES_session_t *ses, const ECIES_byte_t *msg, const ECIES_privkey_t *privkey);
+
+/**
+ * @brief Seal one message.
+ *
+ * @param[in,out] ses The session.
+ * @param[out] msg The destination frame, `len + ECIES_SESSION_OVERHEAD` bytes.
+ * @param[in] raw The message, may be `msg + 4` for sealing in place.
+ * @param[in] len The message length in bytes.
+ * @return 1 when success, -1 when the sequence numbers are used up and a new session is needed.
+ */
+int ECIES_session_seal(ECIES_session_t *ses, ECIES_byte_t *msg, const char *raw, ECIES_size_t len);
+
+/**
+ * @brief Open one frame of the peer.
+ *
+ * @param[in,out] ses The session.
+ * @param[out] raw The destination message, `len` bytes, may be `msg + 4`.
+ * @param[in] msg The frame, `len + ECIES_SESSION_OVERHEAD` bytes.
+ * @param[in] len The message length in bytes.
+ * @return 1 when success, -2 when the MAC does not match,
+ * -3 when the frame is a replay, older than the last 64 frames, or not from the peer.
+ *
+ * Frames may arrive out of order within the window of 64 sequence numbers.
+ */
+int ECIES_session_open(ECIES_session_t *ses, char *raw, const ECIES_byte_t *msg, ECIES_size_t len);
+
+/**
+ * @brief Wipe the session keys.
+ */
+void ECIES_session_end(ECIES_session_t *ses);
+
+/**
+ * @brief Incremental CBC-MAC of a chunk.
+ *
+ * The data may come in any number of pieces, the result is the same as the MAC
+ * which ECIES_encrypt_chunk() computes over the whole chunk.
+ */
+typedef struct {
+  uint32_t k[4];
+  ECIES_byte_t mac[8];
+  ECIES_size_t fill;  /* the bytes of the current block */
+} ECIES_mac_t;
+
+/**
+ * @brief Start the MAC of a chunk.
+ *
+ * @param[out] ctx The MAC state.
+ * @param[in] stm The stream data.
+ * @param[in] nonce 0 as in ECIES_encrypt_chunk(), `index + 1` as in ECIES_encrypt_chunk_at().
+ * @param[in] len The total length of the data, it is the first block of the MAC.
+ */
+void ECIES_mac_init(ECIES_mac_t *ctx, const ECIES_stream_t *stm, uint32_t nonce, ECIES_size_t len);
+
+/**
+ * @brief Add data to the MAC.
+ *
+ * @param[in,out] ctx The MAC state.
+ * @param[in] data The next piece of the encrypted data.
+ * @param[in] len The length of the piece in bytes.
+ */
+void ECIES_mac_update(ECIES_mac_t *ctx, const ECIES_byte_t *data, ECIES_size_t len);
+
+/**
+ * @brief Finish the MAC.
+ *
+ * @param[in,out] ctx The MAC state, wiped.
+ * @param[out] mac The MAC, `ECIES_CHUNK_OVERHEAD` bytes.
+ */
+void ECIES_mac_final(ECIES_mac_t *ctx, ECIES_byte_t *mac);
+
+/**
+ * @brief Incremental CTR encryption of a chunk.
+ *
+ * The key stream continues across calls, so a chunk may be encrypted or
+ * decrypted in any number of pieces.
+ */
+typedef struct {
+  uint32_t k[4];
+  uint32_t nonce, ctr;
+  ECIES_byte_t buf[8];  /* the current key stream block */
+  ECIES_size_t pos;     /* its bytes used */
+} ECIES_ctr_t;
+
+/**
+ * @brief Start the key stream of a chunk.
+ *
+ * @param[out] ctx The CTR state.
+ * @param[in] stm The stream data.
+ * @param[in] nonce The nonce of the chunk, as for ECIES_mac_init().
+ */
+void ECIES_ctr_init(ECIES_ctr_t *ctx, const ECIES_stream_t *stm, uint32_t nonce);
+
+/**
+ * @brief Encrypt or decrypt the next piece of a chunk.
+ *
+ * @param[in,out] ctx The CTR state.
+ * @param[out] out The destination, may be the same as @p in.
+ * @param[in] in The source.
+ * @param[in] len The length in bytes.
+ */
+void ECIES_ctr_update(ECIES_ctr_t *ctx, ECIES_byte_t *out, const ECIES_byte_t *in, ECIES_size_t len);
+
+/**
+ * @brief Segment of a scattered message.
+ */
+typedef struct {
+  const void *base;
+  ECIES_size_t len;
+} ECIES_iovec_t;
+
+/**
+ * @brief Encrypt data chunk gathered from segments.
+ *
+ * @param[in] stm The stream data.
+ * @param[out] msg The destination encrypted data buffer.
+ * @param[in] iov The source segments.
+ * @param[in] n The number of segments.
+ * @return The total length of the segments.
+ *
+ * Same as ECIES_encrypt_chunk() on the concatenation of the segments, which is never made:
+ * every segment is encrypted straight into @p msg. Encrypted data will be the total length
+ * plus `ECIES_CHUNK_OVERHEAD` bytes long.
+ */
+ECIES_size_t ECIES_encrypt_chunk_iov(const ECIES_stream_t *stm, ECIES_byte_t *msg, const ECIES_iovec_t *iov, ECIES_size_t n);
+
+/**
+ * @brief Encrypt data gathered from segments.
+ *
+ * @param[out] msg The destination buffer for the encrypted data.
+ * @param[in] iov The source segments.
+ * @param[in] n The number of segments.
+ * @param[in] pubkey The public key which will be used for encryption.
+ *
+ * Same as ECIES_encrypt() on the concatenation of the segments.
+ * Encrypted data will be the total length plus `ECIES_OVERHEAD` bytes long.
+ */
+void ECIES_encrypt_iov(ECIES_byte_t *msg, const ECIES_iovec_t *iov, ECIES_size_t n, const ECIES_pubkey_t *pubkey);
+
+/**
+ * @brief Encrypt data gathered from segments using prepared public key.
+ *
+ * Same as ECIES_encrypt_iov().
+ */
+void ECIES_encrypt_iov_prepared(ECIES_byte_t *msg, const ECIES_iovec_t *iov, ECIES_size_t n, const ECIES_pubkey_table_t *tab);
+
+/**
+ * @brief Decrypt data scattered over segments.
+ *
+ * @param[out] raw The destination buffer for decrypted data.
+ * @param[in] len The destination data length.
+ * @param[in] iov The source encrypted data segments, split anywhere, the starting sequence too.
+ * @param[in] n The number of segments.
+ * @param[in] privkey The private key wich will be used for decryption.
+ * @return 1 when success, -1 when the segments are too short or the start is not valid, -2 when the MAC does not match.
+ *
+ * Same as ECIES_decrypt() on the concatenation of the segments, plain, compact or keyed.
+ * The MAC is checked over the segments in place, then they are decrypted straight into @p raw.
+ */
+int ECIES_decrypt_iov(char *raw, ECIES_size_t len, const ECIES_iovec_t *iov, ECIES_size_t n, const ECIES_privkey_t *privkey);
+
+/**
+ * @brief The sizes the library was built with.
+ */
+typedef struct {
+  const char *profile;  /**< "tiny", "balanced" or "fast" */
+  int comb_width;       /**< ECIES_COMB_WIDTH */
+  uint32_t table_size;  /**< bytes of one ECIES_pubkey_table_t */
+  int rng_buffer;       /**< bytes of the per-thread keystream buffer */
+  int keygen_batch;     /**< keys sharing one inversion in ECIES_generate_keys_batch() */
+  int lanes;            /**< ECIES_LANES */
+} ECIES_config_t;
+
+/**
+ * @brief Read the build configuration of the library.
+ *
+ * The library and a program must be built with the same profile: the size of
+ * ECIES_pubkey_table_t follows `ECIES_COMB_WIDTH` from this header, so tables
+ * passed across a mismatch are read out of bounds. A program linked to a separately
+ * built library checks it with ECIES_CONFIG_MATCHES() before using prepared keys.
+ */
+void ECIES_config_get(ECIES_config_t *cfg);
+
+/**
+ * @brief Whether the configuration read by ECIES_config_get() matches the header the caller was built with.
+ */
+#define ECIES_CONFIG_MATCHES(cfg) ((cfg)->table_size == sizeof(ECIES_pubkey_table_t) && \
+                                   (cfg)->comb_width == ECIES_COMB_WIDTH)
+
+/**
+ * @brief Profiled phases.
+ */
+enum {
+  ECIES_PHASE_POINT_MULT,   /**< scalar multiplications */
+  ECIES_PHASE_FIELD_INVERT, /**< field inversions */
+  ECIES_PHASE_KDF,          /**< key derivation */
+  ECIES_PHASE_CBCMAC,       /**< XTEA CBC-MAC */
+  ECIES_PHASE_CTR_CRYPT,    /**< XTEA CTR encryption */
+  ECIES_PHASES
+};
+
+/**
+ * @brief Counted field operations.
+ */
+enum {
+  ECIES_FIELD_MULT,   /**< multiplications of distinct elements */
+  ECIES_FIELD_SQUARE, /**< squarings */
+  ECIES_FIELD_INVERT, /**< inversions */
+  ECIES_FIELD_OPS
+};
+
+/**
+ * @brief Phase profile.
+ *
+ * Times are in the units of ECIES_profile_clock() and include nested phases,
+ * i.e. the inversions inside scalar multiplications count for both.
+ */
+typedef struct {
+  uint64_t calls[ECIES_PHASES];   /**< calls per phase */
+  uint64_t ticks[ECIES_PHASES];   /**< time per phase */
+  uint64_t field[ECIES_FIELD_OPS]; /**< all field operations */
+  uint64_t field_in_mult[ECIES_FIELD_OPS]; /**< field operations done by scalar multiplications */
+} ECIES_profile_t;
+
+/**
+ * @brief Read the phase profile of the process.
+ *
+ * Profiling is compiled in only when the library is built with `ECIES_PROFILING` defined non-zero,
+ * otherwise the counting code does not exist at all.
+ *
+ * @param[out] prof The profile, zeroed when profiling is not compiled in.
+ * @return 1 when profiling is compiled in, 0 otherwise.
+ */
+int ECIES_profile_get(ECIES_profile_t *prof);
+
+/**
+ * @brief Clear the phase profile.
+ */
+void ECIES_profile_reset(void);
+
+/**
+ * @brief The unit of profile times: "tsc" for CPU time stamp counter cycles or "ns".
+ */
+const char *ECIES_profile_clock(void);
+
 #endif/*_ECC_H_*/
 /**
  * @}
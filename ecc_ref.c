@@ -0,0 +1,275 @@
+/*
+  Frozen reference of the ecc.c kernels, see ecc_ref.h. Do not optimise.
+*/
+
+#include <string.h>
+#include "ecc_ref.h"
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+/* byte order by hand, independent of the ecc.c macros */
+#define REF_GET32(p) ((uint32_t)(p)[0] << 24 | (uint32_t)(p)[1] << 16 | (uint32_t)(p)[2] << 8 | (uint32_t)(p)[3])
+#define REF_PUT32(p, v) do { uint32_t v_ = (v); (p)[0] = v_ >> 24; (p)[1] = v_ >> 16; (p)[2] = v_ >> 8; (p)[3] = v_; } while(0)
+
+#define getbit(A, idx) ((A[(idx) / 32] >> ((idx) % 32)) & 1)
+#define clear(A) memset(A, 0, sizeof(ref_elem_t))
+#define copy(A, B) memcpy(A, B, sizeof(ref_elem_t))
+#define is_equal(A, B) (! memcmp(A, B, sizeof(ref_elem_t)))
+
+static const ref_elem_t poly = { ECIES_POLY };
+static const ref_elem_t coeff_b = { ECIES_COEFF_B };
+
+static int is_clear(const ref_elem_t x)
+{
+  int i;
+  for(i = 0; i < ECIES_NUMWORDS && ! *x++; i++);
+  return i == ECIES_NUMWORDS;
+}
+
+static int sizeinbits(const ref_elem_t x)
+{
+  int i;
+  uint32_t mask;
+  for(x += ECIES_NUMWORDS, i = 32 * ECIES_NUMWORDS; i > 0 && ! *--x; i -= 32);
+  if (i)
+    for(mask = (uint32_t)1 << 31; ! (*x & mask); mask >>= 1, i--);
+  return i;
+}
+
+static void lshift(ref_elem_t A, const ref_elem_t B, int count)
+{
+  int i, offs = 4 * (count / 32);
+  memmove((char*)A + offs, B, sizeof(ref_elem_t) - offs);
+  memset(A, 0, offs);
+  if (count %= 32) {
+    for(i = ECIES_NUMWORDS - 1; i > 0; i--)
+      A[i] = (A[i] << count) | (A[i - 1] >> (32 - count));
+    A[0] <<= count;
+  }
+}
+
+static int is1(const ref_elem_t x)
+{
+  int i;
+  if (*x++ != 1) return 0;
+  for(i = 1; i < ECIES_NUMWORDS && ! *x++; i++);
+  return i == ECIES_NUMWORDS;
+}
+
+static void field_add(ref_elem_t z, const ref_elem_t x, const ref_elem_t y)
+{
+  int i;
+  for(i = 0; i < ECIES_NUMWORDS; i++)
+    *z++ = *x++ ^ *y++;
+}
+
+void ref_field_mult(ref_elem_t z, const ref_elem_t x, const ref_elem_t y)
+{
+  ref_elem_t b;
+  int i, j;
+  copy(b, x);
+  if (getbit(y, 0))
+    copy(z, x);
+  else
+    clear(z);
+  for(i = 1; i < ECIES_DEGREE; i++) {
+    for(j = ECIES_NUMWORDS - 1; j > 0; j--)
+      b[j] = (b[j] << 1) | (b[j - 1] >> 31);
+    b[0] <<= 1;
+    if (getbit(b, ECIES_DEGREE))
+      field_add(b, b, poly);
+    if (getbit(y, i))
+      field_add(z, z, b);
+  }
+}
+
+void ref_field_invert(ref_elem_t z, const ref_elem_t x)
+{
+  ref_elem_t u, v, g, h, t;
+  int i;
+  copy(u, x);
+  copy(v, poly);
+  clear(g);
+  z[0] = 1; memset(z + 1, 0, sizeof(ref_elem_t) - 4);
+  while (! is1(u)) {
+    i = sizeinbits(u) - sizeinbits(v);
+    if (i < 0) {
+      copy(t, u); copy(u, v); copy(v, t);
+      copy(t, g); copy(g, z); copy(z, t);
+      i = -i;
+    }
+    lshift(h, v, i);
+    field_add(u, u, h);
+    lshift(h, g, i);
+    field_add(z, z, h);
+  }
+}
+
+int ref_is_point_on_curve(const ref_elem_t x, const ref_elem_t y)
+{
+  ref_elem_t a, b;
+  if (is_clear(x) && is_clear(y))
+    return 1;
+  ref_field_mult(a, x, x);
+  ref_field_mult(b, a, x);
+  field_add(a, a, b);
+  field_add(a, a, coeff_b);
+  ref_field_mult(b, y, y);
+  field_add(a, a, b);
+  ref_field_mult(b, x, y);
+  return is_equal(a, b);
+}
+
+void ref_point_double(ref_elem_t x, ref_elem_t y)
+{
+  if (! is_clear(x)) {
+    ref_elem_t a;
+    ref_field_invert(a, x);
+    ref_field_mult(a, a, y);
+    field_add(a, a, x);
+    ref_field_mult(y, x, x);
+    ref_field_mult(x, a, a);
+    a[0] ^= 1;
+    field_add(x, x, a);
+    ref_field_mult(a, a, x);
+    field_add(y, y, a);
+  }
+  else
+    clear(y);
+}
+
+void ref_point_add(ref_elem_t x1, ref_elem_t y1, const ref_elem_t x2, const ref_elem_t y2)
+{
+  if (! (is_clear(x2) && is_clear(y2))) {
+    if (is_clear(x1) && is_clear(y1)) {
+      copy(x1, x2); copy(y1, y2);
+    }
+    else {
+      if (is_equal(x1, x2)) {
+        if (is_equal(y1, y2))
+          ref_point_double(x1, y1);
+        else {
+          clear(x1); clear(y1);
+        }
+      }
+      else {
+        ref_elem_t a, b, c, d;
+        field_add(a, y1, y2);
+        field_add(b, x1, x2);
+        ref_field_invert(c, b);
+        ref_field_mult(c, c, a);
+        ref_field_mult(d, c, c);
+        field_add(d, d, c);
+        field_add(d, d, b);
+        d[0] ^= 1;
+        field_add(x1, x1, d);
+        ref_field_mult(a, x1, c);
+        field_add(a, a, d);
+        field_add(y1, y1, a);
+        copy(x1, d);
+      }
+    }
+  }
+}
+
+void ref_point_mult(ref_elem_t x, ref_elem_t y, const ref_elem_t exp)
+{
+  ref_elem_t X, Y;
+  int i;
+  clear(X); clear(Y);
+  for(i = sizeinbits(exp) - 1; i >= 0; i--) {
+    ref_point_double(X, Y);
+    if (getbit(exp, i))
+      ref_point_add(X, Y, x, y);
+  }
+  copy(x, X); copy(y, Y);
+}
+
+static void init_key(uint32_t *k, const ECIES_byte_t *key)
+{
+  k[0] = REF_GET32(key + 0); k[1] = REF_GET32(key + 4);
+  k[2] = REF_GET32(key + 8); k[3] = REF_GET32(key + 12);
+}
+
+void ref_XTEA_encipher_block(ECIES_byte_t *data, const uint32_t *k)
+{
+  uint32_t sum = 0, delta = 0x9e3779b9, y, z;
+  int i;
+  y = REF_GET32(data); z = REF_GET32(data + 4);
+  for(i = 0; i < 32; i++) {
+    y += ((z << 4 ^ z >> 5) + z) ^ (sum + k[sum & 3]);
+    sum += delta;
+    z += ((y << 4 ^ y >> 5) + y) ^ (sum + k[sum >> 11 & 3]);
+  }
+  REF_PUT32(data, y); REF_PUT32(data + 4, z);
+}
+
+void ref_XTEA_ctr_crypt(ECIES_byte_t *data, ECIES_size_t size, const ECIES_byte_t *key, uint32_t nonce)
+{
+  uint32_t k[4], ctr = 0;
+  ECIES_size_t len, i;
+  ECIES_byte_t buf[8];
+  init_key(k, key);
+  while(size) {
+    REF_PUT32(buf, nonce); REF_PUT32(buf + 4, ctr++);
+    ref_XTEA_encipher_block(buf, k);
+    len = MIN(8, size);
+    for(i = 0; i < len; i++)
+      *data++ ^= buf[i];
+    size -= len;
+  }
+}
+
+void ref_XTEA_cbcmac(ECIES_byte_t *mac, const ECIES_byte_t *data, ECIES_size_t size, const ECIES_byte_t *key, uint32_t nonce)
+{
+  uint32_t k[4];
+  ECIES_size_t len, i;
+  init_key(k, key);
+  REF_PUT32(mac, nonce);
+  REF_PUT32(mac + 4, size);
+  ref_XTEA_encipher_block(mac, k);
+  while(size) {
+    len = MIN(8, size);
+    for(i = 0; i < len; i++)
+      mac[i] ^= *data++;
+    ref_XTEA_encipher_block(mac, k);
+    size -= len;
+  }
+}
+
+static void davies_meyer(ECIES_byte_t *out, const ECIES_byte_t *in, int ilen)
+{
+  uint32_t k[4];
+  ECIES_byte_t buf[8];
+  ECIES_size_t i;
+  memset(out, 0, 8);
+  while(ilen--) {
+    init_key(k, in);
+    memcpy(buf, out, 8);
+    ref_XTEA_encipher_block(buf, k);
+    for(i = 0; i < 8; i++)
+      out[i] ^= buf[i];
+    in += 16;
+  }
+}
+
+static void export(ECIES_byte_t *s, const ref_elem_t x)
+{
+  int i;
+  for(x += ECIES_NUMWORDS, i = 0; i < ECIES_NUMWORDS; i++, s += 4)
+    REF_PUT32(s, *--x);
+}
+
+void ref_kdf(ECIES_byte_t *k1, ECIES_byte_t *k2, const ref_elem_t Zx, const ref_elem_t Rx, const ref_elem_t Ry)
+{
+  ECIES_byte_t buf[(3 * (4 * ECIES_NUMWORDS) + 1 + 15) & ~15];
+  int blocks = sizeof(buf) / 16;
+  memset(buf, 0, sizeof(buf));
+  export(buf, Zx);
+  export(buf + 4 * ECIES_NUMWORDS, Rx);
+  export(buf + 8 * ECIES_NUMWORDS, Ry);
+  buf[12 * ECIES_NUMWORDS] = 0; davies_meyer(k1, buf, blocks);
+  buf[12 * ECIES_NUMWORDS] = 1; davies_meyer(k1 + 8, buf, blocks);
+  buf[12 * ECIES_NUMWORDS] = 2; davies_meyer(k2, buf, blocks);
+  buf[12 * ECIES_NUMWORDS] = 3; davies_meyer(k2 + 8, buf, blocks);
+}
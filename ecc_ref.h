@@ -0,0 +1,32 @@
+/*
+  Frozen reference of the ecc.c kernels, for differential testing only.
+
+  These are the field, point and XTEA routines as ecc.c had them before any
+  optimisation, kept bit for bit. Never optimise or "fix" them: difftest.c
+  proves the production kernels against them, and a change here would move
+  the goal posts of the wire format.
+*/
+#ifndef _ECC_REF_H_
+#define _ECC_REF_H_
+
+#include "ecc.h"
+
+typedef uint32_t ref_elem_t[ECIES_NUMWORDS];
+
+void ref_field_mult(ref_elem_t z, const ref_elem_t x, const ref_elem_t y);
+void ref_field_invert(ref_elem_t z, const ref_elem_t x);
+
+/* (x, y) := 2 * (x, y) */
+void ref_point_double(ref_elem_t x, ref_elem_t y);
+/* (x1, y1) := (x1, y1) + (x2, y2) */
+void ref_point_add(ref_elem_t x1, ref_elem_t y1, const ref_elem_t x2, const ref_elem_t y2);
+/* (x, y) := exp * (x, y), double-and-add */
+void ref_point_mult(ref_elem_t x, ref_elem_t y, const ref_elem_t exp);
+int ref_is_point_on_curve(const ref_elem_t x, const ref_elem_t y);
+
+void ref_XTEA_encipher_block(ECIES_byte_t *data, const uint32_t *k);
+void ref_XTEA_ctr_crypt(ECIES_byte_t *data, ECIES_size_t size, const ECIES_byte_t *key, uint32_t nonce);
+void ref_XTEA_cbcmac(ECIES_byte_t *mac, const ECIES_byte_t *data, ECIES_size_t size, const ECIES_byte_t *key, uint32_t nonce);
+void ref_kdf(ECIES_byte_t *k1, ECIES_byte_t *k2, const ref_elem_t Zx, const ref_elem_t Rx, const ref_elem_t Ry);
+
+#endif/*_ECC_REF_H_*/
@@ -1,14 +1,442 @@
 #include "hex.h"
 
-static inline hex_byte_t char2byte(char h){
-  return h <= '9' ? h - '0' : h <= 'F' ? h - 'A' + 10 : h <= 'f' ? h - 'a' + 10 : -1;
+/* the vector codecs are picked at run time, HEX_SIMD=0 leaves only the scalar ones */
+#ifndef HEX_SIMD
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HEX_SIMD 1
+#else
+#define HEX_SIMD 0
+#endif
+#endif
+
+#if HEX_SIMD
+#include <string.h>
+#include <immintrin.h>
+
+#define HEX_SSSE3 __attribute__((target("ssse3")))
+#define HEX_AVX2 __attribute__((target("avx2")))
+#endif
+
+static const char hex_digits[16] = "0123456789abcdef";
+
+/* the digit values plus one, zero marks anything else */
+static const hex_byte_t hex_values[256] = {
+  ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5, ['5'] = 6, ['6'] = 7, ['7'] = 8,
+  ['8'] = 9, ['9'] = 10,
+  ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+  ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16
+};
+
+static const char base64_digits[64] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static const hex_byte_t base64_values[256] = {
+  ['A'] = 1, ['B'] = 2, ['C'] = 3, ['D'] = 4, ['E'] = 5, ['F'] = 6, ['G'] = 7, ['H'] = 8,
+  ['I'] = 9, ['J'] = 10, ['K'] = 11, ['L'] = 12, ['M'] = 13, ['N'] = 14, ['O'] = 15, ['P'] = 16,
+  ['Q'] = 17, ['R'] = 18, ['S'] = 19, ['T'] = 20, ['U'] = 21, ['V'] = 22, ['W'] = 23, ['X'] = 24,
+  ['Y'] = 25, ['Z'] = 26, ['a'] = 27, ['b'] = 28, ['c'] = 29, ['d'] = 30, ['e'] = 31, ['f'] = 32,
+  ['g'] = 33, ['h'] = 34, ['i'] = 35, ['j'] = 36, ['k'] = 37, ['l'] = 38, ['m'] = 39, ['n'] = 40,
+  ['o'] = 41, ['p'] = 42, ['q'] = 43, ['r'] = 44, ['s'] = 45, ['t'] = 46, ['u'] = 47, ['v'] = 48,
+  ['w'] = 49, ['x'] = 50, ['y'] = 51, ['z'] = 52, ['0'] = 53, ['1'] = 54, ['2'] = 55, ['3'] = 56,
+  ['4'] = 57, ['5'] = 58, ['6'] = 59, ['7'] = 60, ['8'] = 61, ['9'] = 62, ['+'] = 63, ['/'] = 64
+};
+
+static void hex_encode_scalar(char *b, const hex_byte_t *s, hex_size_t len){
+  for(; len > 0; len--, s++){
+    *b++ = hex_digits[*s >> 4];
+    *b++ = hex_digits[*s & 0xf];
+  }
+}
+
+/* len is the number of bytes, a bad digit only shows in the result */
+static int hex_decode_scalar(hex_byte_t *s, const char *b, hex_size_t len){
+  hex_byte_t hi, lo, bad = 0;
+
+  for(; len > 0; len--){
+    hi = hex_values[(hex_byte_t)*b++];
+    lo = hex_values[(hex_byte_t)*b++];
+    bad |= !hi | !lo;
+    *s++ = (hi - 1) << 4 | (lo - 1);
+  }
+
+  return bad ? -1 : 0;
+}
+
+static void base64_encode_scalar(char *b, const hex_byte_t *s, hex_size_t len){
+  for(; len >= 3; len -= 3, s += 3){
+    *b++ = base64_digits[s[0] >> 2];
+    *b++ = base64_digits[(s[0] & 0x3) << 4 | s[1] >> 4];
+    *b++ = base64_digits[(s[1] & 0xf) << 2 | s[2] >> 6];
+    *b++ = base64_digits[s[2] & 0x3f];
+  }
+
+  if(len > 0){
+    *b++ = base64_digits[s[0] >> 2];
+    *b++ = base64_digits[(s[0] & 0x3) << 4 | (len > 1 ? s[1] >> 4 : 0)];
+    *b++ = len > 1 ? base64_digits[(s[1] & 0xf) << 2] : '=';
+    *b++ = '=';
+  }
+}
+
+/* len is the number of chars, a multiple of 4, only the last group may be padded */
+static int base64_decode_scalar(hex_byte_t *s, const char *b, hex_size_t len){
+  const hex_byte_t *c = (const hex_byte_t*)b;
+  hex_byte_t v0, v1, v2, v3, bad = 0, *o = s;
+  hex_size_t pad = 0;
+
+  if(len >= 4 && c[len - 1] == '='){
+    pad = c[len - 2] == '=' ? 2 : 1;
+  }
+
+  for(; len > 4 || (len == 4 && !pad); len -= 4, c += 4){
+    v0 = base64_values[c[0]];
+    v1 = base64_values[c[1]];
+    v2 = base64_values[c[2]];
+    v3 = base64_values[c[3]];
+    bad |= !v0 | !v1 | !v2 | !v3;
+    *o++ = (v0 - 1) << 2 | (v1 - 1) >> 4;
+    *o++ = (v1 - 1) << 4 | (v2 - 1) >> 2;
+    *o++ = (v2 - 1) << 6 | (v3 - 1);
+  }
+
+  if(len == 4){
+    v0 = base64_values[c[0]];
+    v1 = base64_values[c[1]];
+    v2 = pad == 1 ? base64_values[c[2]] : 1;
+    bad |= !v0 | !v1 | !v2;
+    *o++ = (v0 - 1) << 2 | (v1 - 1) >> 4;
+    if(pad == 1){
+      *o++ = (v1 - 1) << 4 | (v2 - 1) >> 2;
+    }
+  }
+
+  return bad ? -1 : o - s;
+}
+
+#if HEX_SIMD
+
+/*
+ * The vector codecs return the number of bytes (encode) or chars (decode)
+ * done in whole blocks, the scalar ones finish the tail. Decoders return -1
+ * on the first block with a bad char.
+ */
+
+/* nibbles to digits with one shuffle, hi and lo digits interleaved */
+static HEX_SSSE3 hex_size_t hex_encode_ssse3(char *b, const hex_byte_t *s, hex_size_t len){
+  const __m128i digits = _mm_loadu_si128((const __m128i*)hex_digits);
+  const __m128i mask = _mm_set1_epi8(0x0f);
+  hex_size_t i;
+
+  for(i = 0; i + 16 <= len; i += 16){
+    __m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+    __m128i hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+    __m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(v, mask));
+    _mm_storeu_si128((__m128i*)(b + 2 * i), _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128((__m128i*)(b + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+  }
+
+  return i;
+}
+
+static HEX_AVX2 hex_size_t hex_encode_avx2(char *b, const hex_byte_t *s, hex_size_t len){
+  const __m256i digits = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)hex_digits));
+  const __m256i mask = _mm256_set1_epi8(0x0f);
+  hex_size_t i;
+
+  for(i = 0; i + 32 <= len; i += 32){
+    __m256i v = _mm256_loadu_si256((const __m256i*)(s + i));
+    __m256i hi = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+    __m256i lo = _mm256_shuffle_epi8(digits, _mm256_and_si256(v, mask));
+    __m256i a = _mm256_unpacklo_epi8(hi, lo), c = _mm256_unpackhi_epi8(hi, lo);
+    /* the unpacks work per 128 bit lane */
+    _mm256_storeu_si256((__m256i*)(b + 2 * i), _mm256_permute2x128_si256(a, c, 0x20));
+    _mm256_storeu_si256((__m256i*)(b + 2 * i + 32), _mm256_permute2x128_si256(a, c, 0x31));
+  }
+
+  return i;
+}
+
+/* digits and letters are told apart by range, then pairs merged with a multiply-add */
+static HEX_SSSE3 int hex_decode_ssse3(hex_byte_t *s, const char *b, hex_size_t len){
+  hex_size_t i;
+
+  for(i = 0; i + 16 <= 2 * len; i += 16){
+    __m128i c = _mm_loadu_si128((const __m128i*)(b + i));
+    __m128i d = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+    __m128i l = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i is_d = _mm_and_si128(_mm_cmpgt_epi8(d, _mm_set1_epi8(-1)), _mm_cmpgt_epi8(_mm_set1_epi8(10), d));
+    __m128i is_l = _mm_and_si128(_mm_cmpgt_epi8(l, _mm_set1_epi8(-1)), _mm_cmpgt_epi8(_mm_set1_epi8(6), l));
+    __m128i v = _mm_or_si128(_mm_and_si128(is_d, d), _mm_and_si128(is_l, _mm_add_epi8(l, _mm_set1_epi8(10))));
+
+    if(_mm_movemask_epi8(_mm_or_si128(is_d, is_l)) != 0xffff){
+      return -1;
+    }
+
+    v = _mm_maddubs_epi16(v, _mm_set1_epi16(0x0110));
+    _mm_storel_epi64((__m128i*)(s + i / 2), _mm_packus_epi16(v, v));
+  }
+
+  return i;
+}
+
+static HEX_AVX2 int hex_decode_avx2(hex_byte_t *s, const char *b, hex_size_t len){
+  hex_size_t i;
+
+  for(i = 0; i + 32 <= 2 * len; i += 32){
+    __m256i c = _mm256_loadu_si256((const __m256i*)(b + i));
+    __m256i d = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+    __m256i l = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    __m256i is_d = _mm256_and_si256(_mm256_cmpgt_epi8(d, _mm256_set1_epi8(-1)), _mm256_cmpgt_epi8(_mm256_set1_epi8(10), d));
+    __m256i is_l = _mm256_and_si256(_mm256_cmpgt_epi8(l, _mm256_set1_epi8(-1)), _mm256_cmpgt_epi8(_mm256_set1_epi8(6), l));
+    __m256i v = _mm256_or_si256(_mm256_and_si256(is_d, d), _mm256_and_si256(is_l, _mm256_add_epi8(l, _mm256_set1_epi8(10))));
+
+    if((unsigned)_mm256_movemask_epi8(_mm256_or_si256(is_d, is_l)) != 0xffffffff){
+      return -1;
+    }
+
+    v = _mm256_maddubs_epi16(v, _mm256_set1_epi16(0x0110));
+    v = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0xd8);
+    _mm_storeu_si128((__m128i*)(s + i / 2), _mm256_castsi256_si128(v));
+  }
+
+  return i;
+}
+
+/* 12 bytes spread to 16 sextets, then mapped to the alphabet by range offsets */
+static HEX_SSSE3 __m128i base64_sextets_ssse3(__m128i v){
+  __m128i t0, t1, t2, t3;
+
+  v = _mm_shuffle_epi8(v, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+  t0 = _mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00));
+  t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+  t2 = _mm_and_si128(v, _mm_set1_epi32(0x003f03f0));
+  t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+
+  return _mm_or_si128(t1, t3);
+}
+
+static HEX_SSSE3 __m128i base64_digits_ssse3(__m128i v){
+  const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                        '/' - 63, 'A', 0, 0);
+  __m128i r = _mm_subs_epu8(v, _mm_set1_epi8(51));
+
+  r = _mm_or_si128(r, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), v), _mm_set1_epi8(13)));
+
+  return _mm_add_epi8(_mm_shuffle_epi8(offsets, r), v);
+}
+
+static HEX_SSSE3 hex_size_t base64_encode_ssse3(char *b, const hex_byte_t *s, hex_size_t len){
+  hex_size_t i;
+
+  /* 16 bytes loaded for 12 used */
+  for(i = 0; i + 16 <= len; i += 12, b += 16){
+    __m128i v = base64_sextets_ssse3(_mm_loadu_si128((const __m128i*)(s + i)));
+    _mm_storeu_si128((__m128i*)b, base64_digits_ssse3(v));
+  }
+
+  return i;
+}
+
+static HEX_AVX2 hex_size_t base64_encode_avx2(char *b, const hex_byte_t *s, hex_size_t len){
+  const __m256i offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                           '/' - 63, 'A', 0, 0,
+                                           'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                           '/' - 63, 'A', 0, 0);
+  hex_size_t i;
+
+  /* 12 bytes per lane, 28 bytes loaded for 24 used */
+  for(i = 0; i + 28 <= len; i += 24, b += 32){
+    __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(s + i))),
+                                        _mm_loadu_si128((const __m128i*)(s + i + 12)), 1);
+    __m256i t0, t1, t2, t3, r;
+
+    v = _mm256_shuffle_epi8(v, _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                                1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+    t0 = _mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00));
+    t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+    t2 = _mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0));
+    t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+    v = _mm256_or_si256(t1, t3);
+
+    r = _mm256_subs_epu8(v, _mm256_set1_epi8(51));
+    r = _mm256_or_si256(r, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), v), _mm256_set1_epi8(13)));
+    _mm256_storeu_si256((__m256i*)b, _mm256_add_epi8(_mm256_shuffle_epi8(offsets, r), v));
+  }
+
+  return i;
+}
+
+/* the nibble lookups flag any char out of the alphabet, '=' included */
+static HEX_SSSE3 int base64_decode_ssse3(hex_byte_t *s, const char *b, hex_size_t len){
+  const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                       0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+  const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                       0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i mask = _mm_set1_epi8(0x0f);
+  hex_byte_t out[16];
+  hex_size_t i;
+
+  /* the last group is left to the scalar code, it may be padded */
+  for(i = 0; i + 16 < len; i += 16, s += 12){
+    __m128i c = _mm_loadu_si128((const __m128i*)(b + i));
+    __m128i hi = _mm_and_si128(_mm_srli_epi32(c, 4), mask);
+    __m128i lo = _mm_and_si128(c, mask);
+    __m128i bad = _mm_and_si128(_mm_shuffle_epi8(lut_lo, lo), _mm_shuffle_epi8(lut_hi, hi));
+    __m128i roll, v;
+
+    if(_mm_movemask_epi8(_mm_cmpeq_epi8(bad, _mm_setzero_si128())) != 0xffff){
+      return -1;
+    }
+
+    roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8('/')), hi));
+    v = _mm_add_epi8(c, roll);
+    v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+    v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+    v = _mm_shuffle_epi8(v, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    _mm_storeu_si128((__m128i*)out, v);
+    memcpy(s, out, 12);
+  }
+
+  return i;
+}
+
+static HEX_AVX2 int base64_decode_avx2(hex_byte_t *s, const char *b, hex_size_t len){
+  const __m256i lut_lo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                          0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+                                          0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                          0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+  const __m256i lut_hi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                          0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                          0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                          0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                                            0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i mask = _mm256_set1_epi8(0x0f);
+  hex_byte_t out[32];
+  hex_size_t i;
+
+  for(i = 0; i + 32 < len; i += 32, s += 24){
+    __m256i c = _mm256_loadu_si256((const __m256i*)(b + i));
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi32(c, 4), mask);
+    __m256i lo = _mm256_and_si256(c, mask);
+    __m256i bad = _mm256_and_si256(_mm256_shuffle_epi8(lut_lo, lo), _mm256_shuffle_epi8(lut_hi, hi));
+    __m256i roll, v;
+
+    if((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bad, _mm256_setzero_si256())) != 0xffffffff){
+      return -1;
+    }
+
+    roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('/')), hi));
+    v = _mm256_add_epi8(c, roll);
+    v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+    v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+    v = _mm256_shuffle_epi8(v, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    v = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+    _mm256_storeu_si256((__m256i*)out, v);
+    memcpy(s, out, 24);
+  }
+
+  return i;
+}
+
+#define HEX_HAS_AVX2 __builtin_cpu_supports("avx2")
+#define HEX_HAS_SSSE3 __builtin_cpu_supports("ssse3")
+
+#endif/*HEX_SIMD*/
+
+hex_size_t hex_encode(char *b, const hex_byte_t *s, hex_size_t len){
+  hex_size_t done = 0;
+
+#if HEX_SIMD
+  if(HEX_HAS_AVX2){
+    done = hex_encode_avx2(b, s, len);
+  }else if(HEX_HAS_SSSE3){
+    done = hex_encode_ssse3(b, s, len);
+  }
+#endif
+
+  hex_encode_scalar(b + 2 * done, s + done, len - done);
+  b[2 * len] = '\0';
+
+  return 2 * len;
+}
+
+int hex_decode(hex_byte_t *s, const char *b, hex_size_t len){
+  int done = 0;
+
+  if(len % 2){
+    return -1;
+  }
+
+#if HEX_SIMD
+  if(HEX_HAS_AVX2){
+    done = hex_decode_avx2(s, b, len / 2);
+  }else if(HEX_HAS_SSSE3){
+    done = hex_decode_ssse3(s, b, len / 2);
+  }
+
+  if(done < 0){
+    return -1;
+  }
+#endif
+
+  if(hex_decode_scalar(s + done / 2, b + done, (len - done) / 2) < 0){
+    return -1;
+  }
+
+  return len / 2;
+}
+
+hex_size_t base64_encode(char *b, const hex_byte_t *s, hex_size_t len){
+  hex_size_t done = 0;
+
+#if HEX_SIMD
+  if(HEX_HAS_AVX2){
+    done = base64_encode_avx2(b, s, len);
+  }else if(HEX_HAS_SSSE3){
+    done = base64_encode_ssse3(b, s, len);
+  }
+#endif
+
+  base64_encode_scalar(b + done / 3 * 4, s + done, len - done);
+  b[BASE64_SIZE(len) - 1] = '\0';
+
+  return BASE64_SIZE(len) - 1;
+}
+
+int base64_decode(hex_byte_t *s, const char *b, hex_size_t len){
+  int done = 0, res;
+
+  if(len % 4){
+    return -1;
+  }
+
+#if HEX_SIMD
+  if(HEX_HAS_AVX2){
+    done = base64_decode_avx2(s, b, len);
+  }else if(HEX_HAS_SSSE3){
+    done = base64_decode_ssse3(s, b, len);
+  }
+
+  if(done < 0){
+    return -1;
+  }
+#endif
+
+  res = base64_decode_scalar(s + done / 4 * 3, b + done, len - done);
+
+  return res < 0 ? -1 : done / 4 * 3 + res;
 }
 
 int hex_load(hex_byte_t *s, hex_size_t len, const char *b){
   const char *c = b;
-  
-  for(; (*c >= '0' && *c <= '9') || (*c >= 'a' && *c <= 'f') || (*c >= 'A' && *c <= 'F'); c++);
-  
+
+  for(; hex_values[(hex_byte_t)*c]; c++);
+
   if((c - b + 1) / 2 != len){ /* not enough input */
     return -1;
   }
@@ -18,41 +446,25 @@ int hex_load(hex_byte_t *s, hex_size_t len, const char *b){
   }
 
   len = c - b;
-  
+
   if(len % 2){
-    *s++ = char2byte(*b++);
+    *s++ = hex_values[(hex_byte_t)*b++] - 1;
   }
-  
-  for(; b < c; ){
-    *s = char2byte(*b++) << 4;
-    *s++ |= char2byte(*b++);
-  }
-  
-  return len;
-}
 
-static inline char byte2char(hex_byte_t i){
-  return i < 10 ? i + '0' : i - 10 + 'a';
+  hex_decode(s, b, c - b);
+
+  return len;
 }
 
 void hex_dump(char *b, const hex_byte_t *s, hex_size_t len){
-  const hex_byte_t *e = s + len;
-  
   if(len < 1){
     return;
   }
-  
-  if(*s < 16){
-    *b++ = byte2char(*s++);
-  }else{
-    *b++ = byte2char(*s >> 4);
-    *b++ = byte2char(*s++ & 0xf);
-  }
 
-  for(; s < e; ){
-    *b++ = byte2char(*s >> 4);
-    *b++ = byte2char(*s++ & 0xf);
+  if(*s < 16){
+    *b++ = hex_digits[*s++];
+    len--;
   }
 
-  *b = '\0';
+  hex_encode(b, s, len);
 }
@@ -10,7 +10,8 @@ extern "C"
  * @file
  * @brief Hex utils
  *
- * Some functions for load/dump hexademical strings to/from bit strings.
+ * Some functions for load/dump hexademical strings to/from bit strings,
+ * and bulk hex and base64 codecs. The bulk codecs use SSSE3 or AVX2 when the CPU has them.
  */
 #ifndef _HEX_H_
 #define _HEX_H_
@@ -23,6 +24,14 @@ extern "C"
  */
 #define HEX_SIZE(len) (2 * (len) + 1)
 
+/**
+ * @brief The size of base64 string with @p len bytes.
+ *
+ * @param len The binary data length in bytes.
+ * @return The number of chars, with padding and terminating zero.
+ */
+#define BASE64_SIZE(len) (4 * (((len) + 2) / 3) + 1)
+
 /**
  * @brief The size type.
  */
@@ -55,6 +64,50 @@ int hex_load(hex_byte_t *s, hex_size_t len, const char *b);
  */
 void hex_dump(char *b, const hex_byte_t *s, hex_size_t len);
 
+/**
+ * @brief The bulk hex encode function.
+ *
+ * Unlike hex_dump() every byte gives exactly two lowercase digits.
+ *
+ * @param[out] b The destination buffer of `HEX_SIZE(len)` chars, zero terminated.
+ * @param[in] s The source binary buffer.
+ * @param[in] len The source buffer size in bytes.
+ * @return The number of chars, without the terminating zero.
+ */
+hex_size_t hex_encode(char *b, const hex_byte_t *s, hex_size_t len);
+
+/**
+ * @brief The bulk hex decode function.
+ *
+ * @param[out] s The destination binary buffer of `len / 2` bytes.
+ * @param[in] b The source hex chars, any case.
+ * @param[in] len The number of source chars, even.
+ * @return The number of bytes when success, -1 when the length is odd or a char isn't a hex digit.
+ */
+int hex_decode(hex_byte_t *s, const char *b, hex_size_t len);
+
+/**
+ * @brief The base64 encode function.
+ *
+ * The standard alphabet with padding, no line breaks.
+ *
+ * @param[out] b The destination buffer of `BASE64_SIZE(len)` chars, zero terminated.
+ * @param[in] s The source binary buffer.
+ * @param[in] len The source buffer size in bytes.
+ * @return The number of chars, without the terminating zero.
+ */
+hex_size_t base64_encode(char *b, const hex_byte_t *s, hex_size_t len);
+
+/**
+ * @brief The base64 decode function.
+ *
+ * @param[out] s The destination binary buffer of `len / 4 * 3` bytes.
+ * @param[in] b The source base64 chars, padded.
+ * @param[in] len The number of source chars, multiple of 4.
+ * @return The number of bytes when success, -1 when the input is malformed.
+ */
+int base64_decode(hex_byte_t *s, const char *b, hex_size_t len);
+
 #endif/*_HEX_H_*/
 /**
  * @}
@@ -0,0 +1,198 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "keyring.h"
+
+/* the end of a chain */
+#define KEYRING_NONE ((size_t)-1)
+
+#define KEYRING_MIN_SLOTS 16
+
+typedef struct {
+  uint32_t id;
+  size_t next;
+  ECIES_privkey_t priv;
+  ECIES_pubkey_t pub;
+} keyring_entry_t;
+
+/* the entries are packed, the slots hold the chains of equal id & mask */
+struct ECIES_keyring {
+  keyring_entry_t *keys;
+  size_t count, cap;
+  size_t *slots;
+  size_t mask;
+};
+
+static void keyring_link(ECIES_keyring_t *ring){
+  size_t i, s;
+
+  for(i = 0; i <= ring->mask; i++){
+    ring->slots[i] = KEYRING_NONE;
+  }
+
+  for(i = 0; i < ring->count; i++){
+    s = ring->keys[i].id & ring->mask;
+    ring->keys[i].next = ring->slots[s];
+    ring->slots[s] = i;
+  }
+}
+
+/* room for one more key, the slots kept at least twice the keys */
+static int keyring_grow(ECIES_keyring_t *ring){
+  keyring_entry_t *keys;
+  size_t *slots, cap;
+
+  if(ring->count < ring->cap){
+    return 0;
+  }
+
+  cap = ring->cap * 2;
+
+  if(!(keys = malloc(cap * sizeof(keyring_entry_t)))){
+    return -1;
+  }
+  if(!(slots = malloc(cap * 2 * sizeof(size_t)))){
+    free(keys);
+    return -1;
+  }
+
+  /* copied, not reallocated, so no private key is left behind in freed memory */
+  memcpy(keys, ring->keys, ring->count * sizeof(keyring_entry_t));
+  memset(ring->keys, 0, ring->count * sizeof(keyring_entry_t));
+  free(ring->keys);
+  free(ring->slots);
+
+  ring->keys = keys;
+  ring->slots = slots;
+  ring->cap = cap;
+  ring->mask = cap * 2 - 1;
+
+  keyring_link(ring);
+
+  return 0;
+}
+
+static size_t keyring_find(const ECIES_keyring_t *ring, uint32_t id, const ECIES_pubkey_t *pubkey){
+  size_t i;
+
+  for(i = ring->slots[id & ring->mask]; i != KEYRING_NONE; i = ring->keys[i].next){
+    if(ring->keys[i].id == id && !memcmp(&ring->keys[i].pub, pubkey, sizeof(ECIES_pubkey_t))){
+      break;
+    }
+  }
+
+  return i;
+}
+
+ECIES_keyring_t *ECIES_keyring_new(void){
+  ECIES_keyring_t *ring = malloc(sizeof(ECIES_keyring_t));
+
+  if(!ring){
+    return NULL;
+  }
+
+  ring->count = 0;
+  ring->cap = KEYRING_MIN_SLOTS / 2;
+  ring->mask = KEYRING_MIN_SLOTS - 1;
+  ring->keys = malloc(ring->cap * sizeof(keyring_entry_t));
+  ring->slots = malloc(KEYRING_MIN_SLOTS * sizeof(size_t));
+
+  if(!ring->keys || !ring->slots){
+    free(ring->keys);
+    free(ring->slots);
+    free(ring);
+    return NULL;
+  }
+
+  keyring_link(ring);
+
+  return ring;
+}
+
+int ECIES_keyring_add(ECIES_keyring_t *ring, const ECIES_privkey_t *privkey){
+  keyring_entry_t *e;
+  ECIES_pubkey_t pub;
+  uint32_t id;
+  size_t s;
+
+  if(ECIES_derive_pubkey(&pub, privkey) < 0){
+    return -2;
+  }
+
+  id = ECIES_key_id(&pub);
+
+  if(keyring_find(ring, id, &pub) != KEYRING_NONE){
+    return 0;
+  }
+
+  if(keyring_grow(ring) < 0){
+    return -1;
+  }
+
+  e = &ring->keys[ring->count];
+  e->id = id;
+  e->priv = *privkey;
+  e->pub = pub;
+
+  s = id & ring->mask;
+  e->next = ring->slots[s];
+  ring->slots[s] = ring->count++;
+
+  return 1;
+}
+
+int ECIES_keyring_remove(ECIES_keyring_t *ring, const ECIES_pubkey_t *pubkey){
+  size_t i = keyring_find(ring, ECIES_key_id(pubkey), pubkey);
+
+  if(i == KEYRING_NONE){
+    return 0;
+  }
+
+  /* the last entry fills the hole, the chains are relinked */
+  ring->keys[i] = ring->keys[--ring->count];
+  memset(&ring->keys[ring->count], 0, sizeof(keyring_entry_t));
+
+  keyring_link(ring);
+
+  return 1;
+}
+
+size_t ECIES_keyring_count(const ECIES_keyring_t *ring){
+  return ring->count;
+}
+
+int ECIES_decrypt_keyring(char *raw, ECIES_size_t len, const ECIES_byte_t *msg, const ECIES_keyring_t *ring){
+  int res = -4;
+  uint32_t id;
+  size_t i;
+
+  if(ECIES_start_size(msg) < 0){
+    return -1;
+  }
+
+  /* the keys of that ID, usually one */
+  if(ECIES_start_key_id(msg, &id)){
+    for(i = ring->slots[id & ring->mask]; i != KEYRING_NONE; i = ring->keys[i].next){
+      if(ring->keys[i].id == id && (res = ECIES_decrypt(raw, len, msg, &ring->keys[i].priv)) > 0){
+        break;
+      }
+    }
+    return res;
+  }
+
+  /* no ID, every key in turn */
+  for(i = 0; i < ring->count; i++){
+    if((res = ECIES_decrypt(raw, len, msg, &ring->keys[i].priv)) > 0){
+      break;
+    }
+  }
+
+  return res;
+}
+
+void ECIES_keyring_free(ECIES_keyring_t *ring){
+  memset(ring->keys, 0, ring->count * sizeof(keyring_entry_t));
+  free(ring->keys);
+  free(ring->slots);
+  free(ring);
+}
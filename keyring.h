@@ -0,0 +1,88 @@
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+/**
+ * @defgroup keyring Keyring
+ * @brief Many private keys, selected by the key ID of the message.
+ * @{
+ *
+ * @file
+ * @brief Keyring
+ *
+ * A keyring holds private keys hashed by the key ID (see ECIES_key_id()) of
+ * their public keys. A keyed message (see ECIES_encrypt_keyed()) names its key,
+ * so ECIES_decrypt_keyring() finds it with one lookup and does the EC work once;
+ * only keys sharing the 32-bit ID are tried in turn until the MAC verifies.
+ * Messages without a key ID fall back to trying every key.
+ *
+ * Lookups don't modify the keyring, they may run from many threads as long as
+ * no key is added or removed meanwhile.
+ */
+#ifndef _KEYRING_H_
+#define _KEYRING_H_
+
+#include <stddef.h>
+#include "ecc.h"
+
+/**
+ * @brief The keyring type.
+ */
+typedef struct ECIES_keyring ECIES_keyring_t;
+
+/**
+ * @brief Create empty keyring.
+ *
+ * @return The keyring, NULL when failed.
+ */
+ECIES_keyring_t *ECIES_keyring_new(void);
+
+/**
+ * @brief Add private key.
+ *
+ * @param[in] ring The keyring.
+ * @param[in] privkey The private key, copied.
+ * @return 1 when added, 0 when already present, -1 when out of memory, -2 when the key is not valid.
+ *
+ * Costs one point multiplication, to compute the public key and its ID.
+ */
+int ECIES_keyring_add(ECIES_keyring_t *ring, const ECIES_privkey_t *privkey);
+
+/**
+ * @brief Remove the private key of a public key.
+ *
+ * @param[in] ring The keyring.
+ * @param[in] pubkey The public key.
+ * @return 1 when removed, 0 when not present.
+ */
+int ECIES_keyring_remove(ECIES_keyring_t *ring, const ECIES_pubkey_t *pubkey);
+
+/**
+ * @brief The number of keys in the keyring.
+ */
+size_t ECIES_keyring_count(const ECIES_keyring_t *ring);
+
+/**
+ * @brief Decrypt data with the key the message was encrypted to.
+ *
+ * @param[out] raw The destination decrypted raw data buffer.
+ * @param[in] len The length of destination decrypted raw data in bytes.
+ * @param[in] msg The source encrypted data, plain, compact or keyed.
+ * @param[in] ring The keyring.
+ * @return 1 when success, -4 when no key has the ID of a keyed message or the keyring is empty,
+ * other < 0 as ECIES_decrypt() returns them.
+ */
+int ECIES_decrypt_keyring(char *raw, ECIES_size_t len, const ECIES_byte_t *msg, const ECIES_keyring_t *ring);
+
+/**
+ * @brief Free the keyring, the private keys are wiped.
+ */
+void ECIES_keyring_free(ECIES_keyring_t *ring);
+
+#endif/*_KEYRING_H_*/
+/**
+ * @}
+ */
+#ifdef __cplusplus
+}
+#endif
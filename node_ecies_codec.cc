@@ -0,0 +1,159 @@
+// node_ecies_codec.cc
+#include <stdlib.h>
+#include "node_ecies_codec.h"
+#include "hex.h"
+
+namespace node_ecies {
+
+// Shorter strings are cheaper to copy than to keep external
+static const size_t kExternalMin = 1024;
+
+// The largest Buffer to encode, hex doubles it
+static const size_t kEncodeMax = 0x3fffffff;
+
+// Owns the encoded chars, V8 deletes it with the string
+class EncodedString : public Nan::ExternalOneByteStringResource {
+ public:
+  EncodedString(char* data, size_t length) : data_(data), length_(length) {}
+  ~EncodedString() { free(data_); }
+
+  const char* data() const { return data_; }
+  size_t length() const { return length_; }
+
+ private:
+  char* data_;
+  size_t length_;
+};
+
+static void Encode(const Nan::FunctionCallbackInfo<v8::Value>& args, bool base64) {
+  if (args.Length() < 1 || !node::Buffer::HasInstance(args[0])) {
+    Nan::ThrowTypeError("Wrong arguments");
+    return;
+  }
+
+  const hex_byte_t* data = (const hex_byte_t*)node::Buffer::Data(args[0]);
+  size_t len = node::Buffer::Length(args[0]);
+
+  if (len > kEncodeMax) {
+    Nan::ThrowRangeError("Buffer too large");
+    return;
+  }
+
+  char* text = (char*)malloc(base64 ? BASE64_SIZE(len) : HEX_SIZE(len));
+
+  if (!text) {
+    Nan::ThrowError("Out of memory");
+    return;
+  }
+
+  size_t chars = base64 ? base64_encode(text, data, len) : hex_encode(text, data, len);
+  v8::Local<v8::String> str;
+  bool ok;
+
+  if (chars < kExternalMin) {
+    ok = Nan::New(text, (int)chars).ToLocal(&str);
+    free(text);
+  } else {
+    EncodedString* resource = new EncodedString(text, chars);
+    ok = Nan::New(resource).ToLocal(&str);
+    if (!ok) {
+      delete resource;
+    }
+  }
+
+  if (!ok) {
+    Nan::ThrowRangeError("String too long");
+    return;
+  }
+
+  args.GetReturnValue().Set(str);
+}
+
+static void Decode(const Nan::FunctionCallbackInfo<v8::Value>& args, bool base64) {
+  const char* text = NULL;
+  char* copy = NULL;
+  size_t len = 0;
+
+  if (args.Length() < 1) {
+    Nan::ThrowTypeError("Wrong arguments");
+    return;
+  }
+
+  if (node::Buffer::HasInstance(args[0])) {
+    text = node::Buffer::Data(args[0]);
+    len = node::Buffer::Length(args[0]);
+  } else if (args[0]->IsString()) {
+    v8::Local<v8::String> str = args[0]->ToString();
+
+    if (str->IsExternalOneByte()) {
+      // most likely one of ours
+      const Nan::ExternalOneByteStringResource* resource = str->GetExternalOneByteStringResource();
+      text = resource->data();
+      len = resource->length();
+    } else if (str->ContainsOnlyOneByte()) {
+      len = str->Length();
+      if (!(copy = (char*)malloc(len > 0 ? len : 1))) {
+        Nan::ThrowError("Out of memory");
+        return;
+      }
+      str->WriteOneByte((uint8_t*)copy, 0, (int)len, v8::String::NO_NULL_TERMINATION);
+      text = copy;
+    }
+  }
+
+  if (!text) {
+    Nan::ThrowTypeError("Wrong arguments");
+    return;
+  }
+
+  size_t size = base64 ? len / 4 * 3 : len / 2;
+  char* data = (char*)malloc(size > 0 ? size : 1);
+
+  if (!data) {
+    free(copy);
+    Nan::ThrowError("Out of memory");
+    return;
+  }
+
+  int res = len > 0xffffffff ? -1 : base64 ? base64_decode((hex_byte_t*)data, text, (hex_size_t)len)
+                                           : hex_decode((hex_byte_t*)data, text, (hex_size_t)len);
+
+  free(copy);
+
+  if (res < 0) {
+    free(data);
+    Nan::ThrowError(base64 ? "Invalid base64" : "Invalid hex");
+    return;
+  }
+
+  args.GetReturnValue().Set(Nan::NewBuffer(data, (uint32_t)res).ToLocalChecked());
+}
+
+// hexEncode(buffer) returns the lowercase hex string
+void Codec::HexEncode(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  Encode(args, false);
+}
+
+// hexDecode(string or buffer) returns the bytes, throws on a bad digit or odd length
+void Codec::HexDecode(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  Decode(args, false);
+}
+
+// base64Encode(buffer) returns the padded base64 string
+void Codec::Base64Encode(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  Encode(args, true);
+}
+
+// base64Decode(string or buffer) returns the bytes, the input must be padded
+void Codec::Base64Decode(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  Decode(args, true);
+}
+
+void Codec::Init(v8::Local<v8::Object> exports) {
+  Nan::SetMethod(exports, "hexEncode", HexEncode);
+  Nan::SetMethod(exports, "hexDecode", HexDecode);
+  Nan::SetMethod(exports, "base64Encode", Base64Encode);
+  Nan::SetMethod(exports, "base64Decode", Base64Decode);
+}
+
+}  // namespace node_ecies
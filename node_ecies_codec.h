@@ -0,0 +1,25 @@
+// node_ecies_codec.h
+#ifndef ECIESCODEC_H
+#define ECIESCODEC_H
+
+#include <nan.h>
+
+namespace node_ecies {
+
+// Bulk hex and base64 conversion (see hex.h) between Buffers and strings.
+// Long encoded strings are external: V8 adopts the encoder output as it is,
+// and decoding reads such strings, or Buffers holding text, in place.
+class Codec {
+	public:
+		static void Init(v8::Local<v8::Object> exports);
+
+	private:
+		static void HexEncode(const Nan::FunctionCallbackInfo<v8::Value>& args);
+		static void HexDecode(const Nan::FunctionCallbackInfo<v8::Value>& args);
+		static void Base64Encode(const Nan::FunctionCallbackInfo<v8::Value>& args);
+		static void Base64Decode(const Nan::FunctionCallbackInfo<v8::Value>& args);
+};
+
+}  // namespace node_ecies
+
+#endif
@@ -0,0 +1,554 @@
+// node_ecies_engine.cc
+#include <stdlib.h>
+#include <string.h>
+#include "node_ecies_engine.h"
+#include "node_ecies_stats.h"
+
+namespace node_ecies {
+
+thread_local Nan::Persistent<v8::Function> ECIESEngine::constructor;
+
+static const uint32_t kDefaultCapacity = 65536;
+
+// Decrypt jobs to one key which share a ladder, see ECIES_decrypt_start_batch()
+static const int kBatch = ECIES_LANES > 0 ? ECIES_LANES : 1;
+
+// The result of a job whose output could not be allocated
+static const int kOutOfMemory = -4;
+
+// One message; input and output are owned by the job, 'in' is NULL when
+// the copy could not be allocated
+struct EngineJob {
+  bool decrypt;
+  int res;
+  ECIES_byte_t* in;
+  size_t in_len;
+  ECIES_byte_t* out;
+  size_t out_len;
+  std::shared_ptr<const PublicKeyEntry> pubkey;
+  ECIES_privkey_t privkey;
+  Nan::Callback* callback;
+
+  EngineJob(bool decrypt, const char* data, size_t len, Nan::Callback* callback)
+    : decrypt(decrypt), res(1), in((ECIES_byte_t*)malloc(len + 1)), in_len(len),
+      out(NULL), out_len(0), privkey(), callback(callback) {
+    if (in) {
+      memcpy(in, data, len);
+    }
+  }
+
+  ~EngineJob() {
+    memset(&privkey, 0, sizeof(privkey));
+    free(in);
+    free(out);
+    delete callback;
+  }
+
+  // Multi-recipient messages carry a tag byte, as in ECIESWrapper::Decrypt()
+  bool Multi() const {
+    return in_len >= 3 && ECIES_multi_count(in) > 0;
+  }
+
+  // The size of the starting sequence of a decrypt job, < 0 when it is
+  // malformed or the message is too short for it
+  long StartSize() const {
+    long size;
+
+    if (in_len < 1) {
+      return -1;
+    }
+
+    size = Multi() ? ECIES_MULTI_START_OVERHEAD(ECIES_multi_count(in)) : ECIES_start_size(in);
+
+    return size >= 0 && in_len >= (size_t)size + ECIES_CHUNK_OVERHEAD ? size : -1;
+  }
+
+  // Single-recipient messages of any start form, see ECIES_decrypt_batch()
+  bool Batchable() const {
+    return decrypt && !Multi() && StartSize() >= 0;
+  }
+
+  void Run() {
+    uint64_t start = Stats::Now();
+
+    if (decrypt) {
+      long size = StartSize();
+
+      if (size < 0) {
+        res = -3;
+      } else {
+        out_len = in_len - size - ECIES_CHUNK_OVERHEAD;
+        out = (ECIES_byte_t*)malloc(out_len + 1);
+        if (!out) {
+          res = kOutOfMemory;
+        } else if (Multi()) {
+          res = ECIES_decrypt_multi((char*)out, out_len, in, &privkey);
+        } else {
+          res = ECIES_decrypt((char*)out, out_len, in, &privkey);
+        }
+      }
+      Stats::Record(Stats::kDecrypt, res, out_len, start);
+      return;
+    }
+
+    out_len = in_len + ECIES_OVERHEAD;
+    out = (ECIES_byte_t*)malloc(out_len);
+
+    if (!out) {
+      res = kOutOfMemory;
+    } else if (pubkey->valid) {
+      ECIES_encrypt_prepared(out, (const char*)in, in_len, &pubkey->table);
+    } else {
+      ECIES_encrypt(out, (const char*)in, in_len, &pubkey->key);
+    }
+
+    Stats::Record(Stats::kEncrypt, res, in_len, start);
+  }
+};
+
+// Batchable jobs with the same key in one ECIES_decrypt_batch() call, a job
+// without memory for its output fails alone
+static void RunBatch(EngineJob** batch, int n) {
+  EngineJob* ready[kBatch];
+  const ECIES_byte_t* msg[kBatch];
+  char* raw[kBatch];
+  ECIES_size_t len[kBatch];
+  int res[kBatch];
+  int m = 0;
+  uint64_t start = Stats::Now();
+
+  for (int i = 0; i < n; i++) {
+    EngineJob* job = batch[i];
+    job->out_len = job->in_len - job->StartSize() - ECIES_CHUNK_OVERHEAD;
+    job->out = (ECIES_byte_t*)malloc(job->out_len + 1);
+    if (!job->out) {
+      job->res = kOutOfMemory;
+      Stats::Record(Stats::kDecrypt, job->res, 0, start);
+      continue;
+    }
+    ready[m] = job;
+    msg[m] = job->in;
+    raw[m] = (char*)job->out;
+    len[m] = job->out_len;
+    m++;
+  }
+
+  if (m > 0) {
+    ECIES_decrypt_batch(res, raw, len, msg, m, &ready[0]->privkey);
+  }
+
+  for (int i = 0; i < m; i++) {
+    ready[i]->res = res[i];
+    Stats::Record(Stats::kDecrypt, res[i], ready[i]->out_len, start);
+  }
+}
+
+JobRing::JobRing(size_t capacity) : head_(0), tail_(0) {
+  size_t size = 2;
+
+  for (; size < capacity; size <<= 1) {
+  }
+
+  cells_.reset(new Cell[size]);
+  mask_ = size - 1;
+
+  for (size_t i = 0; i < size; i++) {
+    cells_[i].seq.store(i, std::memory_order_relaxed);
+    cells_[i].job = NULL;
+  }
+}
+
+bool JobRing::Push(EngineJob* job) {
+  size_t pos = tail_.load(std::memory_order_relaxed);
+  Cell* cell;
+
+  for (;;) {
+    cell = &cells_[pos & mask_];
+    intptr_t diff = (intptr_t)cell->seq.load(std::memory_order_acquire) - (intptr_t)pos;
+
+    if (diff == 0) {
+      if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false;  // full
+    } else {
+      pos = tail_.load(std::memory_order_relaxed);
+    }
+  }
+
+  cell->job = job;
+  cell->seq.store(pos + 1, std::memory_order_release);
+
+  return true;
+}
+
+bool JobRing::Pop(EngineJob** job) {
+  size_t pos = head_.load(std::memory_order_relaxed);
+  Cell* cell;
+
+  for (;;) {
+    cell = &cells_[pos & mask_];
+    intptr_t diff = (intptr_t)cell->seq.load(std::memory_order_acquire) - (intptr_t)(pos + 1);
+
+    if (diff == 0) {
+      if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false;  // empty
+    } else {
+      pos = head_.load(std::memory_order_relaxed);
+    }
+  }
+
+  *job = cell->job;
+  cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+
+  return true;
+}
+
+ECIESEngine::ECIESEngine(uint32_t threads, uint32_t capacity)
+  : privkey_(), jobs_(capacity), done_(capacity), capacity_(capacity), inflight_(0), closing_(false),
+    stop_(false), sleepers_(0), isolate_(v8::Isolate::GetCurrent()), async_(new uv_async_t),
+    async_pending_(false) {
+  uv_async_init(Nan::GetCurrentEventLoop(), async_, OnAsync);
+  async_->data = this;
+  // Only keep the loop alive while jobs are in flight
+  uv_unref((uv_handle_t*)async_);
+
+  for (uint32_t i = 0; i < threads; i++) {
+    threads_.push_back(std::thread(&ECIESEngine::WorkerLoop, this));
+  }
+
+  // Worker threads must not outlive the environment, see CleanupHook()
+  node::AddEnvironmentCleanupHook(isolate_, CleanupHook, this);
+}
+
+ECIESEngine::~ECIESEngine() {
+  Shutdown();
+  memset(&privkey_, 0, sizeof(privkey_));
+}
+
+void ECIESEngine::WorkerLoop() {
+  EngineJob* job;
+
+  while (!stop_.load(std::memory_order_relaxed)) {
+    if (jobs_.Pop(&job)) {
+      Run(job);
+      continue;
+    }
+
+    // Announce the sleep before the last look at the ring: Submit() pushes
+    // before it checks for sleepers, so one of the two sees the other. The
+    // ring is not seq_cst, the fences on both sides keep that order
+    std::unique_lock<std::mutex> lock(sleep_lock_);
+    sleepers_.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (jobs_.Pop(&job)) {
+      sleepers_.fetch_sub(1);
+      lock.unlock();
+      Run(job);
+      continue;
+    }
+    if (!stop_.load()) {
+      wake_.wait(lock);
+    }
+    sleepers_.fetch_sub(1);
+  }
+}
+
+// A decrypt job takes the queued decrypts to the same key along, up to kBatch,
+// one ladder decrypts them all in about the time of one
+void ECIESEngine::Run(EngineJob* job) {
+  EngineJob* batch[kBatch];
+  EngineJob* next;
+  int n = 0;
+
+  if (!job->Batchable()) {
+    job->Run();
+    Complete(job);
+    return;
+  }
+
+  batch[n++] = job;
+
+  while (n < kBatch && jobs_.Pop(&next)) {
+    if (next->Batchable() && !memcmp(&next->privkey, &job->privkey, sizeof(ECIES_privkey_t))) {
+      batch[n++] = next;
+    } else {
+      next->Run();
+      Complete(next);
+    }
+  }
+
+  RunBatch(batch, n);
+
+  for (int i = 0; i < n; i++) {
+    Complete(batch[i]);
+  }
+}
+
+bool ECIESEngine::Submit(EngineJob* job) {
+  if (inflight_ >= capacity_) {
+    return false;
+  }
+
+  if (inflight_++ == 0) {
+    Ref();
+    uv_ref((uv_handle_t*)async_);
+  }
+
+  // Cannot fail, at most capacity_ jobs exist
+  jobs_.Push(job);
+
+  // The push must be visible before sleepers_ is read, see WorkerLoop()
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (sleepers_.load() > 0) {
+    std::lock_guard<std::mutex> lock(sleep_lock_);
+    wake_.notify_one();
+  }
+
+  return true;
+}
+
+// Worker side: queue the result, wake the loop unless a wakeup is already pending
+void ECIESEngine::Complete(EngineJob* job) {
+  while (!done_.Push(job)) {
+    std::this_thread::yield();
+  }
+
+  if (!async_pending_.exchange(true)) {
+    uv_async_send(async_);
+  }
+}
+
+static v8::Local<v8::Value> EngineError(const char* message, int code) {
+  v8::Local<v8::Value> err = Nan::Error(message);
+  err.As<v8::Object>()->Set(Nan::New("code").ToLocalChecked(), Nan::New(code));
+  return err;
+}
+
+void ECIESEngine::OnAsync(uv_async_t* handle) {
+  ECIESEngine* engine = static_cast<ECIESEngine*>(handle->data);
+
+  if (engine) {
+    // Reset first, a job completing during the drain sends a new wakeup
+    engine->async_pending_.store(false);
+    engine->Drain();
+  }
+}
+
+// JS thread: run the callbacks of every completed job
+void ECIESEngine::Drain() {
+  EngineJob* job;
+
+  while (inflight_ > 0 && done_.Pop(&job)) {
+    Nan::HandleScope scope;
+
+    if (job->res < 0) {
+      v8::Local<v8::Value> argv[] = {
+        EngineError(job->res == -3 ? "Truncated ECIES message" :
+                    job->res == kOutOfMemory ? "Out of memory" : "ECIES decryption failed", job->res)
+      };
+      job->callback->Call(1, argv);
+    } else {
+      // The buffer takes ownership of the output memory
+      v8::Local<v8::Value> argv[] = { Nan::Null(), Nan::NewBuffer((char*)job->out, job->out_len).ToLocalChecked() };
+      job->out = NULL;
+      job->callback->Call(2, argv);
+    }
+
+    delete job;
+
+    if (--inflight_ == 0) {
+      uv_unref((uv_handle_t*)async_);
+      if (closing_) {
+        Shutdown();
+      }
+      Unref();
+      return;
+    }
+  }
+}
+
+void ECIESEngine::Shutdown() {
+  if (!async_) {
+    return;
+  }
+
+  node::RemoveEnvironmentCleanupHook(isolate_, CleanupHook, this);
+
+  stop_.store(true);
+  {
+    std::lock_guard<std::mutex> lock(sleep_lock_);
+    wake_.notify_all();
+  }
+
+  for (size_t i = 0; i < threads_.size(); i++) {
+    threads_[i].join();
+  }
+  threads_.clear();
+
+  async_->data = NULL;
+  uv_close((uv_handle_t*)async_, [](uv_handle_t* handle) {
+    delete (uv_async_t*)handle;
+  });
+  async_ = NULL;
+}
+
+// The environment is going away with jobs in flight, so the engine is never
+// collected: stop and join the workers before the loop and the async handle
+// go, and drop the jobs whose callbacks can no longer run
+void ECIESEngine::CleanupHook(void* arg) {
+  ECIESEngine* engine = static_cast<ECIESEngine*>(arg);
+  EngineJob* job;
+
+  engine->Shutdown();
+
+  while (engine->jobs_.Pop(&job) || engine->done_.Pop(&job)) {
+    delete job;
+  }
+  engine->inflight_ = 0;
+}
+
+// Object initiator
+void ECIESEngine::Init(v8::Local<v8::Object> exports) {
+  Nan::HandleScope scope;
+
+  // Prepare constructor template
+  v8::Local<v8::FunctionTemplate> tpl = Nan::New<v8::FunctionTemplate>(New);
+  tpl->SetClassName(Nan::New("ECIESEngine").ToLocalChecked());
+  tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+  // Prototype
+  Nan::SetPrototypeMethod(tpl, "setClientPublicKey", SetClientPublicKey);
+  Nan::SetPrototypeMethod(tpl, "setPrivateKey", SetPrivateKey);
+  Nan::SetPrototypeMethod(tpl, "encrypt", Encrypt);
+  Nan::SetPrototypeMethod(tpl, "decrypt", Decrypt);
+  Nan::SetPrototypeMethod(tpl, "close", Close);
+
+  constructor.Reset(tpl->GetFunction());
+  exports->Set(Nan::New("ECIESEngine").ToLocalChecked(), tpl->GetFunction());
+}
+
+// Constructor: new ECIESEngine([threads[, capacity]])
+// threads defaults to the number of CPUs, capacity (jobs in flight) to 65536
+void ECIESEngine::New(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  if (args.IsConstructCall()) {
+    uint32_t threads = args[0]->IsUint32() ? args[0]->Uint32Value() : std::thread::hardware_concurrency();
+    uint32_t capacity = args[1]->IsUint32() ? args[1]->Uint32Value() : kDefaultCapacity;
+
+    if (threads < 1) {
+      threads = 1;
+    }
+    if (capacity < 1 || capacity > (1u << 24)) {
+      return Nan::ThrowRangeError("ECIESEngine capacity out of range");
+    }
+
+    ECIESEngine* obj = new ECIESEngine(threads, capacity);
+    obj->Wrap(args.This());
+    args.GetReturnValue().Set(args.This());
+  } else {
+    // Invoked as plain function `ECIESEngine(...)`, turn into construct call.
+    const int argc = 2;
+    v8::Local<v8::Value> argv[argc] = { args[0], args[1] };
+    v8::Local<v8::Function> cons = Nan::New<v8::Function>(constructor);
+    args.GetReturnValue().Set(cons->NewInstance(argc, argv));
+  }
+}
+
+// Set public key used by encrypt(): setClientPublicKey(x, y)
+void ECIESEngine::SetClientPublicKey(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIESEngine* obj = ObjectWrap::Unwrap<ECIESEngine>(args.Holder());
+
+  if (!node::Buffer::HasInstance(args[0]) || node::Buffer::Length(args[0]) != ECIES_KEY_SIZE ||
+      !node::Buffer::HasInstance(args[1]) || node::Buffer::Length(args[1]) != ECIES_KEY_SIZE) {
+    return Nan::ThrowTypeError("setClientPublicKey(x, y) expects two 21 byte buffers");
+  }
+
+  ECIES_pubkey_t key;
+  memcpy(key.x, node::Buffer::Data(args[0]), ECIES_KEY_SIZE);
+  memcpy(key.y, node::Buffer::Data(args[1]), ECIES_KEY_SIZE);
+
+  // Jobs already queued keep the key they were submitted with
+  obj->pubkey_ = KeyTable::Acquire(key);
+}
+
+// Set private key used by decrypt(): setPrivateKey(k)
+void ECIESEngine::SetPrivateKey(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIESEngine* obj = ObjectWrap::Unwrap<ECIESEngine>(args.Holder());
+
+  if (!node::Buffer::HasInstance(args[0]) || node::Buffer::Length(args[0]) != ECIES_KEY_SIZE) {
+    return Nan::ThrowTypeError("setPrivateKey(k) expects a 21 byte buffer");
+  }
+
+  memcpy(obj->privkey_.k, node::Buffer::Data(args[0]), ECIES_KEY_SIZE);
+}
+
+// Queue one message: encrypt(buf, callback(err, encrypted))
+void ECIESEngine::Encrypt(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIESEngine* obj = ObjectWrap::Unwrap<ECIESEngine>(args.Holder());
+
+  if (!node::Buffer::HasInstance(args[0]) || !args[1]->IsFunction()) {
+    return Nan::ThrowTypeError("encrypt(buf, callback) expects a buffer and a callback");
+  }
+  if (!obj->pubkey_) {
+    return Nan::ThrowError("No public key set");
+  }
+  if (obj->closing_) {
+    return Nan::ThrowError("ECIESEngine is closed");
+  }
+
+  EngineJob* job = new EngineJob(false, node::Buffer::Data(args[0]), node::Buffer::Length(args[0]),
+                                 new Nan::Callback(args[1].As<v8::Function>()));
+  if (!job->in) {
+    delete job;
+    return Nan::ThrowError("Out of memory");
+  }
+  job->pubkey = obj->pubkey_;
+
+  if (!obj->Submit(job)) {
+    delete job;
+    return Nan::ThrowRangeError("ECIESEngine queue is full");
+  }
+}
+
+// Queue one message: decrypt(buf, callback(err, decrypted)), the plaintext
+// is the message length minus the overhead
+void ECIESEngine::Decrypt(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIESEngine* obj = ObjectWrap::Unwrap<ECIESEngine>(args.Holder());
+
+  if (!node::Buffer::HasInstance(args[0]) || !args[1]->IsFunction()) {
+    return Nan::ThrowTypeError("decrypt(buf, callback) expects a buffer and a callback");
+  }
+  if (obj->closing_) {
+    return Nan::ThrowError("ECIESEngine is closed");
+  }
+
+  EngineJob* job = new EngineJob(true, node::Buffer::Data(args[0]), node::Buffer::Length(args[0]),
+                                 new Nan::Callback(args[1].As<v8::Function>()));
+  if (!job->in) {
+    delete job;
+    return Nan::ThrowError("Out of memory");
+  }
+  job->privkey = obj->privkey_;
+
+  if (!obj->Submit(job)) {
+    delete job;
+    return Nan::ThrowRangeError("ECIESEngine queue is full");
+  }
+}
+
+// Refuse new jobs and stop the threads once the queued ones are delivered
+void ECIESEngine::Close(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIESEngine* obj = ObjectWrap::Unwrap<ECIESEngine>(args.Holder());
+
+  obj->closing_ = true;
+
+  if (obj->inflight_ == 0) {
+    obj->Shutdown();
+  }
+}
+
+}  // namespace node_ecies
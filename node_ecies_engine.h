@@ -0,0 +1,97 @@
+// node_ecies_engine.h
+#ifndef ECIESENGINE_H
+#define ECIESENGINE_H
+
+#include <nan.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ecc.h"
+#include "node_ecies_keytable.h"
+
+namespace node_ecies {
+
+struct EngineJob;
+
+// Bounded lock-free multi-producer multi-consumer ring (Vyukov's algorithm).
+// Every cell carries a sequence number telling whose turn it is, so producers
+// and consumers only contend on their own index.
+class JobRing {
+	public:
+		explicit JobRing(size_t capacity);
+
+		bool Push(EngineJob* job);
+		bool Pop(EngineJob** job);
+
+	private:
+		struct Cell {
+			std::atomic<size_t> seq;
+			EngineJob* job;
+		};
+
+		std::unique_ptr<Cell[]> cells_;
+		size_t mask_;
+		// Keep the indices on their own cache lines
+		char pad0_[64];
+		std::atomic<size_t> head_;
+		char pad1_[64];
+		std::atomic<size_t> tail_;
+		char pad2_[64];
+};
+
+// Dedicated crypto engine: its own worker threads take encrypt/decrypt jobs
+// from a JobRing and put the results into a second one. Results are delivered
+// to JS in batches, one uv_async_t wakeup drains every completed job, so a
+// burst of small messages costs one loop wakeup instead of one per message.
+class ECIESEngine : public node::ObjectWrap {
+	public:
+		static void Init(v8::Local<v8::Object> exports);
+
+	private:
+		explicit ECIESEngine(uint32_t threads, uint32_t capacity);
+		~ECIESEngine();
+
+		bool Submit(EngineJob* job);
+		void WorkerLoop();
+		void Run(EngineJob* job);
+		void Complete(EngineJob* job);
+		void Drain();
+		void Shutdown();
+		static void OnAsync(uv_async_t* handle);
+		static void CleanupHook(void* arg);
+
+	static void New(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void SetClientPublicKey(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void SetPrivateKey(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void Encrypt(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void Decrypt(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void Close(const Nan::FunctionCallbackInfo<v8::Value>& args);
+
+	static thread_local Nan::Persistent<v8::Function> constructor;
+
+	ECIES_privkey_t privkey_;
+	std::shared_ptr<const PublicKeyEntry> pubkey_;
+
+	JobRing jobs_;
+	JobRing done_;
+	uint32_t capacity_;
+	uint32_t inflight_;  // owned by the JS thread
+	bool closing_;
+
+	std::vector<std::thread> threads_;
+	std::atomic<bool> stop_;
+	std::atomic<int> sleepers_;
+	std::mutex sleep_lock_;
+	std::condition_variable wake_;
+
+	v8::Isolate* isolate_;
+	uv_async_t* async_;
+	std::atomic<bool> async_pending_;
+};
+
+}  // namespace node_ecies
+
+#endif
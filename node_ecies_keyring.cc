@@ -0,0 +1,162 @@
+// node_ecies_keyring.cc
+#include <stdlib.h>
+#include <string.h>
+#include "node_ecies_keyring.h"
+#include "node_ecies_stats.h"
+
+namespace node_ecies {
+
+thread_local Nan::Persistent<v8::Function> Keyring::constructor;
+
+Keyring::Keyring() : ring(ECIES_keyring_new()) {
+}
+
+Keyring::~Keyring() {
+  if (ring) {
+    ECIES_keyring_free(ring);
+  }
+}
+
+// Object initiator
+void Keyring::Init(v8::Local<v8::Object> exports) {
+  Nan::HandleScope scope;
+
+  // Prepare constructor template
+  v8::Local<v8::FunctionTemplate> tpl = Nan::New<v8::FunctionTemplate>(New);
+  tpl->SetClassName(Nan::New("Keyring").ToLocalChecked());
+  tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+  // Prototype
+  Nan::SetPrototypeMethod(tpl, "add", Add);
+  Nan::SetPrototypeMethod(tpl, "remove", Remove);
+  Nan::SetPrototypeMethod(tpl, "size", Size);
+  Nan::SetPrototypeMethod(tpl, "decrypt", Decrypt);
+  Nan::SetMethod(tpl, "keyId", KeyId);
+
+  constructor.Reset(tpl->GetFunction());
+  exports->Set(Nan::New("Keyring").ToLocalChecked(), tpl->GetFunction());
+  exports->Set(Nan::New("KEYED_OVERHEAD").ToLocalChecked(), Nan::New(ECIES_KEYED_OVERHEAD));
+}
+
+// Constructor
+void Keyring::New(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  if (args.IsConstructCall()) {
+    // Invoked as constructor: `new Keyring()`
+    Keyring* obj = new Keyring();
+    if (!obj->ring) {
+      delete obj;
+      return Nan::ThrowError("Out of memory");
+    }
+    obj->Wrap(args.This());
+    args.GetReturnValue().Set(args.This());
+  } else {
+    // Invoked as plain function `Keyring()`, turn into construct call.
+    v8::Local<v8::Function> cons = Nan::New<v8::Function>(constructor);
+    args.GetReturnValue().Set(cons->NewInstance(0, NULL));
+  }
+}
+
+static bool IsKeyBuffer(v8::Local<v8::Value> value) {
+  return node::Buffer::HasInstance(value) && node::Buffer::Length(value) == ECIES_KEY_SIZE;
+}
+
+// add(priv) returns false when the key is already there
+void Keyring::Add(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  Keyring* obj = ObjectWrap::Unwrap<Keyring>(args.Holder());
+
+  if (!IsKeyBuffer(args[0])) {
+    return Nan::ThrowTypeError("add(priv) expects a 21 byte key buffer");
+  }
+
+  ECIES_privkey_t privkey;
+
+  memcpy(privkey.k, node::Buffer::Data(args[0]), ECIES_KEY_SIZE);
+
+  int res = ECIES_keyring_add(obj->ring, &privkey);
+
+  memset(&privkey, 0, sizeof(privkey));
+
+  if (res == -2) {
+    return Nan::ThrowRangeError("Private key is not valid");
+  }
+  if (res < 0) {
+    return Nan::ThrowError("Out of memory");
+  }
+
+  args.GetReturnValue().Set(Nan::New(res > 0));
+}
+
+// remove(pubX, pubY) drops the private key of that public key
+void Keyring::Remove(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  Keyring* obj = ObjectWrap::Unwrap<Keyring>(args.Holder());
+
+  if (!IsKeyBuffer(args[0]) || !IsKeyBuffer(args[1])) {
+    return Nan::ThrowTypeError("remove(x, y) expects two 21 byte key buffers");
+  }
+
+  ECIES_pubkey_t pubkey;
+
+  memcpy(pubkey.x, node::Buffer::Data(args[0]), ECIES_KEY_SIZE);
+  memcpy(pubkey.y, node::Buffer::Data(args[1]), ECIES_KEY_SIZE);
+
+  args.GetReturnValue().Set(Nan::New(ECIES_keyring_remove(obj->ring, &pubkey) > 0));
+}
+
+void Keyring::Size(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  Keyring* obj = ObjectWrap::Unwrap<Keyring>(args.Holder());
+
+  args.GetReturnValue().Set(Nan::New((double)ECIES_keyring_count(obj->ring)));
+}
+
+// decrypt(buf) returns the message, false when no key opens it; the length
+// follows from the start sequence, plain, compact or keyed
+void Keyring::Decrypt(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  Keyring* obj = ObjectWrap::Unwrap<Keyring>(args.Holder());
+
+  if (!node::Buffer::HasInstance(args[0])) {
+    return Nan::ThrowTypeError("decrypt(buf) expects a buffer");
+  }
+
+  const ECIES_byte_t* msg = (const ECIES_byte_t*)node::Buffer::Data(args[0]);
+  size_t size = node::Buffer::Length(args[0]);
+  int start_size = size > 0 ? ECIES_start_size(msg) : -1;
+
+  if (start_size < 0 || size < (size_t)start_size + ECIES_CHUNK_OVERHEAD) {
+    Stats::Record(Stats::kKeyringDecrypt, -1, 0, Stats::Now());
+    args.GetReturnValue().Set(Nan::New(false));
+    return;
+  }
+
+  ECIES_size_t len = (ECIES_size_t)(size - start_size - ECIES_CHUNK_OVERHEAD);
+  char* raw = (char*)malloc(len > 0 ? len : 1);
+  uint64_t start = Stats::Now();
+
+  int res = ECIES_decrypt_keyring(raw, len, msg, obj->ring);
+
+  Stats::Record(Stats::kKeyringDecrypt, res, len, start);
+
+  if (res < 0) {
+    free(raw);
+    args.GetReturnValue().Set(Nan::New(false));
+    return;
+  }
+
+  // The buffer takes ownership of the message
+  args.GetReturnValue().Set(Nan::NewBuffer(raw, len).ToLocalChecked());
+}
+
+// Keyring.keyId(pubX, pubY), the 32-bit ID keyed messages to that key carry
+void Keyring::KeyId(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  if (!IsKeyBuffer(args[0]) || !IsKeyBuffer(args[1])) {
+    return Nan::ThrowTypeError("keyId(x, y) expects two 21 byte key buffers");
+  }
+
+  ECIES_pubkey_t pubkey;
+
+  memcpy(pubkey.x, node::Buffer::Data(args[0]), ECIES_KEY_SIZE);
+  memcpy(pubkey.y, node::Buffer::Data(args[1]), ECIES_KEY_SIZE);
+
+  args.GetReturnValue().Set(Nan::New(ECIES_key_id(&pubkey)));
+}
+
+}  // namespace node_ecies
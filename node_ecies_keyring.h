@@ -0,0 +1,35 @@
+// node_ecies_keyring.h
+#ifndef ECIESKEYRING_H
+#define ECIESKEYRING_H
+
+#include <nan.h>
+#include "keyring.h"
+
+namespace node_ecies {
+
+// Native side of the keyring API.
+// Holds many private keys hashed by their key ID; a message encrypted with
+// encrypt(buf, 'keyed') is decrypted with its own key after one lookup.
+class Keyring : public node::ObjectWrap {
+	public:
+		static void Init(v8::Local<v8::Object> exports);
+
+		ECIES_keyring_t* ring;
+
+	private:
+		explicit Keyring();
+		~Keyring();
+
+	static void New(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void Add(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void Remove(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void Size(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void Decrypt(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void KeyId(const Nan::FunctionCallbackInfo<v8::Value>& args);
+
+	static thread_local Nan::Persistent<v8::Function> constructor;
+};
+
+}  // namespace node_ecies
+
+#endif
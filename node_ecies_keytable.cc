@@ -0,0 +1,73 @@
+// node_ecies_keytable.cc
+#include <map>
+#include <mutex>
+#include <string>
+#include "node_ecies_keytable.h"
+
+namespace node_ecies {
+
+typedef std::map<std::string, std::weak_ptr<const PublicKeyEntry> > KeyMap;
+
+// Namespace scope, so nothing depends on thread-safe function statics
+static std::shared_ptr<const KeyMap> key_map = std::make_shared<const KeyMap>();
+static std::mutex key_map_writer;
+
+static std::string KeyId(const ECIES_pubkey_t& key) {
+  return std::string(reinterpret_cast<const char*>(&key), sizeof(key));
+}
+
+static std::shared_ptr<const PublicKeyEntry> Find(const KeyMap& map, const std::string& id) {
+  KeyMap::const_iterator it = map.find(id);
+  return it == map.end() ? std::shared_ptr<const PublicKeyEntry>() : it->second.lock();
+}
+
+std::shared_ptr<const PublicKeyEntry> KeyTable::Acquire(const ECIES_pubkey_t& key) {
+  std::string id = KeyId(key);
+  std::shared_ptr<const PublicKeyEntry> entry = Find(*std::atomic_load(&key_map), id);
+
+  if (entry) {
+    return entry;
+  }
+
+  // Build outside of the lock, the table takes a few point multiplications
+  // Not make_shared: the map keeps weak_ptrs, and a shared allocation would keep
+  // the whole table of an expired entry alive until the map is rebuilt
+  std::shared_ptr<PublicKeyEntry> fresh(new PublicKeyEntry);
+  fresh->key = key;
+  fresh->valid = ECIES_prepare_pubkey(&fresh->table, &key) > 0;
+
+  std::lock_guard<std::mutex> lock(key_map_writer);
+  std::shared_ptr<const KeyMap> current = std::atomic_load(&key_map);
+
+  // Another context may have won the race
+  if ((entry = Find(*current, id))) {
+    return entry;
+  }
+
+  std::shared_ptr<KeyMap> next = std::make_shared<KeyMap>();
+  for (KeyMap::const_iterator it = current->begin(); it != current->end(); ++it) {
+    if (!it->second.expired()) {
+      next->insert(*it);
+    }
+  }
+  (*next)[id] = fresh;
+
+  std::atomic_store(&key_map, std::shared_ptr<const KeyMap>(next));
+
+  return fresh;
+}
+
+size_t KeyTable::Size() {
+  std::shared_ptr<const KeyMap> map = std::atomic_load(&key_map);
+  size_t size = 0;
+
+  for (KeyMap::const_iterator it = map->begin(); it != map->end(); ++it) {
+    if (!it->second.expired()) {
+      size++;
+    }
+  }
+
+  return size;
+}
+
+}  // namespace node_ecies
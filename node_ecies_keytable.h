@@ -0,0 +1,30 @@
+// node_ecies_keytable.h
+#ifndef ECIESKEYTABLE_H
+#define ECIESKEYTABLE_H
+
+#include <memory>
+#include "ecc.h"
+
+namespace node_ecies {
+
+// Public key with its precomputation table, immutable once built
+struct PublicKeyEntry {
+	ECIES_pubkey_t key;
+	ECIES_pubkey_table_t table;
+	bool valid;
+};
+
+// Process-wide table of prepared public keys.
+// It is shared by every context (main thread and worker_threads), so a key is
+// prepared once no matter how many workers use it. Readers take a snapshot of
+// the map without locking; writers copy the map under a mutex and publish it.
+// Entries are reference counted and dropped when no wrapper holds them.
+class KeyTable {
+	public:
+		static std::shared_ptr<const PublicKeyEntry> Acquire(const ECIES_pubkey_t& key);
+		static size_t Size();
+};
+
+}  // namespace node_ecies
+
+#endif
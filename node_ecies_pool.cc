@@ -0,0 +1,68 @@
+// node_ecies_pool.cc
+#include <mutex>
+#include "node_ecies_pool.h"
+#include "pool.h"
+
+namespace node_ecies {
+
+// Shared by all addon instances and never freed: an encrypt on some worker
+// thread may still be inside ECIES_pool_take() when the pool gets disabled.
+static std::mutex pool_lock;
+static ECIES_pool_t* pool = NULL;
+
+// enableEphemeralPool(low, high) starts or resizes the pool
+void EphemeralPool::Enable(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  if (args.Length() < 2 || !args[0]->IsNumber() || !args[1]->IsNumber()) {
+    Nan::ThrowTypeError("Wrong arguments");
+    return;
+  }
+
+  int64_t low = args[0]->IntegerValue();
+  int64_t high = args[1]->IntegerValue();
+
+  if (low < 0 || high < 1 || low > high || high > 0x100000) {
+    Nan::ThrowRangeError("Watermarks out of range");
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(pool_lock);
+
+  if (!pool) {
+    pool = ECIES_pool_create((ECIES_size_t)low, (ECIES_size_t)high);
+  } else if (ECIES_pool_resize(pool, (ECIES_size_t)low, (ECIES_size_t)high) < 0) {
+    Nan::ThrowError("Out of memory");
+    return;
+  }
+
+  if (!pool) {
+    Nan::ThrowError("Failed to start pool");
+    return;
+  }
+
+  ECIES_set_ephemeral_source(ECIES_pool_take, pool);
+}
+
+// disableEphemeralPool() unplugs the pool and wipes its keys
+void EphemeralPool::Disable(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  std::lock_guard<std::mutex> lock(pool_lock);
+
+  if (pool) {
+    ECIES_set_ephemeral_source(NULL, NULL);
+    ECIES_pool_resize(pool, 0, 0);
+  }
+}
+
+// ephemeralPoolSize() returns the number of ready keys
+void EphemeralPool::Size(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  std::lock_guard<std::mutex> lock(pool_lock);
+
+  args.GetReturnValue().Set(Nan::New<v8::Number>(pool ? (double)ECIES_pool_size(pool) : 0));
+}
+
+void EphemeralPool::Init(v8::Local<v8::Object> exports) {
+  Nan::SetMethod(exports, "enableEphemeralPool", Enable);
+  Nan::SetMethod(exports, "disableEphemeralPool", Disable);
+  Nan::SetMethod(exports, "ephemeralPoolSize", Size);
+}
+
+}  // namespace node_ecies
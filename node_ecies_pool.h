@@ -0,0 +1,24 @@
+// node_ecies_pool.h
+#ifndef ECIESPOOL_H
+#define ECIESPOOL_H
+
+#include <nan.h>
+
+namespace node_ecies {
+
+// Process-wide ephemeral key pool (see pool.h), off by default.
+// Once enabled every encrypt, of every thread, takes its (k, R) from the pool
+// and falls back to generating it when the pool runs dry.
+class EphemeralPool {
+	public:
+		static void Init(v8::Local<v8::Object> exports);
+
+	private:
+		static void Enable(const Nan::FunctionCallbackInfo<v8::Value>& args);
+		static void Disable(const Nan::FunctionCallbackInfo<v8::Value>& args);
+		static void Size(const Nan::FunctionCallbackInfo<v8::Value>& args);
+};
+
+}  // namespace node_ecies
+
+#endif
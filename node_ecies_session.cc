@@ -0,0 +1,181 @@
+// node_ecies_session.cc
+#include <stdlib.h>
+#include <string.h>
+#include "node_ecies_session.h"
+#include "node_ecies_stats.h"
+
+namespace node_ecies {
+
+thread_local Nan::Persistent<v8::Function> ECIESSession::constructor;
+
+ECIESSession::ECIESSession() : started(false) {
+  memset(&session, 0, sizeof(session));
+}
+
+ECIESSession::~ECIESSession() {
+  ECIES_session_end(&session);
+}
+
+// Object initiator
+void ECIESSession::Init(v8::Local<v8::Object> exports) {
+  Nan::HandleScope scope;
+
+  // Prepare constructor template
+  v8::Local<v8::FunctionTemplate> tpl = Nan::New<v8::FunctionTemplate>(New);
+  tpl->SetClassName(Nan::New("ECIESSession").ToLocalChecked());
+  tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+  // Prototype
+  Nan::SetPrototypeMethod(tpl, "start", Start);
+  Nan::SetPrototypeMethod(tpl, "accept", Accept);
+  Nan::SetPrototypeMethod(tpl, "seal", Seal);
+  Nan::SetPrototypeMethod(tpl, "open", Open);
+  Nan::SetPrototypeMethod(tpl, "end", End);
+
+  constructor.Reset(tpl->GetFunction());
+  exports->Set(Nan::New("ECIESSession").ToLocalChecked(), tpl->GetFunction());
+  exports->Set(Nan::New("SESSION_START_OVERHEAD").ToLocalChecked(), Nan::New(ECIES_SESSION_START_OVERHEAD));
+  exports->Set(Nan::New("SESSION_OVERHEAD").ToLocalChecked(), Nan::New(ECIES_SESSION_OVERHEAD));
+}
+
+// Constructor
+void ECIESSession::New(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  if (args.IsConstructCall()) {
+    // Invoked as constructor: `new ECIESSession()`
+    ECIESSession* obj = new ECIESSession();
+    obj->Wrap(args.This());
+    args.GetReturnValue().Set(args.This());
+  } else {
+    // Invoked as plain function `ECIESSession()`, turn into construct call.
+    v8::Local<v8::Function> cons = Nan::New<v8::Function>(constructor);
+    args.GetReturnValue().Set(cons->NewInstance(0, NULL));
+  }
+}
+
+static bool IsKeyBuffer(v8::Local<v8::Value> value) {
+  return node::Buffer::HasInstance(value) && node::Buffer::Length(value) == ECIES_KEY_SIZE;
+}
+
+// Initiator: start(pubX, pubY) returns the handshake for the peer
+void ECIESSession::Start(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIESSession* obj = ObjectWrap::Unwrap<ECIESSession>(args.Holder());
+
+  if (!IsKeyBuffer(args[0]) || !IsKeyBuffer(args[1])) {
+    return Nan::ThrowTypeError("start(x, y) expects two 21 byte key buffers");
+  }
+
+  ECIES_pubkey_t pubkey;
+  ECIES_byte_t handshake[ECIES_SESSION_START_OVERHEAD];
+  uint64_t start = Stats::Now();
+
+  memcpy(pubkey.x, node::Buffer::Data(args[0]), ECIES_KEY_SIZE);
+  memcpy(pubkey.y, node::Buffer::Data(args[1]), ECIES_KEY_SIZE);
+
+  ECIES_session_start(&obj->session, handshake, &pubkey);
+  obj->started = true;
+
+  Stats::Record(Stats::kSessionStart, 1, ECIES_SESSION_START_OVERHEAD, start);
+
+  args.GetReturnValue().Set(Nan::CopyBuffer((char*)handshake, ECIES_SESSION_START_OVERHEAD).ToLocalChecked());
+}
+
+// Responder: accept(handshake, priv) returns false when the handshake is not valid
+void ECIESSession::Accept(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIESSession* obj = ObjectWrap::Unwrap<ECIESSession>(args.Holder());
+
+  if (!node::Buffer::HasInstance(args[0]) || node::Buffer::Length(args[0]) != ECIES_SESSION_START_OVERHEAD ||
+      !IsKeyBuffer(args[1])) {
+    return Nan::ThrowTypeError("accept(handshake, priv) expects a session handshake and a 21 byte key buffer");
+  }
+
+  ECIES_privkey_t privkey;
+  uint64_t start = Stats::Now();
+
+  memcpy(privkey.k, node::Buffer::Data(args[1]), ECIES_KEY_SIZE);
+
+  int res = ECIES_session_accept(&obj->session, (const ECIES_byte_t*)node::Buffer::Data(args[0]), &privkey);
+  obj->started = res > 0;
+
+  memset(&privkey, 0, sizeof(privkey));
+
+  Stats::Record(Stats::kSessionStart, res, ECIES_SESSION_START_OVERHEAD, start);
+
+  args.GetReturnValue().Set(Nan::New(res > 0));
+}
+
+// seal(buf) returns the frame, `buf.length + SESSION_OVERHEAD` bytes
+void ECIESSession::Seal(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIESSession* obj = ObjectWrap::Unwrap<ECIESSession>(args.Holder());
+
+  if (!node::Buffer::HasInstance(args[0])) {
+    return Nan::ThrowTypeError("seal(buf) expects a buffer");
+  }
+
+  if (!obj->started) {
+    return Nan::ThrowError("ECIES session is not started");
+  }
+
+  ECIES_size_t len = (ECIES_size_t)node::Buffer::Length(args[0]);
+  size_t size = len + ECIES_SESSION_OVERHEAD;
+  ECIES_byte_t* frame = (ECIES_byte_t*)malloc(size);
+  uint64_t start = Stats::Now();
+
+  int res = ECIES_session_seal(&obj->session, frame, node::Buffer::Data(args[0]), len);
+
+  Stats::Record(Stats::kSessionSeal, res, len, start);
+
+  if (res < 0) {
+    free(frame);
+    return Nan::ThrowError("ECIES session sequence numbers are used up, start a new session");
+  }
+
+  // The buffer takes ownership of the frame
+  args.GetReturnValue().Set(Nan::NewBuffer((char*)frame, size).ToLocalChecked());
+}
+
+// open(frame) returns the message, false when it is forged, replayed or too old
+void ECIESSession::Open(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIESSession* obj = ObjectWrap::Unwrap<ECIESSession>(args.Holder());
+
+  if (!node::Buffer::HasInstance(args[0])) {
+    return Nan::ThrowTypeError("open(frame) expects a buffer");
+  }
+
+  if (!obj->started) {
+    return Nan::ThrowError("ECIES session is not started");
+  }
+
+  size_t size = node::Buffer::Length(args[0]);
+
+  if (size < ECIES_SESSION_OVERHEAD) {
+    Stats::Record(Stats::kSessionOpen, -3, 0, Stats::Now());
+    args.GetReturnValue().Set(Nan::New(false));
+    return;
+  }
+
+  ECIES_size_t len = (ECIES_size_t)(size - ECIES_SESSION_OVERHEAD);
+  char* raw = (char*)malloc(len > 0 ? len : 1);
+  uint64_t start = Stats::Now();
+
+  int res = ECIES_session_open(&obj->session, raw, (const ECIES_byte_t*)node::Buffer::Data(args[0]), len);
+
+  Stats::Record(Stats::kSessionOpen, res, len, start);
+
+  if (res < 0) {
+    free(raw);
+    args.GetReturnValue().Set(Nan::New(false));
+    return;
+  }
+
+  args.GetReturnValue().Set(Nan::NewBuffer(raw, len).ToLocalChecked());
+}
+
+// end() wipes the session keys, the object may start or accept again
+void ECIESSession::End(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIESSession* obj = ObjectWrap::Unwrap<ECIESSession>(args.Holder());
+
+  ECIES_session_end(&obj->session);
+  obj->started = false;
+}
+
+}  // namespace node_ecies
@@ -0,0 +1,36 @@
+// node_ecies_session.h
+#ifndef ECIESSESSION_H
+#define ECIESSESSION_H
+
+#include <nan.h>
+#include "ecc.h"
+
+namespace node_ecies {
+
+// Native side of the session API.
+// Holds one ECIES_session_t; the handshake pays the only scalar multiplication,
+// every frame after it is sealed and opened synchronously with XTEA alone.
+class ECIESSession : public node::ObjectWrap {
+	public:
+		static void Init(v8::Local<v8::Object> exports);
+
+		ECIES_session_t session;
+		bool started;
+
+	private:
+		explicit ECIESSession();
+		~ECIESSession();
+
+	static void New(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void Start(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void Accept(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void Seal(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void Open(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void End(const Nan::FunctionCallbackInfo<v8::Value>& args);
+
+	static thread_local Nan::Persistent<v8::Function> constructor;
+};
+
+}  // namespace node_ecies
+
+#endif
@@ -0,0 +1,305 @@
+// node_ecies_stats.cc
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "node_ecies_stats.h"
+#include "ecc.h"
+
+namespace node_ecies {
+
+// HDR-style log-linear histogram of nanoseconds: values below 2^kSubBits
+// have own buckets, above that every power of two is cut into 2^kSubBits
+// buckets, i.e. 12.5% precision up to 2^kMaxBits ns (~18 minutes).
+static const int kSubBits = 3;
+static const int kMaxBits = 40;
+static const int kBuckets = (kMaxBits - kSubBits + 2) << kSubBits;
+
+// Payload size classes of the histograms
+static const int kSizeClasses = 4;
+static const char* const kSizeClassNames[kSizeClasses] = { "0-63", "64-1023", "1024-65535", "65536+" };
+
+// Result classes of the counters
+enum { kOk, kInvalidPoint, kMacFailure, kOtherError, kResults };
+static const char* const kResultNames[kResults] = { "ok", "invalidPoint", "macFailure", "otherError" };
+
+static const char* const kOpNames[Stats::kOpCount] = {
+  "generateKeys", "generateKeyPairs", "encrypt", "decrypt", "encryptMulti", "encryptPacked", "decryptPacked",
+  "streamStart", "streamEncrypt", "streamDecrypt", "sessionStart", "sessionSeal", "sessionOpen",
+  "keyringDecrypt"
+};
+
+typedef std::atomic<uint64_t> Counter;
+
+struct ThreadStats {
+  Counter results[Stats::kOpCount][kResults];
+  Counter bytes[Stats::kOpCount];
+  Counter latency[Stats::kOpCount][kSizeClasses][kBuckets];
+
+  ThreadStats() {
+    Clear();
+  }
+
+  void Clear() {
+    Counter* c = &results[0][0];
+    Counter* e = reinterpret_cast<Counter*>(this + 1);
+    for (; c < e; c++) {
+      c->store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void AddTo(ThreadStats* sum) const {
+    const Counter* c = &results[0][0];
+    const Counter* e = reinterpret_cast<const Counter*>(this + 1);
+    Counter* s = &sum->results[0][0];
+    for (; c < e; c++, s++) {
+      s->fetch_add(c->load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+  }
+};
+
+// All live thread blocks, plus the sum of the blocks of exited threads
+static std::mutex registry_lock;
+static std::vector<ThreadStats*> registry;
+static ThreadStats retired;
+
+struct ThreadStatsHolder {
+  ThreadStats* stats;
+
+  ThreadStatsHolder() : stats(new ThreadStats()) {
+    std::lock_guard<std::mutex> lock(registry_lock);
+    registry.push_back(stats);
+  }
+
+  ~ThreadStatsHolder() {
+    std::lock_guard<std::mutex> lock(registry_lock);
+    stats->AddTo(&retired);
+    for (size_t i = 0; i < registry.size(); i++) {
+      if (registry[i] == stats) {
+        registry[i] = registry.back();
+        registry.pop_back();
+        break;
+      }
+    }
+    delete stats;
+  }
+};
+
+static thread_local ThreadStatsHolder local_stats;
+
+static int ResultClass(int result) {
+  return result >= 0 ? kOk : result == -1 ? kInvalidPoint : result == -2 ? kMacFailure : kOtherError;
+}
+
+static int SizeClass(size_t bytes) {
+  return bytes < 64 ? 0 : bytes < 1024 ? 1 : bytes < 65536 ? 2 : 3;
+}
+
+static int Bucket(uint64_t ns) {
+  if (ns < (1u << kSubBits)) {
+    return (int)ns;
+  }
+
+  int msb = 63 - __builtin_clzll(ns);
+
+  if (msb > kMaxBits) {
+    return kBuckets - 1;
+  }
+
+  return ((msb - kSubBits + 1) << kSubBits) + (int)((ns >> (msb - kSubBits)) & ((1u << kSubBits) - 1));
+}
+
+// The highest value which falls into the bucket
+static uint64_t BucketLimit(int bucket) {
+  if (bucket < (1 << kSubBits)) {
+    return bucket;
+  }
+
+  int shift = (bucket >> kSubBits) - 1;
+  uint64_t sub = (1u << kSubBits) + (bucket & ((1 << kSubBits) - 1));
+
+  return ((sub + 1) << shift) - 1;
+}
+
+uint64_t Stats::Now() {
+  return uv_hrtime();
+}
+
+void Stats::Record(Op op, int result, size_t bytes, uint64_t start) {
+  ThreadStats* stats = local_stats.stats;
+  uint64_t ns = uv_hrtime() - start;
+
+  stats->results[op][ResultClass(result)].fetch_add(1, std::memory_order_relaxed);
+  stats->bytes[op].fetch_add(bytes, std::memory_order_relaxed);
+  stats->latency[op][SizeClass(bytes)][Bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void Stats::Count(Op op, int result) {
+  local_stats.stats->results[op][ResultClass(result)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void Stats::Time(Op op, size_t bytes, uint64_t start) {
+  ThreadStats* stats = local_stats.stats;
+  uint64_t ns = uv_hrtime() - start;
+
+  stats->bytes[op].fetch_add(bytes, std::memory_order_relaxed);
+  stats->latency[op][SizeClass(bytes)][Bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+}
+
+static v8::Local<v8::Object> Histogram(const Counter* buckets, uint64_t count) {
+  static const double kQuantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+  static const char* const kQuantileNames[] = { "p50", "p90", "p99", "p999" };
+
+  v8::Local<v8::Object> result = Nan::New<v8::Object>();
+  v8::Local<v8::Array> pairs = Nan::New<v8::Array>();
+  uint64_t seen = 0, n;
+  uint32_t q = 0, pos = 0;
+  int max = 0;
+
+  result->Set(Nan::New("count").ToLocalChecked(), Nan::New<v8::Number>((double)count));
+
+  for (int i = 0; i < kBuckets; i++) {
+    if (!(n = buckets[i].load(std::memory_order_relaxed))) {
+      continue;
+    }
+    seen += n;
+    max = i;
+    for (; q < 4 && (double)seen >= kQuantiles[q] * count; q++) {
+      result->Set(Nan::New(kQuantileNames[q]).ToLocalChecked(), Nan::New<v8::Number>((double)BucketLimit(i)));
+    }
+
+    // [upper bound in ns, count] of every non-empty bucket
+    v8::Local<v8::Array> pair = Nan::New<v8::Array>(2);
+    pair->Set(0, Nan::New<v8::Number>((double)BucketLimit(i)));
+    pair->Set(1, Nan::New<v8::Number>((double)n));
+    pairs->Set(pos++, pair);
+  }
+
+  result->Set(Nan::New("max").ToLocalChecked(), Nan::New<v8::Number>((double)BucketLimit(max)));
+  result->Set(Nan::New("buckets").ToLocalChecked(), pairs);
+
+  return result;
+}
+
+// getStats() returns { op: { ok, invalidPoint, macFailure, otherError, bytes, latency: { sizeClass: histogram } } }
+// with latencies in nanoseconds
+void Stats::GetStats(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ThreadStats* sum = new ThreadStats();
+
+  {
+    std::lock_guard<std::mutex> lock(registry_lock);
+    retired.AddTo(sum);
+    for (size_t i = 0; i < registry.size(); i++) {
+      registry[i]->AddTo(sum);
+    }
+  }
+
+  v8::Local<v8::Object> result = Nan::New<v8::Object>();
+
+  for (int op = 0; op < kOpCount; op++) {
+    v8::Local<v8::Object> stats = Nan::New<v8::Object>();
+    v8::Local<v8::Object> latency = Nan::New<v8::Object>();
+
+    for (int r = 0; r < kResults; r++) {
+      stats->Set(Nan::New(kResultNames[r]).ToLocalChecked(),
+                 Nan::New<v8::Number>((double)sum->results[op][r].load(std::memory_order_relaxed)));
+    }
+    stats->Set(Nan::New("bytes").ToLocalChecked(), Nan::New<v8::Number>((double)sum->bytes[op].load(std::memory_order_relaxed)));
+
+    for (int c = 0; c < kSizeClasses; c++) {
+      uint64_t count = 0;
+      for (int i = 0; i < kBuckets; i++) {
+        count += sum->latency[op][c][i].load(std::memory_order_relaxed);
+      }
+      if (count) {
+        latency->Set(Nan::New(kSizeClassNames[c]).ToLocalChecked(), Histogram(sum->latency[op][c], count));
+      }
+    }
+    stats->Set(Nan::New("latency").ToLocalChecked(), latency);
+
+    result->Set(Nan::New(kOpNames[op]).ToLocalChecked(), stats);
+  }
+
+  delete sum;
+
+  args.GetReturnValue().Set(result);
+}
+
+// resetStats() zeroes every counter; records racing with it may survive
+void Stats::ResetStats(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  std::lock_guard<std::mutex> lock(registry_lock);
+  retired.Clear();
+  for (size_t i = 0; i < registry.size(); i++) {
+    registry[i]->Clear();
+  }
+}
+
+static const char* const kPhaseNames[ECIES_PHASES] = { "pointMult", "fieldInvert", "kdf", "cbcmac", "ctrCrypt" };
+static const char* const kFieldOpNames[ECIES_FIELD_OPS] = { "mult", "square", "invert" };
+
+static v8::Local<v8::Object> FieldOps(const uint64_t* ops) {
+  v8::Local<v8::Object> result = Nan::New<v8::Object>();
+  for (int i = 0; i < ECIES_FIELD_OPS; i++) {
+    result->Set(Nan::New(kFieldOpNames[i]).ToLocalChecked(), Nan::New<v8::Number>((double)ops[i]));
+  }
+  return result;
+}
+
+// getProfile() returns the ecc.c phase profile, or null unless built with ECIES_PROFILING:
+// { clock, phases: { phase: { calls, ticks } }, field: { mult, square, invert }, fieldInMult: { ... } }
+void Stats::GetProfile(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIES_profile_t prof;
+
+  if (!ECIES_profile_get(&prof)) {
+    args.GetReturnValue().Set(Nan::Null());
+    return;
+  }
+
+  v8::Local<v8::Object> result = Nan::New<v8::Object>();
+  v8::Local<v8::Object> phases = Nan::New<v8::Object>();
+
+  for (int i = 0; i < ECIES_PHASES; i++) {
+    v8::Local<v8::Object> phase = Nan::New<v8::Object>();
+    phase->Set(Nan::New("calls").ToLocalChecked(), Nan::New<v8::Number>((double)prof.calls[i]));
+    phase->Set(Nan::New("ticks").ToLocalChecked(), Nan::New<v8::Number>((double)prof.ticks[i]));
+    phases->Set(Nan::New(kPhaseNames[i]).ToLocalChecked(), phase);
+  }
+
+  result->Set(Nan::New("clock").ToLocalChecked(), Nan::New(ECIES_profile_clock()).ToLocalChecked());
+  result->Set(Nan::New("phases").ToLocalChecked(), phases);
+  result->Set(Nan::New("field").ToLocalChecked(), FieldOps(prof.field));
+  result->Set(Nan::New("fieldInMult").ToLocalChecked(), FieldOps(prof.field_in_mult));
+
+  args.GetReturnValue().Set(result);
+}
+
+void Stats::ResetProfile(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIES_profile_reset();
+}
+
+// getConfig() returns the sizes ecc.c was built with:
+// { profile, combWidth, tableSize, rngBuffer, keygenBatch, lanes }
+void Stats::GetConfig(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIES_config_t cfg;
+
+  ECIES_config_get(&cfg);
+
+  v8::Local<v8::Object> result = Nan::New<v8::Object>();
+  result->Set(Nan::New("profile").ToLocalChecked(), Nan::New(cfg.profile).ToLocalChecked());
+  result->Set(Nan::New("combWidth").ToLocalChecked(), Nan::New(cfg.comb_width));
+  result->Set(Nan::New("tableSize").ToLocalChecked(), Nan::New(cfg.table_size));
+  result->Set(Nan::New("rngBuffer").ToLocalChecked(), Nan::New(cfg.rng_buffer));
+  result->Set(Nan::New("keygenBatch").ToLocalChecked(), Nan::New(cfg.keygen_batch));
+  result->Set(Nan::New("lanes").ToLocalChecked(), Nan::New(cfg.lanes));
+
+  args.GetReturnValue().Set(result);
+}
+
+void Stats::Init(v8::Local<v8::Object> exports) {
+  Nan::SetMethod(exports, "getStats", GetStats);
+  Nan::SetMethod(exports, "resetStats", ResetStats);
+  Nan::SetMethod(exports, "getProfile", GetProfile);
+  Nan::SetMethod(exports, "resetProfile", ResetProfile);
+  Nan::SetMethod(exports, "getConfig", GetConfig);
+}
+
+}  // namespace node_ecies
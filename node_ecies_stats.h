@@ -0,0 +1,59 @@
+// node_ecies_stats.h
+#ifndef ECIESSTATS_H
+#define ECIESSTATS_H
+
+#include <nan.h>
+#include <stdint.h>
+
+namespace node_ecies {
+
+// Operation counters and latency histograms of the addon.
+// Every thread records into its own block with relaxed atomics, so recording
+// never contends; getStats() sums the blocks of all live and exited threads.
+class Stats {
+	public:
+		enum Op {
+			kGenerateKeys,
+			kGenerateKeyPairs,
+			kEncrypt,
+			kDecrypt,
+			kEncryptMulti,
+			kEncryptPacked,
+			kDecryptPacked,
+			kStreamStart,
+			kStreamEncrypt,
+			kStreamDecrypt,
+			kSessionStart,
+			kSessionSeal,
+			kSessionOpen,
+			kKeyringDecrypt,
+			kOpCount
+		};
+
+		static void Init(v8::Local<v8::Object> exports);
+
+		// Start time for Record()
+		static uint64_t Now();
+
+		// One call: result is the ECIES result code (1 ok, -1 invalid point, -2 MAC failure),
+		// bytes is the payload size used to pick the histogram
+		static void Record(Op op, int result, size_t bytes, uint64_t start);
+
+		// One more result without a latency sample, e.g. each message of a packed container
+		static void Count(Op op, int result);
+
+		// A latency sample and bytes without a result, e.g. the whole packed container
+		// whose messages were counted one by one
+		static void Time(Op op, size_t bytes, uint64_t start);
+
+	private:
+		static void GetStats(const Nan::FunctionCallbackInfo<v8::Value>& args);
+		static void ResetStats(const Nan::FunctionCallbackInfo<v8::Value>& args);
+		static void GetProfile(const Nan::FunctionCallbackInfo<v8::Value>& args);
+		static void ResetProfile(const Nan::FunctionCallbackInfo<v8::Value>& args);
+		static void GetConfig(const Nan::FunctionCallbackInfo<v8::Value>& args);
+};
+
+}  // namespace node_ecies
+
+#endif
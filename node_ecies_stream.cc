@@ -0,0 +1,364 @@
+// node_ecies_stream.cc
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "node_ecies_stream.h"
+#include "node_ecies_stats.h"
+
+namespace node_ecies {
+
+thread_local Nan::Persistent<v8::Function> ECIESStream::constructor;
+
+ECIESStream::ECIESStream() : started(false), indexed(false), index(0), length(0) {
+  memset(&stream, 0, sizeof(stream));
+}
+
+ECIESStream::~ECIESStream() {
+  memset(&stream, 0, sizeof(stream));
+}
+
+static v8::Local<v8::Value> StreamError(const char* message, int code) {
+  v8::Local<v8::Value> err = Nan::Error(message);
+  err.As<v8::Object>()->Set(Nan::New("code").ToLocalChecked(), Nan::New(code));
+  return err;
+}
+
+// The size of the stream header starting with `head`, the indexed tag included,
+// < 0 when it is no stream header this API reads; needs the first 4 bytes
+static long HeaderSize(const ECIES_byte_t* head) {
+  long tag = head[0] == ECIES_INDEXED_TAG, n;
+
+  if ((n = ECIES_multi_count(head + tag)) > 0) {
+    return tag + ECIES_MULTI_START_OVERHEAD(n);
+  }
+
+  n = ECIES_start_size(head + tag);
+
+  return n < 0 ? n : tag + n;
+}
+
+// Key agreement for both directions: ECIES_encrypt_start or ECIES_decrypt_start(_multi)
+class StreamStartWorker : public Nan::AsyncWorker {
+  public:
+    StreamStartWorker(Nan::Callback* callback, ECIESStream* stm, v8::Local<v8::Object> self)
+      : Nan::AsyncWorker(callback), stm_(stm), decrypt_(false), res_(1), header_(1 + ECIES_START_OVERHEAD) {
+      SaveToPersistent("self", self);
+    }
+
+    void SetPublicKey(const char* x, const char* y) {
+      memcpy(pubkey_.x, x, ECIES_KEY_SIZE);
+      memcpy(pubkey_.y, y, ECIES_KEY_SIZE);
+    }
+
+    // The whole header, see HeaderSize()
+    void SetPrivateKey(const char* k, const char* header, size_t len) {
+      decrypt_ = true;
+      memcpy(privkey_.k, k, ECIES_KEY_SIZE);
+      header_.assign(header, header + len);
+    }
+
+    ~StreamStartWorker() {
+      memset(&privkey_, 0, sizeof(privkey_));
+    }
+
+    void Execute() {
+      uint64_t start = Stats::Now();
+
+      if (decrypt_) {
+        const ECIES_byte_t* seq = &header_[header_[0] == ECIES_INDEXED_TAG];
+        res_ = ECIES_multi_count(seq) > 0 ? ECIES_decrypt_start_multi(&stm_->stream, seq, &privkey_)
+                                          : ECIES_decrypt_start(&stm_->stream, seq, &privkey_);
+      } else {
+        header_[0] = ECIES_INDEXED_TAG;
+        ECIES_encrypt_start(&stm_->stream, &header_[1], &pubkey_);
+      }
+
+      Stats::Record(Stats::kStreamStart, res_, header_.size(), start);
+    }
+
+    void HandleOKCallback() {
+      Nan::HandleScope scope;
+
+      if (res_ < 0) {
+        v8::Local<v8::Value> argv[] = { StreamError("ECIES stream start failed", res_) };
+        callback->Call(1, argv);
+        return;
+      }
+
+      stm_->started = true;
+      stm_->indexed = header_[0] == ECIES_INDEXED_TAG;
+
+      v8::Local<v8::Value> argv[] = {
+        Nan::Null(),
+        decrypt_ ? v8::Local<v8::Value>(Nan::Undefined())
+                 : v8::Local<v8::Value>(Nan::CopyBuffer((char*)&header_[0], header_.size()).ToLocalChecked())
+      };
+      callback->Call(2, argv);
+    }
+
+  private:
+    ECIESStream* stm_;
+    bool decrypt_;
+    int res_;
+    ECIES_pubkey_t pubkey_;
+    ECIES_privkey_t privkey_;
+    std::vector<ECIES_byte_t> header_;
+};
+
+// One batch of chunks: the input is cut into `chunk_size` pieces (the last one may be shorter)
+// and every piece is encrypted or decrypted with the per-chunk MAC, exactly as tool.c does.
+// Chunks of an indexed stream are numbered from `first`, the others all use nonce 0.
+class StreamChunkWorker : public Nan::AsyncWorker {
+  public:
+    StreamChunkWorker(Nan::Callback* callback, ECIESStream* stm, v8::Local<v8::Object> self,
+                      v8::Local<v8::Object> input, size_t chunk_size, bool decrypt, ECIES_size_t first)
+      : Nan::AsyncWorker(callback), stm_(stm), decrypt_(decrypt), res_(1),
+        in_((const ECIES_byte_t*)node::Buffer::Data(input)), in_len_(node::Buffer::Length(input)),
+        chunk_size_(chunk_size), first_(first), out_(NULL), out_len_(0) {
+      SaveToPersistent("self", self);
+      SaveToPersistent("input", input);
+    }
+
+    ~StreamChunkWorker() {
+      free(out_);
+    }
+
+    void Execute() {
+      uint64_t start = Stats::Now();
+
+      Run();
+      Stats::Record(decrypt_ ? Stats::kStreamDecrypt : Stats::kStreamEncrypt, res_, in_len_, start);
+    }
+
+    void Run() {
+      ECIES_size_t index = first_;
+      size_t pieces, plen, r = 0, w = 0;
+
+      if (decrypt_) {
+        // Decrypt in place in a copy of the input, then close up the MAC gaps
+        if (!(out_ = (ECIES_byte_t*)malloc(in_len_ > 0 ? in_len_ : 1))) {
+          res_ = -1;
+          return;
+        }
+        memcpy(out_, in_, in_len_);
+
+        for (; r < in_len_; index++) {
+          plen = in_len_ - r < chunk_size_ + ECIES_CHUNK_OVERHEAD ? in_len_ - r : chunk_size_ + ECIES_CHUNK_OVERHEAD;
+          if (plen < ECIES_CHUNK_OVERHEAD) {
+            res_ = -3;
+            return;
+          }
+          plen -= ECIES_CHUNK_OVERHEAD;
+          memmove(out_ + w, out_ + r, plen + ECIES_CHUNK_OVERHEAD);
+          res_ = stm_->indexed ? ECIES_decrypt_chunk_at(&stm_->stream, index, out_ + w, plen)
+                               : ECIES_decrypt_chunk(&stm_->stream, out_ + w, plen);
+          if (res_ < 0) {
+            res_ = -2;
+            return;
+          }
+          r += plen + ECIES_CHUNK_OVERHEAD;
+          w += plen;
+        }
+      } else {
+        pieces = (in_len_ + chunk_size_ - 1) / chunk_size_;
+        if (!(out_ = (ECIES_byte_t*)malloc(in_len_ + pieces * ECIES_CHUNK_OVERHEAD + 1))) {
+          res_ = -1;
+          return;
+        }
+
+        for (; r < in_len_; index++) {
+          plen = in_len_ - r < chunk_size_ ? in_len_ - r : chunk_size_;
+          memcpy(out_ + w, in_ + r, plen);
+          ECIES_encrypt_chunk_at(&stm_->stream, index, out_ + w, plen);
+          r += plen;
+          w += plen + ECIES_CHUNK_OVERHEAD;
+        }
+      }
+
+      out_len_ = w;
+    }
+
+    void HandleOKCallback() {
+      Nan::HandleScope scope;
+
+      if (res_ < 0) {
+        v8::Local<v8::Value> argv[] = { StreamError(res_ == -3 ? "Truncated ECIES chunk" :
+                                                    res_ == -1 ? "Out of memory" : "ECIES chunk authentication failed", res_) };
+        callback->Call(1, argv);
+        return;
+      }
+
+      // The buffer takes ownership of the output memory
+      v8::Local<v8::Value> argv[] = { Nan::Null(), Nan::NewBuffer((char*)out_, out_len_).ToLocalChecked() };
+      out_ = NULL;
+      callback->Call(2, argv);
+    }
+
+  private:
+    ECIESStream* stm_;
+    bool decrypt_;
+    int res_;
+    const ECIES_byte_t* in_;
+    size_t in_len_;
+    size_t chunk_size_;
+    ECIES_size_t first_;
+    ECIES_byte_t* out_;
+    size_t out_len_;
+};
+
+// Object initiator
+void ECIESStream::Init(v8::Local<v8::Object> exports) {
+  Nan::HandleScope scope;
+
+  // Prepare constructor template
+  v8::Local<v8::FunctionTemplate> tpl = Nan::New<v8::FunctionTemplate>(New);
+  tpl->SetClassName(Nan::New("ECIESStream").ToLocalChecked());
+  tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+  // Prototype
+  Nan::SetPrototypeMethod(tpl, "encryptStart", EncryptStart);
+  Nan::SetPrototypeMethod(tpl, "decryptStart", DecryptStart);
+  Nan::SetPrototypeMethod(tpl, "encrypt", Encrypt);
+  Nan::SetPrototypeMethod(tpl, "decrypt", Decrypt);
+  Nan::SetPrototypeMethod(tpl, "encryptEnd", EncryptEnd);
+  Nan::SetPrototypeMethod(tpl, "decryptEnd", DecryptEnd);
+
+  constructor.Reset(tpl->GetFunction());
+  exports->Set(Nan::New("ECIESStream").ToLocalChecked(), tpl->GetFunction());
+  Nan::SetMethod(exports, "streamHeaderSize", StartSize);
+  exports->Set(Nan::New("START_OVERHEAD").ToLocalChecked(), Nan::New(ECIES_START_OVERHEAD));
+  exports->Set(Nan::New("CHUNK_OVERHEAD").ToLocalChecked(), Nan::New(ECIES_CHUNK_OVERHEAD));
+  exports->Set(Nan::New("INDEX_SIZE").ToLocalChecked(), Nan::New(ECIES_INDEX_SIZE));
+  exports->Set(Nan::New("INDEXED_TAG").ToLocalChecked(), Nan::New(ECIES_INDEXED_TAG));
+}
+
+// Constructor
+void ECIESStream::New(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  if (args.IsConstructCall()) {
+    // Invoked as constructor: `new ECIESStream()`
+    ECIESStream* obj = new ECIESStream();
+    obj->Wrap(args.This());
+    args.GetReturnValue().Set(args.This());
+  } else {
+    // Invoked as plain function `ECIESStream()`, turn into construct call.
+    v8::Local<v8::Function> cons = Nan::New<v8::Function>(constructor);
+    args.GetReturnValue().Set(cons->NewInstance(0, NULL));
+  }
+}
+
+static bool IsKeyBuffer(v8::Local<v8::Value> value) {
+  return node::Buffer::HasInstance(value) && node::Buffer::Length(value) == ECIES_KEY_SIZE;
+}
+
+// Start encryption: encryptStart(pubX, pubY, callback(err, header))
+void ECIESStream::EncryptStart(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIESStream* obj = ObjectWrap::Unwrap<ECIESStream>(args.Holder());
+
+  if (!IsKeyBuffer(args[0]) || !IsKeyBuffer(args[1]) || !args[2]->IsFunction()) {
+    return Nan::ThrowTypeError("encryptStart(x, y, callback) expects two 21 byte key buffers");
+  }
+
+  StreamStartWorker* worker = new StreamStartWorker(new Nan::Callback(args[2].As<v8::Function>()), obj, args.Holder());
+  worker->SetPublicKey(node::Buffer::Data(args[0]), node::Buffer::Data(args[1]));
+  Nan::AsyncQueueWorker(worker);
+}
+
+// The size of a stream header: streamHeaderSize(head), head holds its first 4 bytes;
+// -1 when it is not one of a plain, compact, keyed or multi-recipient start, optionally indexed
+void ECIESStream::StartSize(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  if (!node::Buffer::HasInstance(args[0]) || node::Buffer::Length(args[0]) < 4) {
+    return Nan::ThrowTypeError("streamHeaderSize(head) expects the first 4 bytes of a stream");
+  }
+
+  long size = HeaderSize((const ECIES_byte_t*)node::Buffer::Data(args[0]));
+
+  args.GetReturnValue().Set(Nan::New<v8::Number>(size < 0 ? -1 : (double)size));
+}
+
+// Start decryption: decryptStart(header, priv, callback(err)), the whole header, see streamHeaderSize()
+void ECIESStream::DecryptStart(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIESStream* obj = ObjectWrap::Unwrap<ECIESStream>(args.Holder());
+  size_t len = node::Buffer::HasInstance(args[0]) ? node::Buffer::Length(args[0]) : 0;
+  long size = len >= 4 ? HeaderSize((const ECIES_byte_t*)node::Buffer::Data(args[0])) : -1;
+
+  if (size < 0 || len != (size_t)size || !IsKeyBuffer(args[1]) || !args[2]->IsFunction()) {
+    return Nan::ThrowTypeError("decryptStart(header, priv, callback) expects a stream header and a 21 byte key buffer");
+  }
+
+  StreamStartWorker* worker = new StreamStartWorker(new Nan::Callback(args[2].As<v8::Function>()), obj, args.Holder());
+  worker->SetPrivateKey(node::Buffer::Data(args[1]), node::Buffer::Data(args[0]), len);
+  Nan::AsyncQueueWorker(worker);
+}
+
+static void QueueChunks(const Nan::FunctionCallbackInfo<v8::Value>& args, bool decrypt) {
+  ECIESStream* obj = node::ObjectWrap::Unwrap<ECIESStream>(args.Holder());
+
+  if (!node::Buffer::HasInstance(args[0]) || !args[1]->IsUint32() || args[1]->Uint32Value() < 1 || !args[2]->IsFunction()) {
+    return Nan::ThrowTypeError("expected (buffer, chunkSize, callback)");
+  }
+
+  if (!obj->started) {
+    return Nan::ThrowError("ECIES stream is not started");
+  }
+
+  // The batch owns the chunk numbers it covers, the next batch may be queued right away
+  size_t len = node::Buffer::Length(args[0]), size = args[1]->Uint32Value();
+  size_t piece = decrypt ? size + ECIES_CHUNK_OVERHEAD : size, pieces = (len + piece - 1) / piece;
+  ECIES_size_t first = obj->index;
+
+  obj->index += pieces;
+  obj->length += decrypt ? len - (len < pieces * ECIES_CHUNK_OVERHEAD ? len : pieces * ECIES_CHUNK_OVERHEAD) : len;
+
+  Nan::AsyncQueueWorker(new StreamChunkWorker(new Nan::Callback(args[2].As<v8::Function>()), obj, args.Holder(),
+                                              args[0]->ToObject(), size, decrypt, first));
+}
+
+// Encrypt chunks: encrypt(raw, chunkSize, callback(err, encrypted))
+void ECIESStream::Encrypt(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  QueueChunks(args, false);
+}
+
+// Decrypt chunks: decrypt(encrypted, chunkSize, callback(err, raw))
+void ECIESStream::Decrypt(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  QueueChunks(args, true);
+}
+
+// The index trailer after the last chunk: encryptEnd(chunkSize), a buffer of INDEX_SIZE bytes
+void ECIESStream::EncryptEnd(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIESStream* obj = ObjectWrap::Unwrap<ECIESStream>(args.Holder());
+  ECIES_byte_t trailer[ECIES_INDEX_SIZE];
+
+  if (!args[0]->IsUint32() || args[0]->Uint32Value() < 1) {
+    return Nan::ThrowTypeError("encryptEnd(chunkSize) expects the chunk size");
+  }
+
+  if (!obj->started || !obj->indexed) {
+    return Nan::ThrowError("ECIES stream is not started");
+  }
+
+  ECIES_index_encode(&obj->stream, trailer, args[0]->Uint32Value(), obj->length);
+  args.GetReturnValue().Set(Nan::CopyBuffer((char*)trailer, ECIES_INDEX_SIZE).ToLocalChecked());
+}
+
+// Check the index trailer of an indexed stream: decryptEnd(trailer, chunkSize), true when it is authentic
+// and matches the chunk size and the length decrypted, so a truncated stream is detected
+void ECIESStream::DecryptEnd(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIESStream* obj = ObjectWrap::Unwrap<ECIESStream>(args.Holder());
+  ECIES_size_t chunk_size;
+  uint64_t length;
+
+  if (!node::Buffer::HasInstance(args[0]) || node::Buffer::Length(args[0]) != ECIES_INDEX_SIZE || !args[1]->IsUint32()) {
+    return Nan::ThrowTypeError("decryptEnd(trailer, chunkSize) expects the index trailer and the chunk size");
+  }
+
+  if (!obj->started || !obj->indexed) {
+    return Nan::ThrowError("ECIES stream is not started");
+  }
+
+  bool ok = ECIES_index_decode(&obj->stream, (const ECIES_byte_t*)node::Buffer::Data(args[0]), &chunk_size, &length) > 0 &&
+            chunk_size == args[1]->Uint32Value() && length == obj->length;
+
+  args.GetReturnValue().Set(Nan::New(ok));
+}
+
+}  // namespace node_ecies
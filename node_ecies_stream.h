@@ -0,0 +1,44 @@
+// node_ecies_stream.h
+#ifndef ECIESSTREAM_H
+#define ECIESSTREAM_H
+
+#include <nan.h>
+#include "ecc.h"
+
+namespace node_ecies {
+
+// Native side of the chunked ECIES API.
+// Holds one ECIES_stream_t; the key agreement and every batch of chunks
+// run on the libuv thread pool, and results come back through callbacks.
+// Encryption writes indexed (seekable) streams, decryption reads those and
+// the legacy chunked ones.
+class ECIESStream : public node::ObjectWrap {
+	public:
+		static void Init(v8::Local<v8::Object> exports);
+
+		ECIES_stream_t stream;
+		bool started;
+		bool indexed;
+		// The next chunk index and the raw length so far, advanced when a batch is queued
+		ECIES_size_t index;
+		uint64_t length;
+
+	private:
+		explicit ECIESStream();
+		~ECIESStream();
+
+	static void New(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void EncryptStart(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void DecryptStart(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void Encrypt(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void Decrypt(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void EncryptEnd(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void DecryptEnd(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void StartSize(const Nan::FunctionCallbackInfo<v8::Value>& args);
+
+	static thread_local Nan::Persistent<v8::Function> constructor;
+};
+
+}  // namespace node_ecies
+
+#endif
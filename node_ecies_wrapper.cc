@@ -1,17 +1,29 @@
 // node_ecies_wrapper.cc
+#include <string.h>
+#include <vector>
 #include "node_ecies_wrapper.h"
+#include "node_ecies_stats.h"
 
 namespace node_ecies {
 
-Nan::Persistent<v8::Function> ECIESWrapper::constructor;
+thread_local Nan::Persistent<v8::Function> ECIESWrapper::constructor;
 
-ECIES_privkey_t ECIESWrapper::privateKey = {};
-ECIES_pubkey_t ECIESWrapper::publicKey = {{0},{0}};
+// Recipient slots decrypt() tries on the JS thread, one scalar multiplication
+// each; larger multi-recipient messages go to an ECIESEngine
+static const int kMaxSyncRecipients = 64;
 
-ECIESWrapper::ECIESWrapper(double value) : value_(value) {
+ECIESWrapper::ECIESWrapper(double value) : privateKey(), publicKey(), value_(value) {
 }
 
 ECIESWrapper::~ECIESWrapper() {
+  memset(&privateKey, 0, sizeof(privateKey));
+}
+
+const PublicKeyEntry* ECIESWrapper::PreparedPublicKey() {
+  if (!prepared_ || memcmp(&prepared_->key, &publicKey, sizeof(publicKey))) {
+    prepared_ = KeyTable::Acquire(publicKey);
+  }
+  return prepared_.get();
 }
 
 // Object initiator
@@ -25,11 +37,17 @@ void ECIESWrapper::Init(v8::Local<v8::Object> exports) {
 
   // Prototype
   Nan::SetPrototypeMethod(tpl, "generateKeys", GenerateKeys);
+  Nan::SetPrototypeMethod(tpl, "generateKeyPairs", GenerateKeyPairs);
   Nan::SetPrototypeMethod(tpl, "getKeys", GetKeys);
   Nan::SetPrototypeMethod(tpl, "setClientPublicKey", SetClientPublicKey);
   Nan::SetPrototypeMethod(tpl, "setPrivateKey", SetPrivateKey);
   Nan::SetPrototypeMethod(tpl, "encrypt", Encrypt);
   Nan::SetPrototypeMethod(tpl, "decrypt", Decrypt);
+  Nan::SetPrototypeMethod(tpl, "encryptMulti", EncryptMulti);
+  Nan::SetPrototypeMethod(tpl, "encryptIov", EncryptIov);
+  Nan::SetPrototypeMethod(tpl, "decryptIov", DecryptIov);
+  Nan::SetPrototypeMethod(tpl, "encryptPacked", EncryptPacked);
+  Nan::SetPrototypeMethod(tpl, "decryptPacked", DecryptPacked);
   // Test code
   Nan::SetPrototypeMethod(tpl, "getGazePoint", GetGazePoint);
   Nan::SetPrototypeMethod(tpl, "plusOne", PlusOne);
@@ -57,40 +75,106 @@ void ECIESWrapper::New(const Nan::FunctionCallbackInfo<v8::Value>& args) {
 
 // Get random keys
 void ECIESWrapper::GenerateKeys(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIESWrapper* obj = ObjectWrap::Unwrap<ECIESWrapper>(args.Holder());
   char pubX[2 * ECIES_KEY_SIZE + 1], pubY[2 * ECIES_KEY_SIZE + 1], privK[2 * ECIES_KEY_SIZE + 1];
 
-  ECIES_generate_keys(&ECIESWrapper::privateKey, &ECIESWrapper::publicKey);
+  uint64_t start = Stats::Now();
+
+  ECIES_generate_keys(&obj->privateKey, &obj->publicKey);
+  Stats::Record(Stats::kGenerateKeys, 1, 1, start);
   
-  hex_dump(pubX, ECIESWrapper::publicKey.x, ECIES_KEY_SIZE);
-  hex_dump(pubY, ECIESWrapper::publicKey.y, ECIES_KEY_SIZE);
-  hex_dump(privK, ECIESWrapper::privateKey.k, ECIES_KEY_SIZE);
+  hex_dump(pubX, obj->publicKey.x, ECIES_KEY_SIZE);
+  hex_dump(pubY, obj->publicKey.y, ECIES_KEY_SIZE);
+  hex_dump(privK, obj->privateKey.k, ECIES_KEY_SIZE);
 
   printf("pubX : %s, pubY : %s \n priv : %s\n", pubX, pubY, privK);
 
   v8::Local<v8::Object> result = Nan::New<v8::Object>();
   v8::Local<v8::Object> resultPub = Nan::New<v8::Object>();
-  resultPub->Set(Nan::New("x").ToLocalChecked(), Nan::CopyBuffer((char*)ECIESWrapper::publicKey.x, 21).ToLocalChecked());
-  resultPub->Set(Nan::New("y").ToLocalChecked(), Nan::CopyBuffer((char*)ECIESWrapper::publicKey.y, 21).ToLocalChecked());
+  resultPub->Set(Nan::New("x").ToLocalChecked(), Nan::CopyBuffer((char*)obj->publicKey.x, 21).ToLocalChecked());
+  resultPub->Set(Nan::New("y").ToLocalChecked(), Nan::CopyBuffer((char*)obj->publicKey.y, 21).ToLocalChecked());
   result->Set(Nan::New("pub").ToLocalChecked(), resultPub);
-  result->Set(Nan::New("priv").ToLocalChecked(), Nan::CopyBuffer((char*)ECIESWrapper::privateKey.k, 21).ToLocalChecked());
+  result->Set(Nan::New("priv").ToLocalChecked(), Nan::CopyBuffer((char*)obj->privateKey.k, 21).ToLocalChecked());
 
   args.GetReturnValue().Set(result);
 }
 
+// Bulk key generation off the main thread
+class GenerateKeyPairsWorker : public Nan::AsyncWorker {
+  public:
+    GenerateKeyPairsWorker(Nan::Callback* callback, uint32_t count)
+      : Nan::AsyncWorker(callback), count_(count),
+        priv_((ECIES_privkey_t*)malloc(count * sizeof(ECIES_privkey_t) + 1)),
+        pub_((ECIES_pubkey_t*)malloc(count * sizeof(ECIES_pubkey_t) + 1)) {
+    }
+
+    ~GenerateKeyPairsWorker() {
+      if (priv_) {
+        memset(priv_, 0, count_ * sizeof(ECIES_privkey_t));
+      }
+      free(priv_);
+      free(pub_);
+    }
+
+    void Execute() {
+      uint64_t start = Stats::Now();
+
+      if (!priv_ || !pub_ || ECIES_generate_keys_batch(priv_, pub_, count_) < 0) {
+        SetErrorMessage("Out of memory");
+        Stats::Record(Stats::kGenerateKeyPairs, -3, count_, start);
+        return;
+      }
+
+      Stats::Record(Stats::kGenerateKeyPairs, 1, count_, start);
+    }
+
+    void HandleOKCallback() {
+      Nan::HandleScope scope;
+
+      // The buffers take ownership of the key memory
+      v8::Local<v8::Object> result = Nan::New<v8::Object>();
+      result->Set(Nan::New("priv").ToLocalChecked(), Nan::NewBuffer((char*)priv_, count_ * sizeof(ECIES_privkey_t)).ToLocalChecked());
+      result->Set(Nan::New("pub").ToLocalChecked(), Nan::NewBuffer((char*)pub_, count_ * sizeof(ECIES_pubkey_t)).ToLocalChecked());
+      priv_ = NULL;
+      pub_ = NULL;
+
+      v8::Local<v8::Value> argv[] = { Nan::Null(), result };
+      callback->Call(2, argv);
+    }
+
+  private:
+    uint32_t count_;
+    ECIES_privkey_t* priv_;
+    ECIES_pubkey_t* pub_;
+};
+
+// Get many random key pairs: generateKeyPairs(n, callback(err, { priv, pub }))
+// priv holds n 21 byte keys, pub holds n 42 byte keys (x then y), back to back.
+// The key pair of the object is left untouched.
+void ECIESWrapper::GenerateKeyPairs(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  if (!args[0]->IsUint32() || !args[1]->IsFunction()) {
+    return Nan::ThrowTypeError("generateKeyPairs(n, callback) expects a count and a callback");
+  }
+
+  Nan::AsyncQueueWorker(new GenerateKeyPairsWorker(new Nan::Callback(args[1].As<v8::Function>()), args[0]->Uint32Value()));
+}
+
 // Get keys
 void ECIESWrapper::GetKeys(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIESWrapper* obj = ObjectWrap::Unwrap<ECIESWrapper>(args.Holder());
   v8::Local<v8::Object> result = Nan::New<v8::Object>();
   v8::Local<v8::Object> resultPub = Nan::New<v8::Object>();
-  resultPub->Set(Nan::New("x").ToLocalChecked(), Nan::CopyBuffer((char*)ECIESWrapper::publicKey.x, 21).ToLocalChecked());
-  resultPub->Set(Nan::New("y").ToLocalChecked(), Nan::CopyBuffer((char*)ECIESWrapper::publicKey.y, 21).ToLocalChecked());
+  resultPub->Set(Nan::New("x").ToLocalChecked(), Nan::CopyBuffer((char*)obj->publicKey.x, 21).ToLocalChecked());
+  resultPub->Set(Nan::New("y").ToLocalChecked(), Nan::CopyBuffer((char*)obj->publicKey.y, 21).ToLocalChecked());
   result->Set(Nan::New("pub").ToLocalChecked(), resultPub);
-  result->Set(Nan::New("priv").ToLocalChecked(), Nan::CopyBuffer((char*)ECIESWrapper::privateKey.k, 21).ToLocalChecked());
+  result->Set(Nan::New("priv").ToLocalChecked(), Nan::CopyBuffer((char*)obj->privateKey.k, 21).ToLocalChecked());
 
   args.GetReturnValue().Set(result);
 }
 
 // Set public key
 void ECIESWrapper::SetClientPublicKey(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIESWrapper* obj = ObjectWrap::Unwrap<ECIESWrapper>(args.Holder());
   v8::Local<v8::Object> x_object = args[0]->ToObject();
   char* x = (char*)node::Buffer::Data(x_object);
   uint32_t x_length = (uint32_t)node::Buffer::Length(x_object);
@@ -99,56 +183,111 @@ void ECIESWrapper::SetClientPublicKey(const Nan::FunctionCallbackInfo<v8::Value>
   char* y = (char*)node::Buffer::Data(y_object);
   uint32_t y_length = (uint32_t)node::Buffer::Length(y_object);
 
-  memcpy(ECIESWrapper::publicKey.x, x, x_length);
-  memcpy(ECIESWrapper::publicKey.y, y, y_length);
+  memcpy(obj->publicKey.x, x, x_length);
+  memcpy(obj->publicKey.y, y, y_length);
 
   v8::Local<v8::Object> resultPub = Nan::New<v8::Object>();
-  resultPub->Set(Nan::New("x").ToLocalChecked(), Nan::CopyBuffer((char*)ECIESWrapper::publicKey.x, 21).ToLocalChecked());
-  resultPub->Set(Nan::New("y").ToLocalChecked(), Nan::CopyBuffer((char*)ECIESWrapper::publicKey.y, 21).ToLocalChecked());
+  resultPub->Set(Nan::New("x").ToLocalChecked(), Nan::CopyBuffer((char*)obj->publicKey.x, 21).ToLocalChecked());
+  resultPub->Set(Nan::New("y").ToLocalChecked(), Nan::CopyBuffer((char*)obj->publicKey.y, 21).ToLocalChecked());
 
   args.GetReturnValue().Set(resultPub);
 }
 
 // Set private key
 void ECIESWrapper::SetPrivateKey(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIESWrapper* obj = ObjectWrap::Unwrap<ECIESWrapper>(args.Holder());
   v8::Local<v8::Object> priv_object = args[0]->ToObject();
   char* priv = (char*)node::Buffer::Data(priv_object);
   uint32_t priv_length = (uint32_t)node::Buffer::Length(priv_object);
 
-  memcpy(ECIESWrapper::privateKey.k, priv, priv_length);
+  memcpy(obj->privateKey.k, priv, priv_length);
 
-  args.GetReturnValue().Set(Nan::CopyBuffer((char*)ECIESWrapper::privateKey.k, 21).ToLocalChecked());
+  args.GetReturnValue().Set(Nan::CopyBuffer((char*)obj->privateKey.k, 21).ToLocalChecked());
 }
 
 // Encryption
 void ECIESWrapper::Encrypt(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIESWrapper* obj = ObjectWrap::Unwrap<ECIESWrapper>(args.Holder());
   v8::Local<v8::Object> text_object = args[0]->ToObject();
   char* text = (char*)node::Buffer::Data(text_object);
   uint32_t text_length = (uint32_t)node::Buffer::Length(text_object);
 
   // printf("plain text: %s, length: %d ", text, text_length);
 
+  // encrypt(buf, true) sends R compressed, 26 bytes less; encrypt(buf, 'keyed') adds
+  // the key ID for a Keyring on the other end; decrypt() takes all forms
+  bool keyed = args.Length() > 1 && args[1]->IsString() && !strcmp(*Nan::Utf8String(args[1]), "keyed");
+  bool compact = args.Length() > 1 && args[1]->IsTrue();
   ECIES_size_t len = text_length;
-  ECIES_byte_t* encrypted = (ECIES_byte_t*) malloc(len + ECIES_OVERHEAD);
+  size_t size = len + (keyed ? ECIES_KEYED_OVERHEAD : compact ? ECIES_COMPACT_OVERHEAD : ECIES_OVERHEAD);
+  ECIES_byte_t* encrypted = (ECIES_byte_t*) malloc(size);
+  uint64_t start = Stats::Now();
   
-  ECIES_encrypt(encrypted, text, len, &ECIESWrapper::publicKey);
+  const PublicKeyEntry* prepared = obj->PreparedPublicKey();
+
+  if (prepared->valid && keyed) {
+    ECIES_encrypt_keyed_prepared(encrypted, text, len, &prepared->table);
+  } else if (prepared->valid && compact) {
+    ECIES_encrypt_compact_prepared(encrypted, text, len, &prepared->table);
+  } else if (prepared->valid) {
+    ECIES_encrypt_prepared(encrypted, text, len, &prepared->table);
+  } else if (keyed) {
+    ECIES_encrypt_keyed(encrypted, text, len, &obj->publicKey);
+  } else if (compact) {
+    ECIES_encrypt_compact(encrypted, text, len, &obj->publicKey);
+  } else {
+    ECIES_encrypt(encrypted, text, len, &obj->publicKey);
+  }
+
+  Stats::Record(Stats::kEncrypt, 1, len, start);
 
-  args.GetReturnValue().Set(Nan::CopyBuffer(reinterpret_cast<char*>(encrypted), len + ECIES_OVERHEAD).ToLocalChecked());
+  args.GetReturnValue().Set(Nan::CopyBuffer(reinterpret_cast<char*>(encrypted), size).ToLocalChecked());
 
   free(encrypted);
 }
 
 // Decryption
 void ECIESWrapper::Decrypt(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIESWrapper* obj = ObjectWrap::Unwrap<ECIESWrapper>(args.Holder());
   v8::Local<v8::Object> text_object = args[0]->ToObject();
   ECIES_byte_t* text = (ECIES_byte_t*)node::Buffer::Data(text_object);
-  // uint32_t text_length = (uint32_t)node::Buffer::Length(text_object);
+  size_t text_length = node::Buffer::Length(text_object);
 
-  int decrypt_len = (int)args[1]->IntegerValue();
+  int64_t decrypt_len = args[1]->IntegerValue();
+  uint64_t start = Stats::Now();
+  int n = text_length >= 3 ? ECIES_multi_count(text) : -1;
+  long size;
+  int res;
 
-  char *decrypted = (char*)malloc(decrypt_len);
+  if (n > kMaxSyncRecipients) {
+    return Nan::ThrowRangeError("decrypt() opens at most 64 recipient slots, use an ECIESEngine for more");
+  }
 
-  if (ECIES_decrypt(decrypted, decrypt_len, (ECIES_byte_t*)text, &ECIESWrapper::privateKey) < 0) {
+  // Multi-recipient messages carry a tag byte, legacy ones start with zero;
+  // the message must hold its starting sequence, the data and the MAC
+  size = n > 0 ? ECIES_MULTI_START_OVERHEAD(n) : text_length >= 1 ? ECIES_start_size(text) : -1;
+
+  if (decrypt_len < 0 || size < 0 || text_length < (size_t)size + decrypt_len + ECIES_CHUNK_OVERHEAD) {
+    Stats::Record(Stats::kDecrypt, -3, 0, start);
+    args.GetReturnValue().Set(Nan::New(false));
+    return;
+  }
+
+  char *decrypted = (char*)malloc(decrypt_len > 0 ? decrypt_len : 1);
+
+  if (!decrypted) {
+    return Nan::ThrowError("Out of memory");
+  }
+
+  if (n > 0) {
+    res = ECIES_decrypt_multi(decrypted, decrypt_len, text, &obj->privateKey);
+  } else {
+    res = ECIES_decrypt(decrypted, decrypt_len, (ECIES_byte_t*)text, &obj->privateKey);
+  }
+
+  Stats::Record(Stats::kDecrypt, res, decrypt_len, start);
+
+  if (res < 0) {
     args.GetReturnValue().Set(Nan::New(false));
   } else {
     args.GetReturnValue().Set(Nan::CopyBuffer(reinterpret_cast<char*>(decrypted), decrypt_len).ToLocalChecked());
@@ -157,6 +296,231 @@ void ECIESWrapper::Decrypt(const Nan::FunctionCallbackInfo<v8::Value>& args) {
   free(decrypted);
 }
 
+// The buffers of an array as segments, false when an item is not a buffer
+static bool LoadSegments(v8::Local<v8::Value> value, std::vector<ECIES_iovec_t>& iov, size_t& total) {
+  v8::Local<v8::Array> list = value.As<v8::Array>();
+  uint32_t count = list->Length(), i;
+
+  iov.resize(count);
+  total = 0;
+
+  for (i = 0; i < count; i++) {
+    v8::Local<v8::Value> item = list->Get(i);
+    if (!node::Buffer::HasInstance(item)) {
+      return false;
+    }
+    iov[i].base = node::Buffer::Data(item);
+    iov[i].len = (ECIES_size_t)node::Buffer::Length(item);
+    total += iov[i].len;
+  }
+
+  return true;
+}
+
+// Scatter/gather encryption: encryptIov([header, body, ...]) is encrypt() of the
+// concatenated buffers, every segment is encrypted straight into the result
+void ECIESWrapper::EncryptIov(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIESWrapper* obj = ObjectWrap::Unwrap<ECIESWrapper>(args.Holder());
+  std::vector<ECIES_iovec_t> iov;
+  size_t len;
+
+  if (!args[0]->IsArray() || !LoadSegments(args[0], iov, len)) {
+    return Nan::ThrowTypeError("encryptIov(bufs) expects an array of buffers");
+  }
+
+  size_t size = len + ECIES_OVERHEAD;
+  ECIES_byte_t* encrypted = (ECIES_byte_t*)malloc(size);
+  uint64_t start = Stats::Now();
+
+  const PublicKeyEntry* prepared = obj->PreparedPublicKey();
+
+  if (prepared->valid) {
+    ECIES_encrypt_iov_prepared(encrypted, iov.data(), iov.size(), &prepared->table);
+  } else {
+    ECIES_encrypt_iov(encrypted, iov.data(), iov.size(), &obj->publicKey);
+  }
+
+  Stats::Record(Stats::kEncrypt, 1, len, start);
+
+  // The buffer takes ownership of the encrypted memory
+  args.GetReturnValue().Set(Nan::NewBuffer(reinterpret_cast<char*>(encrypted), size).ToLocalChecked());
+}
+
+// decryptIov([seg, ...], len) is decrypt() of a message received in pieces,
+// split anywhere; false when it is not valid
+void ECIESWrapper::DecryptIov(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIESWrapper* obj = ObjectWrap::Unwrap<ECIESWrapper>(args.Holder());
+  std::vector<ECIES_iovec_t> iov;
+  size_t total;
+
+  if (!args[0]->IsArray() || !LoadSegments(args[0], iov, total) || !args[1]->IsNumber()) {
+    return Nan::ThrowTypeError("decryptIov(bufs, len) expects an array of buffers and the decrypted length");
+  }
+
+  int64_t len = args[1]->IntegerValue();
+
+  if (len < 0 || (uint64_t)len > total) {
+    Stats::Record(Stats::kDecrypt, -1, 0, Stats::Now());
+    args.GetReturnValue().Set(Nan::New(false));
+    return;
+  }
+
+  char* decrypted = (char*)malloc(len > 0 ? len : 1);
+  uint64_t start = Stats::Now();
+
+  int res = ECIES_decrypt_iov(decrypted, (ECIES_size_t)len, iov.data(), iov.size(), &obj->privateKey);
+
+  Stats::Record(Stats::kDecrypt, res, len, start);
+
+  if (res < 0) {
+    free(decrypted);
+    args.GetReturnValue().Set(Nan::New(false));
+    return;
+  }
+
+  args.GetReturnValue().Set(Nan::NewBuffer(decrypted, len).ToLocalChecked());
+}
+
+// Multi-recipient encryption: encryptMulti(buf, [{ x, y }, ...]) encrypts the body once
+// and wraps its key for every public key; any of the private keys decrypts it with decrypt(),
+// the plaintext length being buf.length - (3 + 88 * keys.length + 8).
+void ECIESWrapper::EncryptMulti(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  if (!node::Buffer::HasInstance(args[0]) || !args[1]->IsArray()) {
+    return Nan::ThrowTypeError("encryptMulti(buf, keys) expects a buffer and an array of public keys");
+  }
+
+  v8::Local<v8::Array> list = args[1].As<v8::Array>();
+  uint32_t count = list->Length(), i;
+
+  if (count < 1 || count > ECIES_MULTI_MAX) {
+    return Nan::ThrowRangeError("encryptMulti expects 1 to 65535 public keys");
+  }
+
+  std::vector<ECIES_pubkey_t> keys(count);
+
+  for (i = 0; i < count; i++) {
+    v8::Local<v8::Value> item = list->Get(i);
+    v8::Local<v8::Value> x, y;
+    if (item->IsObject()) {
+      x = item->ToObject()->Get(Nan::New("x").ToLocalChecked());
+      y = item->ToObject()->Get(Nan::New("y").ToLocalChecked());
+    }
+    if (!item->IsObject() || !node::Buffer::HasInstance(x) || node::Buffer::Length(x) != ECIES_KEY_SIZE ||
+        !node::Buffer::HasInstance(y) || node::Buffer::Length(y) != ECIES_KEY_SIZE) {
+      return Nan::ThrowTypeError("encryptMulti expects public keys of two 21 byte buffers x and y");
+    }
+    memcpy(keys[i].x, node::Buffer::Data(x), ECIES_KEY_SIZE);
+    memcpy(keys[i].y, node::Buffer::Data(y), ECIES_KEY_SIZE);
+  }
+
+  const char* text = node::Buffer::Data(args[0]);
+  ECIES_size_t len = (ECIES_size_t)node::Buffer::Length(args[0]);
+  size_t size = ECIES_MULTI_START_OVERHEAD(count) + len + ECIES_CHUNK_OVERHEAD;
+  ECIES_byte_t* encrypted = (ECIES_byte_t*)malloc(size);
+  uint64_t start = Stats::Now();
+
+  ECIES_encrypt_multi(encrypted, text, len, keys.data(), count);
+
+  Stats::Record(Stats::kEncryptMulti, 1, len, start);
+
+  // The buffer takes ownership of the encrypted memory
+  args.GetReturnValue().Set(Nan::NewBuffer(reinterpret_cast<char*>(encrypted), size).ToLocalChecked());
+}
+
+// Packed encryption: encryptPacked([buf, ...]) returns one container with a record per buffer
+void ECIESWrapper::EncryptPacked(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIESWrapper* obj = ObjectWrap::Unwrap<ECIESWrapper>(args.Holder());
+
+  if (!args[0]->IsArray()) {
+    return Nan::ThrowTypeError("encryptPacked expects an array of buffers");
+  }
+
+  v8::Local<v8::Array> list = args[0].As<v8::Array>();
+  uint32_t count = list->Length(), i;
+  size_t size = 0, pos = 0;
+
+  for (i = 0; i < count; i++) {
+    v8::Local<v8::Value> item = list->Get(i);
+    if (!node::Buffer::HasInstance(item)) {
+      return Nan::ThrowTypeError("encryptPacked expects an array of buffers");
+    }
+    size += ECIES_pack_size((ECIES_size_t)node::Buffer::Length(item));
+  }
+
+  uint64_t start = Stats::Now();
+  const PublicKeyEntry* prepared = obj->PreparedPublicKey();
+  ECIES_byte_t* packed = (ECIES_byte_t*)malloc(size > 0 ? size : 1);
+
+  for (i = 0; i < count; i++) {
+    v8::Local<v8::Object> item = list->Get(i)->ToObject();
+    const char* text = node::Buffer::Data(item);
+    ECIES_size_t len = (ECIES_size_t)node::Buffer::Length(item);
+
+    pos += ECIES_pack_varint_put(packed + pos, len);
+    if (prepared->valid) {
+      ECIES_encrypt_prepared(packed + pos, text, len, &prepared->table);
+    } else {
+      ECIES_encrypt(packed + pos, text, len, &obj->publicKey);
+    }
+    pos += len + ECIES_OVERHEAD;
+    Stats::Count(Stats::kEncryptPacked, 1);
+  }
+
+  Stats::Time(Stats::kEncryptPacked, size, start);
+
+  // The buffer takes ownership of the container memory
+  args.GetReturnValue().Set(Nan::NewBuffer(reinterpret_cast<char*>(packed), size).ToLocalChecked());
+}
+
+// Packed decryption: decryptPacked(container) returns { data, offsets, status }
+// where message i is data[offsets[i], offsets[i + 1]) and status[i] is the ECIES_decrypt result.
+void ECIESWrapper::DecryptPacked(const Nan::FunctionCallbackInfo<v8::Value>& args) {
+  ECIESWrapper* obj = ObjectWrap::Unwrap<ECIESWrapper>(args.Holder());
+
+  if (!node::Buffer::HasInstance(args[0])) {
+    return Nan::ThrowTypeError("decryptPacked expects a buffer");
+  }
+
+  const ECIES_byte_t* packed = (const ECIES_byte_t*)node::Buffer::Data(args[0]);
+  size_t size = node::Buffer::Length(args[0]), count, raw_size, i;
+
+  uint64_t start = Stats::Now();
+
+  if (ECIES_pack_scan(packed, size, &count, &raw_size) < 0) {
+    Stats::Record(Stats::kDecryptPacked, -3, size, start);
+    return Nan::ThrowError("Malformed packed container");
+  }
+
+  v8::Isolate* isolate = v8::Isolate::GetCurrent();
+  v8::Local<v8::ArrayBuffer> offsets_buffer = v8::ArrayBuffer::New(isolate, (count + 1) * sizeof(uint32_t));
+  v8::Local<v8::ArrayBuffer> status_buffer = v8::ArrayBuffer::New(isolate, count);
+  uint32_t* offsets32 = (uint32_t*)offsets_buffer->GetContents().Data();
+  size_t* offsets = (size_t*)malloc((count + 1) * sizeof(size_t));
+  char* data = (char*)malloc(raw_size > 0 ? raw_size : 1);
+
+  signed char* status = (signed char*)status_buffer->GetContents().Data();
+
+  ECIES_pack_decrypt(data, offsets, status, packed, size, &obj->privateKey);
+
+  for (i = 0; i <= count; i++) {
+    offsets32[i] = (uint32_t)offsets[i];
+  }
+  for (i = 0; i < count; i++) {
+    Stats::Count(Stats::kDecryptPacked, status[i]);
+  }
+  free(offsets);
+
+  Stats::Time(Stats::kDecryptPacked, size, start);
+
+  v8::Local<v8::Object> result = Nan::New<v8::Object>();
+  // The buffer takes ownership of the slab
+  result->Set(Nan::New("data").ToLocalChecked(), Nan::NewBuffer(data, raw_size).ToLocalChecked());
+  result->Set(Nan::New("offsets").ToLocalChecked(), v8::Uint32Array::New(offsets_buffer, 0, count + 1));
+  result->Set(Nan::New("status").ToLocalChecked(), v8::Int8Array::New(status_buffer, 0, count));
+
+  args.GetReturnValue().Set(result);
+}
+
 /**
  * =========================
  *        Test code
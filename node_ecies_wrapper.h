@@ -5,31 +5,44 @@
 #include <nan.h>
 #include "ecc.h"
 #include "hex.h"
+#include "pack.h"
+#include "node_ecies_keytable.h"
 
 namespace node_ecies {
 
 class ECIESWrapper : public node::ObjectWrap {
 	public:
-		static ECIES_privkey_t privateKey;
-		static ECIES_pubkey_t publicKey;
+		ECIES_privkey_t privateKey;
+		ECIES_pubkey_t publicKey;
 		static void Init(v8::Local<v8::Object> exports);
 
+		// Prepared form of publicKey, shared through KeyTable
+		const PublicKeyEntry* PreparedPublicKey();
+
 	private:
 		explicit ECIESWrapper(double value = 0);
 		~ECIESWrapper();
 
 	static void New(const Nan::FunctionCallbackInfo<v8::Value>& args);
 	static void GenerateKeys(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void GenerateKeyPairs(const Nan::FunctionCallbackInfo<v8::Value>& args);
 	static void GetKeys(const Nan::FunctionCallbackInfo<v8::Value>& args);
 	static void SetClientPublicKey(const Nan::FunctionCallbackInfo<v8::Value>& args);
 	static void SetPrivateKey(const Nan::FunctionCallbackInfo<v8::Value>& args);
 	static void Encrypt(const Nan::FunctionCallbackInfo<v8::Value>& args);
 	static void Decrypt(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void EncryptMulti(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void EncryptIov(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void DecryptIov(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void EncryptPacked(const Nan::FunctionCallbackInfo<v8::Value>& args);
+	static void DecryptPacked(const Nan::FunctionCallbackInfo<v8::Value>& args);
 
 	// Test code
 	static void GetGazePoint(const Nan::FunctionCallbackInfo<v8::Value>& args);
 	static void PlusOne(const Nan::FunctionCallbackInfo<v8::Value>& args);
-	static Nan::Persistent<v8::Function> constructor;
+	// One constructor per context, each worker thread loads its own copy of the module
+	static thread_local Nan::Persistent<v8::Function> constructor;
+	std::shared_ptr<const PublicKeyEntry> prepared_;
 	double value_;
 };
 
@@ -0,0 +1,136 @@
+#include <string.h>
+#include "pack.h"
+
+/* the records decrypted in one call, a few ladders' worth */
+#define PACK_BATCH 32
+
+int ECIES_pack_varint_put(ECIES_byte_t *buf, ECIES_size_t val){
+  int n = 0;
+
+  for(; val >= 0x80; val >>= 7){
+    buf[n++] = (val & 0x7f) | 0x80;
+  }
+  buf[n++] = val;
+
+  return n;
+}
+
+int ECIES_pack_varint_get(ECIES_size_t *val, const ECIES_byte_t *buf, size_t size){
+  int n;
+
+  *val = 0;
+
+  for(n = 0; n < ECIES_PACK_VARINT_MAX && (size_t)n < size; n++){
+    /* the 5th byte holds the top 4 bits, anything above would not fit */
+    if(n == 4 && buf[n] > 0x0f){
+      return -1;
+    }
+    *val |= (ECIES_size_t)(buf[n] & 0x7f) << (7 * n);
+    if(!(buf[n] & 0x80)){
+      /* minimal encodings only, so a container has one byte string */
+      return n > 0 && buf[n] == 0 ? -1 : n + 1;
+    }
+  }
+
+  return -1;
+}
+
+static int varint_size(ECIES_size_t val){
+  int n = 1;
+
+  for(; val >= 0x80; val >>= 7){
+    n++;
+  }
+
+  return n;
+}
+
+size_t ECIES_pack_size(ECIES_size_t len){
+  return varint_size(len) + (size_t)len + ECIES_OVERHEAD;
+}
+
+size_t ECIES_pack_encrypt(ECIES_byte_t *buf, const char *raw, ECIES_size_t len, const ECIES_pubkey_t *pubkey){
+  int n = ECIES_pack_varint_put(buf, len);
+
+  ECIES_encrypt(buf + n, raw, len, pubkey);
+
+  return n + (size_t)len + ECIES_OVERHEAD;
+}
+
+/* the next record: returns the record size, the plaintext length in 'len' */
+static size_t pack_next(ECIES_size_t *len, const ECIES_byte_t *buf, size_t size){
+  int n = ECIES_pack_varint_get(len, buf, size);
+
+  if(n < 0 || size - n < ECIES_OVERHEAD || size - n - ECIES_OVERHEAD < *len){
+    return 0;
+  }
+
+  return n + (size_t)*len + ECIES_OVERHEAD;
+}
+
+int ECIES_pack_scan(const ECIES_byte_t *buf, size_t size, size_t *count, size_t *raw_size){
+  ECIES_size_t len;
+  size_t rec;
+
+  *count = 0;
+  *raw_size = 0;
+
+  for(; size > 0; buf += rec, size -= rec){
+    if(!(rec = pack_next(&len, buf, size))){
+      return -3;
+    }
+    ++*count;
+    *raw_size += len;
+  }
+
+  return 1;
+}
+
+/* decrypt the collected records, zero the failed ones */
+static int pack_flush(signed char *status, char *const *out, const ECIES_size_t *lens,
+                      const ECIES_byte_t *const *msgs, int n, const ECIES_privkey_t *privkey){
+  int res[PACK_BATCH], i, ok;
+
+  ok = ECIES_decrypt_batch(res, out, lens, msgs, n, privkey);
+
+  for(i = 0; i < n; i++){
+    if(res[i] < 0){
+      memset(out[i], 0, lens[i]);
+    }
+    status[i] = res[i];
+  }
+
+  return ok;
+}
+
+int ECIES_pack_decrypt(char *raw, size_t *offsets, signed char *status,
+                       const ECIES_byte_t *buf, size_t size, const ECIES_privkey_t *privkey){
+  const ECIES_byte_t *msgs[PACK_BATCH];
+  char *out[PACK_BATCH];
+  ECIES_size_t lens[PACK_BATCH];
+  size_t rec, pos = 0;
+  int n = 0, ok = 0;
+
+  for(*offsets = 0; size > 0; buf += rec, size -= rec){
+    if(!(rec = pack_next(&lens[n], buf, size))){
+      return -3;
+    }
+
+    msgs[n] = buf + rec - lens[n] - ECIES_OVERHEAD;
+    out[n] = raw + pos;
+    pos += lens[n];
+    *++offsets = pos;
+
+    if(++n == PACK_BATCH){
+      ok += pack_flush(status, out, lens, msgs, n, privkey);
+      status += n;
+      n = 0;
+    }
+  }
+
+  if(n > 0){
+    ok += pack_flush(status, out, lens, msgs, n, privkey);
+  }
+
+  return ok;
+}
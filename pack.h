@@ -0,0 +1,97 @@
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+/**
+ * @defgroup pack Packed container
+ * @brief Many ECIES messages in one buffer.
+ * @{
+ *
+ * @file
+ * @brief Packed container
+ *
+ * The container is a plain concatenation of records. Every record is the
+ * plaintext length as unsigned LEB128 varint followed by the ECIES message
+ * (`len + ECIES_OVERHEAD` bytes), so a reader needs no side information
+ * to find and decrypt each message.
+ */
+#ifndef _PACK_H_
+#define _PACK_H_
+
+#include <stddef.h>
+#include "ecc.h"
+
+/**
+ * @brief The maximum length of varint prefix in bytes.
+ */
+#define ECIES_PACK_VARINT_MAX 5
+
+/**
+ * @brief Write varint.
+ *
+ * @param[out] buf The destination buffer, at least `ECIES_PACK_VARINT_MAX` bytes.
+ * @param[in] val The value.
+ * @return The number of bytes written.
+ */
+int ECIES_pack_varint_put(ECIES_byte_t *buf, ECIES_size_t val);
+
+/**
+ * @brief Read varint.
+ *
+ * @param[out] val The value.
+ * @param[in] buf The source buffer.
+ * @param[in] size The number of bytes available in @p buf.
+ * @return The number of bytes read, -1 when truncated, too long, over 32 bits or not minimal.
+ */
+int ECIES_pack_varint_get(ECIES_size_t *val, const ECIES_byte_t *buf, size_t size);
+
+/**
+ * @brief The record size for @p len bytes of plaintext.
+ */
+size_t ECIES_pack_size(ECIES_size_t len);
+
+/**
+ * @brief Encrypt one message and append it as record.
+ *
+ * @param[out] buf The destination buffer, `ECIES_pack_size(len)` bytes.
+ * @param[in] raw The source data buffer.
+ * @param[in] len The source data length in chars.
+ * @param[in] pubkey The public key which will be used for encryption.
+ * @return The number of bytes written.
+ */
+size_t ECIES_pack_encrypt(ECIES_byte_t *buf, const char *raw, ECIES_size_t len, const ECIES_pubkey_t *pubkey);
+
+/**
+ * @brief Walk the container without decrypting.
+ *
+ * @param[in] buf The container.
+ * @param[in] size The container size in bytes.
+ * @param[out] count The number of records.
+ * @param[out] raw_size The total plaintext size of all records.
+ * @return 1 when success, -3 when the container is malformed.
+ */
+int ECIES_pack_scan(const ECIES_byte_t *buf, size_t size, size_t *count, size_t *raw_size);
+
+/**
+ * @brief Decrypt every record into one slab.
+ *
+ * @param[out] raw The destination slab, `raw_size` bytes from ECIES_pack_scan().
+ * @param[out] offsets The plaintext offsets in @p raw, `count + 1` entries; record `i` is `[offsets[i], offsets[i + 1])`.
+ * @param[out] status The result of ECIES_decrypt() for each record, `count` entries.
+ * @param[in] buf The container.
+ * @param[in] size The container size in bytes.
+ * @param[in] privkey The private key which will be used for decryption.
+ * @return The number of records decrypted successfully, -3 when the container is malformed.
+ *
+ * Records which fail to decrypt keep their place in @p raw, zero filled.
+ */
+int ECIES_pack_decrypt(char *raw, size_t *offsets, signed char *status,
+                       const ECIES_byte_t *buf, size_t size, const ECIES_privkey_t *privkey);
+
+#endif/*_PACK_H_*/
+/**
+ * @}
+ */
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,240 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pool.h"
+
+/* the number of keys generated per batch, they share the batch setup cost */
+#ifndef ECIES_POOL_BATCH
+#define ECIES_POOL_BATCH ECIES_PROFILE_PICK(8, 64, 128)
+#endif
+
+struct ECIES_pool {
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_t thread;
+  ECIES_ephemeral_t *ring;
+  ECIES_size_t head, count, low, high;
+  int filling, stop;
+  unsigned gen;
+};
+
+/* bumped in every forked child: a pool of an older generation belongs to the parent,
+   its thread is gone and its keys must never be handed out twice */
+static volatile unsigned pool_gen = 0;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+static void pool_forked(void){
+  pool_gen++;
+}
+
+static void pool_atfork(void){
+  pthread_atfork(NULL, NULL, pool_forked);
+}
+
+/* run the refill thread only when nothing else wants the CPU */
+static void pool_idle_priority(void){
+#ifdef SCHED_IDLE
+  struct sched_param param;
+  memset(&param, 0, sizeof(param));
+  pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+}
+
+static void *pool_thread(void *arg){
+  ECIES_pool_t *pool = arg;
+  ECIES_privkey_t k[ECIES_POOL_BATCH];
+  ECIES_pubkey_t R[ECIES_POOL_BATCH];
+  ECIES_size_t want, i;
+
+  pool_idle_priority();
+
+  pthread_mutex_lock(&pool->lock);
+
+  for(; ; ){
+    while(!pool->stop && !pool->filling){
+      pthread_cond_wait(&pool->wake, &pool->lock);
+    }
+
+    if(pool->stop){
+      break;
+    }
+
+    want = pool->high - pool->count;
+
+    if(want == 0){
+      pool->filling = 0;
+      continue;
+    }
+
+    if(want > ECIES_POOL_BATCH){
+      want = ECIES_POOL_BATCH;
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+    if(ECIES_generate_keys_batch(k, R, want) < 0){
+      want = 0;
+    }
+    pthread_mutex_lock(&pool->lock);
+
+    /* the pool may have been resized meanwhile */
+    for(i = 0; i < want && pool->count < pool->high; i++, pool->count++){
+      ECIES_ephemeral_t *eph = &pool->ring[(pool->head + pool->count) % pool->high];
+      eph->k = k[i];
+      eph->R = R[i];
+    }
+
+    if(pool->count >= pool->high){
+      pool->filling = 0;
+    }
+
+    memset(k, 0, sizeof(k));
+  }
+
+  pthread_mutex_unlock(&pool->lock);
+
+  return NULL;
+}
+
+ECIES_pool_t *ECIES_pool_create(ECIES_size_t low, ECIES_size_t high){
+  ECIES_pool_t *pool = calloc(1, sizeof(ECIES_pool_t));
+
+  if(!pool){
+    return NULL;
+  }
+
+  pthread_once(&pool_once, pool_atfork);
+  pool->gen = pool_gen;
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+
+  if(ECIES_pool_resize(pool, low, high) < 0 ||
+     pthread_create(&pool->thread, NULL, pool_thread, pool)){
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->ring);
+    free(pool);
+    return NULL;
+  }
+
+  return pool;
+}
+
+int ECIES_pool_resize(ECIES_pool_t *pool, ECIES_size_t low, ECIES_size_t high){
+  ECIES_ephemeral_t *ring = NULL;
+  ECIES_size_t i;
+
+  if(pool->gen != pool_gen){
+    return 1;
+  }
+
+  if(low > high){
+    low = high;
+  }
+
+  if(high > 0 && !(ring = calloc(high, sizeof(ECIES_ephemeral_t)))){
+    return -1;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+
+  if(pool->count > high){
+    pool->count = high;
+  }
+
+  for(i = 0; i < pool->count; i++){
+    ring[i] = pool->ring[(pool->head + i) % pool->high];
+  }
+
+  if(pool->ring){
+    memset(pool->ring, 0, pool->high * sizeof(ECIES_ephemeral_t));
+    free(pool->ring);
+  }
+
+  pool->ring = ring;
+  pool->head = 0;
+  pool->low = low;
+  pool->high = high;
+
+  if(pool->count <= low && pool->count < high){
+    pool->filling = 1;
+    pthread_cond_signal(&pool->wake);
+  }
+
+  pthread_mutex_unlock(&pool->lock);
+
+  return 1;
+}
+
+int ECIES_pool_take(void *arg, ECIES_ephemeral_t *eph){
+  ECIES_pool_t *pool = arg;
+  ECIES_ephemeral_t *slot;
+  int res = 0;
+
+  if(pool->gen != pool_gen){
+    return 0;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+
+  if(pool->count > 0){
+    slot = &pool->ring[pool->head];
+    *eph = *slot;
+    memset(slot, 0, sizeof(*slot));
+    pool->head = (pool->head + 1) % pool->high;
+    pool->count--;
+    res = 1;
+  }
+
+  if(pool->count <= pool->low && pool->count < pool->high && !pool->filling){
+    pool->filling = 1;
+    pthread_cond_signal(&pool->wake);
+  }
+
+  pthread_mutex_unlock(&pool->lock);
+
+  return res;
+}
+
+ECIES_size_t ECIES_pool_size(ECIES_pool_t *pool){
+  ECIES_size_t count;
+
+  if(pool->gen != pool_gen){
+    return 0;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  count = pool->count;
+  pthread_mutex_unlock(&pool->lock);
+
+  return count;
+}
+
+void ECIES_pool_destroy(ECIES_pool_t *pool){
+  /* in a forked child there is no thread to stop, and the lock may be held by a thread that is gone */
+  if(pool->gen != pool_gen){
+    if(pool->ring){
+      memset(pool->ring, 0, pool->high * sizeof(ECIES_ephemeral_t));
+      free(pool->ring);
+    }
+    free(pool);
+    return;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->stop = 1;
+  pthread_cond_signal(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+
+  pthread_join(pool->thread, NULL);
+
+  if(pool->ring){
+    memset(pool->ring, 0, pool->high * sizeof(ECIES_ephemeral_t));
+    free(pool->ring);
+  }
+
+  pthread_cond_destroy(&pool->wake);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool);
+}
@@ -0,0 +1,79 @@
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+/**
+ * @defgroup pool Ephemeral key pool
+ * @brief Background precomputation of ephemeral keys.
+ * @{
+ *
+ * @file
+ * @brief Ephemeral key pool
+ *
+ * A background thread keeps the pool filled with fresh (k, R = k * G) pairs,
+ * generated in batches with ECIES_generate_keys_batch() at idle priority.
+ * Refilling starts when the pool drops to the low watermark and stops at the high one.
+ * Every pair is handed out exactly once and wiped from the pool.
+ * In a child forked from the process the pool is dead: it hands out nothing,
+ * so the child never reuses a key of the parent, and may only be destroyed.
+ *
+ * Plug it into the library with:
+ *
+ *     ECIES_set_ephemeral_source(ECIES_pool_take, pool);
+ */
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include "ecc.h"
+
+/**
+ * @brief The pool type.
+ */
+typedef struct ECIES_pool ECIES_pool_t;
+
+/**
+ * @brief Create pool and start its thread.
+ *
+ * @param[in] low The low watermark.
+ * @param[in] high The high watermark, the pool capacity.
+ * @return The pool, NULL when failed.
+ */
+ECIES_pool_t *ECIES_pool_create(ECIES_size_t low, ECIES_size_t high);
+
+/**
+ * @brief Change watermarks.
+ *
+ * Shrinking drops (and wipes) the surplus keys, zero capacity empties the pool and idles the thread.
+ *
+ * @return 1 when success, < 0 when out of memory.
+ */
+int ECIES_pool_resize(ECIES_pool_t *pool, ECIES_size_t low, ECIES_size_t high);
+
+/**
+ * @brief Take one ephemeral key.
+ *
+ * Matches ECIES_ephemeral_source_t, @p pool is the ECIES_pool_t.
+ *
+ * @return 1 when success, 0 when the pool is empty.
+ */
+int ECIES_pool_take(void *pool, ECIES_ephemeral_t *eph);
+
+/**
+ * @brief The number of ready keys.
+ */
+ECIES_size_t ECIES_pool_size(ECIES_pool_t *pool);
+
+/**
+ * @brief Stop the thread and free the pool.
+ *
+ * No ECIES_pool_take() may run or start on the pool, unset the ephemeral source first.
+ */
+void ECIES_pool_destroy(ECIES_pool_t *pool);
+
+#endif/*_POOL_H_*/
+/**
+ * @}
+ */
+#ifdef __cplusplus
+}
+#endif
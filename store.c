@@ -0,0 +1,316 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "store.h"
+
+#define STORE_VERSION 1
+
+/* written natively, a store from a machine of other byte order doesn't open */
+#define STORE_ORDER 0x01020304
+
+#define STORE_PAGE 4096
+#define STORE_LINE 64
+
+/* every table starts on a cache line of its own */
+#define STORE_STRIDE ((sizeof(ECIES_pubkey_table_t) + STORE_LINE - 1) & ~(size_t)(STORE_LINE - 1))
+
+typedef struct {
+  char magic[4];
+  uint32_t order;
+  uint32_t version;
+  uint32_t degree;
+  uint32_t comb_width;
+  uint32_t stride;
+  uint64_t count;
+  uint64_t tables;   /* the offset of the first table, page aligned */
+} store_header_t;
+
+struct ECIES_store {
+  const ECIES_byte_t *map;
+  size_t size;
+  const ECIES_pubkey_t *keys;
+  const ECIES_byte_t *tables;
+  size_t count;
+};
+
+/* the table builders share one counter, each table is written at its offset */
+typedef struct {
+  pthread_mutex_t lock;
+  const ECIES_pubkey_t *keys;
+  size_t count, next;
+  uint64_t tables;
+  int fd;
+  int res;
+} build_t;
+
+static int key_cmp(const void *a, const void *b){
+  return memcmp(a, b, sizeof(ECIES_pubkey_t));
+}
+
+static int write_at(int fd, const void *buf, size_t len, uint64_t off){
+  const ECIES_byte_t *p = buf;
+  ssize_t wbs;
+
+  while(len > 0){
+    wbs = pwrite(fd, p, len, off);
+    if(wbs < 0){
+      if(errno == EINTR){
+        continue;
+      }
+      return -1;
+    }
+    p += wbs;
+    off += wbs;
+    len -= wbs;
+  }
+
+  return 0;
+}
+
+static void *build_thread(void *arg){
+  build_t *b = arg;
+  ECIES_pubkey_table_t *tab = malloc(sizeof(ECIES_pubkey_table_t));
+  size_t i;
+  int res = tab ? 0 : -1;
+
+  while(res == 0){
+    pthread_mutex_lock(&b->lock);
+    i = b->next++;
+    if(b->res < 0){
+      i = b->count;
+    }
+    pthread_mutex_unlock(&b->lock);
+
+    if(i >= b->count){
+      break;
+    }
+
+    if(ECIES_prepare_pubkey(tab, &b->keys[i]) < 0){
+      res = -2;
+    }else if(write_at(b->fd, tab, sizeof(ECIES_pubkey_table_t), b->tables + i * STORE_STRIDE) < 0){
+      res = -1;
+    }
+  }
+
+  if(res < 0){
+    pthread_mutex_lock(&b->lock);
+    if(b->res == 0){
+      b->res = res;
+    }
+    pthread_mutex_unlock(&b->lock);
+  }
+
+  free(tab);
+
+  return NULL;
+}
+
+long ECIES_store_build(const char *path, const ECIES_pubkey_t *keys, size_t n, int jobs){
+  ECIES_pubkey_t *sorted;
+  store_header_t hdr;
+  pthread_t *threads;
+  build_t b;
+  char *tmp;
+  size_t count, i;
+  int started;
+
+  if(jobs < 1){
+    jobs = 1;
+  }
+
+  sorted = malloc(n > 0 ? n * sizeof(ECIES_pubkey_t) : 1);
+  threads = malloc(jobs * sizeof(pthread_t));
+  tmp = malloc(strlen(path) + 5);
+
+  if(!sorted || !threads || !tmp){
+    free(sorted);
+    free(threads);
+    free(tmp);
+    return -1;
+  }
+
+  /* sorted and distinct, the lookup is a binary search */
+  memcpy(sorted, keys, n * sizeof(ECIES_pubkey_t));
+  qsort(sorted, n, sizeof(ECIES_pubkey_t), key_cmp);
+  for(count = 0, i = 0; i < n; i++){
+    if(count == 0 || key_cmp(&sorted[count - 1], &sorted[i])){
+      sorted[count++] = sorted[i];
+    }
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, ECIES_STORE_MAGIC, 4);
+  hdr.order = STORE_ORDER;
+  hdr.version = STORE_VERSION;
+  hdr.degree = ECIES_DEGREE;
+  hdr.comb_width = ECIES_COMB_WIDTH;
+  hdr.stride = STORE_STRIDE;
+  hdr.count = count;
+  hdr.tables = (sizeof(hdr) + count * sizeof(ECIES_pubkey_t) + STORE_PAGE - 1) & ~(uint64_t)(STORE_PAGE - 1);
+
+  memset(&b, 0, sizeof(b));
+  pthread_mutex_init(&b.lock, NULL);
+  b.keys = sorted;
+  b.count = count;
+  b.tables = hdr.tables;
+
+  /* built aside, readers of the old store keep their mapping */
+  sprintf(tmp, "%s.tmp", path);
+  b.fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+  if(b.fd < 0 ||
+     write_at(b.fd, &hdr, sizeof(hdr), 0) < 0 ||
+     write_at(b.fd, sorted, count * sizeof(ECIES_pubkey_t), sizeof(hdr)) < 0 ||
+     ftruncate(b.fd, hdr.tables + count * STORE_STRIDE) < 0){
+    b.res = -1;
+  }
+
+  if(b.res == 0){
+    for(started = 1; started < jobs; started++){
+      if(pthread_create(&threads[started], NULL, build_thread, &b)){
+        break;
+      }
+    }
+    build_thread(&b);
+    while(--started > 0){
+      pthread_join(threads[started], NULL);
+    }
+  }
+
+  if(b.fd >= 0){
+    if(b.res == 0 && fsync(b.fd) < 0){
+      b.res = -1;
+    }
+    if(close(b.fd) < 0 && b.res == 0){
+      b.res = -1;
+    }
+    if(b.res == 0 && rename(tmp, path) < 0){
+      b.res = -1;
+    }
+    if(b.res < 0){
+      unlink(tmp);
+    }
+  }
+
+  pthread_mutex_destroy(&b.lock);
+  free(sorted);
+  free(threads);
+  free(tmp);
+
+  return b.res < 0 ? b.res : (long)count;
+}
+
+ECIES_store_t *ECIES_store_open(const char *path){
+  ECIES_store_t *store;
+  const store_header_t *hdr;
+  struct stat st;
+  size_t size, i;
+  void *map;
+  int fd = open(path, O_RDONLY);
+
+  if(fd < 0){
+    return NULL;
+  }
+
+  if(fstat(fd, &st) < 0 || (uint64_t)st.st_size < sizeof(store_header_t)){
+    close(fd);
+    return NULL;
+  }
+
+  size = st.st_size;
+  map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if(map == MAP_FAILED){
+    return NULL;
+  }
+
+  hdr = map;
+
+  if(memcmp(hdr->magic, ECIES_STORE_MAGIC, 4) ||
+     hdr->order != STORE_ORDER ||
+     hdr->version != STORE_VERSION ||
+     hdr->degree != ECIES_DEGREE ||
+     hdr->comb_width != ECIES_COMB_WIDTH ||
+     hdr->stride != STORE_STRIDE ||
+     hdr->count > (size - sizeof(store_header_t)) / sizeof(ECIES_pubkey_t) ||
+     hdr->tables % STORE_PAGE ||
+     hdr->tables < sizeof(store_header_t) + hdr->count * sizeof(ECIES_pubkey_t) ||
+     hdr->tables > size ||
+     (size - hdr->tables) / STORE_STRIDE < hdr->count ||
+     !(store = malloc(sizeof(ECIES_store_t)))){
+    munmap(map, size);
+    return NULL;
+  }
+
+  store->map = map;
+  store->size = size;
+  store->keys = (const ECIES_pubkey_t*)(store->map + sizeof(store_header_t));
+  store->tables = store->map + hdr->tables;
+  store->count = hdr->count;
+
+  /* the lookup relies on the order */
+  for(i = 1; i < store->count; i++){
+    if(key_cmp(&store->keys[i - 1], &store->keys[i]) >= 0){
+      ECIES_store_close(store);
+      return NULL;
+    }
+  }
+
+  /* a lookup touches one table, reading ahead only evicts others */
+  madvise((void*)store->tables, size - hdr->tables, MADV_RANDOM);
+
+  return store;
+}
+
+size_t ECIES_store_count(const ECIES_store_t *store){
+  return store->count;
+}
+
+const ECIES_pubkey_table_t *ECIES_store_lookup(const ECIES_store_t *store, const ECIES_pubkey_t *pubkey){
+  const ECIES_pubkey_table_t *tab;
+  size_t lo = 0, hi = store->count, mid;
+  int c;
+
+  while(lo < hi){
+    mid = lo + (hi - lo) / 2;
+    c = key_cmp(pubkey, &store->keys[mid]);
+    if(c == 0){
+      /* a table of another key would encrypt to a point nobody can decrypt */
+      tab = (const ECIES_pubkey_table_t*)(store->tables + mid * STORE_STRIDE);
+      return ECIES_prepared_is_of(tab, pubkey) ? tab : NULL;
+    }
+    if(c < 0){
+      hi = mid;
+    }else{
+      lo = mid + 1;
+    }
+  }
+
+  return NULL;
+}
+
+int ECIES_store_encrypt_start(const ECIES_store_t *store, ECIES_stream_t *stm, ECIES_byte_t *msg, const ECIES_pubkey_t *pubkey){
+  const ECIES_pubkey_table_t *tab = ECIES_store_lookup(store, pubkey);
+
+  if(!tab){
+    ECIES_encrypt_start(stm, msg, pubkey);
+    return 0;
+  }
+
+  ECIES_encrypt_start_prepared(stm, msg, tab);
+
+  return 1;
+}
+
+void ECIES_store_close(ECIES_store_t *store){
+  munmap((void*)store->map, store->size);
+  free(store);
+}
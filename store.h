@@ -0,0 +1,103 @@
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+/**
+ * @defgroup store Table store
+ * @brief Prepared public keys in a memory-mapped file.
+ * @{
+ *
+ * @file
+ * @brief Table store
+ *
+ * A store file holds the precomputation tables (see ECIES_prepare_pubkey())
+ * of many public keys, so they are built once instead of at every start.
+ * It is mapped read-only: opening costs nothing regardless of the number of
+ * keys, only the tables in use are paged in, and every process that maps the
+ * same file shares one copy of them through the page cache.
+ *
+ * Layout: a header, the public keys sorted by their x, y bytes, and the tables
+ * in the same order, each on its own cache lines starting at a page boundary.
+ * The tables are kept in native byte order and for the ECIES_COMB_WIDTH the
+ * store was built with, so a store only opens on a matching build.
+ */
+#ifndef _STORE_H_
+#define _STORE_H_
+
+#include <stddef.h>
+#include "ecc.h"
+
+/**
+ * @brief The first bytes of a store file.
+ */
+#define ECIES_STORE_MAGIC "ECTS"
+
+/**
+ * @brief The store type.
+ */
+typedef struct ECIES_store ECIES_store_t;
+
+/**
+ * @brief Build store file.
+ *
+ * @param[in] path The file to write, replaced atomically when complete.
+ * @param[in] keys The public keys, in any order, duplicates allowed.
+ * @param[in] n The number of keys.
+ * @param[in] jobs The number of threads preparing the tables.
+ * @return The number of distinct keys stored, -1 when the file cannot be written, -2 when a key is not valid.
+ *
+ * Preparing the tables is the whole cost, about three encryptions per key.
+ */
+long ECIES_store_build(const char *path, const ECIES_pubkey_t *keys, size_t n, int jobs);
+
+/**
+ * @brief Map store file.
+ *
+ * @param[in] path The store file.
+ * @return The store, NULL when the file cannot be mapped or is not a store of this build.
+ */
+ECIES_store_t *ECIES_store_open(const char *path);
+
+/**
+ * @brief The number of keys in the store.
+ */
+size_t ECIES_store_count(const ECIES_store_t *store);
+
+/**
+ * @brief Find the prepared table of a public key.
+ *
+ * @param[in] store The store.
+ * @param[in] pubkey The public key.
+ * @return The table inside the mapping, NULL when the key is not in the store
+ * or its table is not the one of the key (see ECIES_prepared_is_of()).
+ *
+ * The table stays valid until ECIES_store_close(), pass it to ECIES_encrypt_start_prepared().
+ */
+const ECIES_pubkey_table_t *ECIES_store_lookup(const ECIES_store_t *store, const ECIES_pubkey_t *pubkey);
+
+/**
+ * @brief Start the encryption using the stored table of a public key.
+ *
+ * @param[in] store The store.
+ * @param[out] stm The stream data.
+ * @param[out] msg The destination encrypted data buffer.
+ * @param[in] pubkey The public key which will be used for encryption.
+ * @return 1 when the stored table was used, 0 when the key has no valid table in the store and
+ * ECIES_encrypt_start() was used.
+ *
+ * Same output as ECIES_encrypt_start().
+ */
+int ECIES_store_encrypt_start(const ECIES_store_t *store, ECIES_stream_t *stm, ECIES_byte_t *msg, const ECIES_pubkey_t *pubkey);
+
+/**
+ * @brief Unmap the store.
+ */
+void ECIES_store_close(ECIES_store_t *store);
+
+#endif/*_STORE_H_*/
+/**
+ * @}
+ */
+#ifdef __cplusplus
+}
+#endif
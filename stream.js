@@ -0,0 +1,178 @@
+// stream.js
+const addon = require('./build/Release/ECIES');
+const Transform = require('stream').Transform;
+const util = require('util');
+
+// Must match CHUNK_SIZE of tool.c to stay compatible with its chunked format
+const DEFAULT_CHUNK_SIZE = 8 * 1024;
+
+// Collects incoming buffers and hands them out in whole units
+function Pending() {
+    this.buffers = [];
+    this.length = 0;
+}
+
+Pending.prototype.push = function(buf) {
+    this.buffers.push(buf);
+    this.length += buf.length;
+};
+
+Pending.prototype.peek = function(len) {
+    return (this.buffers.length === 1 ? this.buffers[0] : Buffer.concat(this.buffers, this.length)).slice(0, len);
+};
+
+Pending.prototype.take = function(len) {
+    var all = this.buffers.length === 1 ? this.buffers[0] : Buffer.concat(this.buffers, this.length);
+    var rest = all.slice(len);
+    this.buffers = rest.length ? [rest] : [];
+    this.length = rest.length;
+    return all.slice(0, len);
+};
+
+// Encrypts everything written to it into the indexed (seekable) ECIES format of `tool e --seekable`:
+// the stream header, `chunkSize` pieces each with its MAC, numbered so none can be dropped or
+// moved, and the index trailer, so a truncated stream is detected.
+function EncryptStream(pub, options) {
+    if (!(this instanceof EncryptStream)) return new EncryptStream(pub, options);
+    options = options || {};
+    Transform.call(this, options);
+
+    this._native = new addon.ECIESStream();
+    this._pub = pub;
+    this._chunkSize = options.chunkSize || DEFAULT_CHUNK_SIZE;
+    this._pending = new Pending();
+    this._started = false;
+}
+util.inherits(EncryptStream, Transform);
+
+EncryptStream.prototype._start = function(next) {
+    if (this._started) return next();
+
+    var self = this;
+    this._native.encryptStart(this._pub.x, this._pub.y, function(err, header) {
+        if (err) return next(err);
+        self._started = true;
+        self.push(header);
+        next();
+    });
+};
+
+EncryptStream.prototype._encrypt = function(len, cb) {
+    if (len === 0) return cb();
+
+    var self = this;
+    this._native.encrypt(this._pending.take(len), this._chunkSize, function(err, encrypted) {
+        if (err) return cb(err);
+        self.push(encrypted);
+        cb();
+    });
+};
+
+EncryptStream.prototype._transform = function(chunk, encoding, cb) {
+    var self = this;
+    this._pending.push(chunk);
+    this._start(function(err) {
+        if (err) return cb(err);
+        self._encrypt(self._pending.length - self._pending.length % self._chunkSize, cb);
+    });
+};
+
+EncryptStream.prototype._flush = function(cb) {
+    var self = this;
+    this._start(function(err) {
+        if (err) return cb(err);
+        self._encrypt(self._pending.length, function(err) {
+            if (err) return cb(err);
+            self.push(self._native.encryptEnd(self._chunkSize));
+            cb();
+        });
+    });
+};
+
+// Decrypts the chunked ECIES format produced by EncryptStream or `tool e`, with or without
+// --seekable, to one or many public keys, plain, --compact or --keyed; not --framed.
+// The chunk size must be the same one the encryptor used.
+// Chunks of streams without the index can't be told apart by position, prefer the indexed format.
+function DecryptStream(priv, options) {
+    if (!(this instanceof DecryptStream)) return new DecryptStream(priv, options);
+    options = options || {};
+    Transform.call(this, options);
+
+    this._native = new addon.ECIESStream();
+    this._priv = priv;
+    this._chunkSize = options.chunkSize || DEFAULT_CHUNK_SIZE;
+    this._pending = new Pending();
+    this._started = false;
+    this._indexed = false;
+}
+util.inherits(DecryptStream, Transform);
+
+DecryptStream.prototype._decrypt = function(len, cb) {
+    if (len === 0) return cb();
+
+    var self = this;
+    this._native.decrypt(this._pending.take(len), this._chunkSize, function(err, raw) {
+        if (err) return cb(err);
+        self.push(raw);
+        cb();
+    });
+};
+
+// The whole chunks pending, the last bytes of an indexed stream are kept back, they may be the trailer
+DecryptStream.prototype._whole = function() {
+    var piece = this._chunkSize + addon.CHUNK_OVERHEAD;
+    var len = this._pending.length - (this._indexed ? addon.INDEX_SIZE : 0);
+    return len > 0 ? len - len % piece : 0;
+};
+
+DecryptStream.prototype._transform = function(chunk, encoding, cb) {
+    var self = this;
+    var size;
+    this._pending.push(chunk);
+
+    if (this._started) {
+        return this._decrypt(this._whole(), cb);
+    }
+
+    if (this._pending.length < 4) return cb();
+
+    size = addon.streamHeaderSize(this._pending.peek(4));
+    if (size < 0) return cb(new Error('Unsupported ECIES stream header'));
+    if (this._pending.length < size) return cb();
+
+    var header = this._pending.take(size);
+    this._native.decryptStart(header, this._priv, function(err) {
+        if (err) return cb(err);
+        self._started = true;
+        self._indexed = header[0] === addon.INDEXED_TAG;
+        self._decrypt(self._whole(), cb);
+    });
+};
+
+DecryptStream.prototype._flush = function(cb) {
+    var self = this;
+    var end = this._indexed ? addon.INDEX_SIZE : 0;
+
+    if (!this._started || this._pending.length < end) return cb(new Error('Truncated ECIES stream'));
+
+    this._decrypt(this._pending.length - end, function(err) {
+        if (err || !self._indexed) return cb(err);
+        if (!self._native.decryptEnd(self._pending.take(end), self._chunkSize)) {
+            return cb(new Error('Invalid ECIES stream index'));
+        }
+        cb();
+    });
+};
+
+// pub: { x, y } public key buffers, 21 bytes each
+exports.createEncryptStream = function(pub, options) {
+    return new EncryptStream(pub, options);
+};
+
+// priv: private key buffer, 21 bytes
+exports.createDecryptStream = function(priv, options) {
+    return new DecryptStream(priv, options);
+};
+
+exports.EncryptStream = EncryptStream;
+exports.DecryptStream = DecryptStream;
@@ -1,8 +1,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "ecc.h"
 #include "hex.h"
+#include "store.h"
 
 #ifndef CHUNKED
 #define CHUNKED 1
@@ -12,6 +20,67 @@
 #define CHUNK_SIZE (8*1024)
 #endif
 
+/* the frames of a framed stream start at FRAME_MIN and grow up to FRAME_BULK */
+#ifndef FRAME_MIN
+#define FRAME_MIN (4*1024)
+#endif
+
+#ifndef FRAME_BULK
+#define FRAME_BULK ECIES_PROFILE_PICK(256*1024, 4*1024*1024, ECIES_FRAME_MAX)
+#endif
+
+#ifndef THREADS
+#define THREADS CHUNKED
+#endif
+
+/* the staging buffer of outputs which cannot be mapped */
+#ifndef IO_BUFFER
+#define IO_BUFFER ECIES_PROFILE_PICK(64*1024, 1024*1024, 4*1024*1024)
+#endif
+
+/* pipes are read ahead and written behind through io_uring, -DURING=0 for plain read(2)/write(2) */
+#ifndef URING
+#ifdef __linux__
+#define URING 1
+#else
+#define URING 0
+#endif
+#endif
+
+#if THREADS
+#include <pthread.h>
+#endif
+
+#if URING
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#endif
+
+/* output encodings */
+#define OUTPUT_BINARY 0
+#define OUTPUT_HEX 1
+#define OUTPUT_BASE64 2
+
+/* the bytes encoded at once, whole base64 groups */
+#define TEXT_BLOCK (48*1024)
+
+typedef struct {
+  const char *input;  /* NULL for stdin */
+  const char *output; /* NULL for stdout */
+  int jobs;           /* 0 for default */
+  int reps;           /* benchmark repetitions */
+  int millis;         /* benchmark time per repetition */
+  int seekable;       /* encrypt with chunk index */
+  int range;          /* decrypt only bytes from..to-1 */
+  uint64_t from, to;
+  int encoding;       /* OUTPUT_BINARY, OUTPUT_HEX or OUTPUT_BASE64 */
+  const char *store;  /* prepared tables of the public keys */
+  int compact;        /* compressed R in the start sequence */
+  int keyed;          /* compressed R and the key ID of the recipient */
+  int framed;         /* chunks of adaptive size, each with its length */
+} options_t;
+
 static int keygen(const char *randomseed){
   char buf[2 * ECIES_KEY_SIZE + 1];
   ECIES_privkey_t priv;
@@ -19,6 +88,7 @@ static int keygen(const char *randomseed){
   
   if(randomseed){
     srandom(atoi(randomseed));
+    ECIES_set_rng(ECIES_rng_libc, NULL); /* reproducible keys from the seed */
   }
   
   ECIES_generate_keys(&priv, &pub);          /* generate a public/private key pair */
@@ -30,251 +100,2261 @@ static int keygen(const char *randomseed){
   return 0;
 }
 
-static const size_t chunk_size = CHUNK_SIZE;
+/*
+ * I/O backend: regular files are mapped, so data is encrypted straight from
+ * the input mapping into the output mapping; pipes and terminals go through
+ * a pair of registered buffers each way, one read ahead and one write behind
+ * in flight on an io_uring while the other buffer is worked on. Without
+ * io_uring they fall back to plain read(2)/write(2), the output batched in a
+ * large staging buffer.
+ *
+ * A pipe has no offsets, so two reads or two writes in flight could complete
+ * out of order: each direction keeps a single operation in flight.
+ */
 
-#if CHUNKED
+#define SIZE_UNKNOWN ((size_t)-1)
 
-static int read_chunk(FILE *stm, char *raw, int len){
-  if(feof(stm)){
-    return 0;
+#if URING
+
+/* a ring with one operation in flight at a time */
+typedef struct {
+  int fd;
+  int fixed;               /* the buffers are registered */
+  int busy;                /* an operation is in flight */
+  void *sq, *cq;
+  size_t sq_size, cq_size;
+  struct io_uring_sqe *sqes;
+  unsigned *sq_tail, *sq_mask, *sq_array;
+  unsigned *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_cqe *cqes;
+} ring_t;
+
+/* set up a ring, with 'bufs' registered when the kernel allows it */
+static int ring_open(ring_t *r, struct iovec *bufs, int n){
+  struct io_uring_params p;
+  void *sqes;
+  
+  memset(r, 0, sizeof(*r));
+  memset(&p, 0, sizeof(p));
+  
+  if((r->fd = syscall(__NR_io_uring_setup, 2, &p)) < 0){
+    return -1;
   }
   
-  len = fread(raw, 1, len, stm);
+  r->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  r->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
   
-  if(len < 0){
-    fprintf(stderr, "Read error\n");
+  if(p.features & IORING_FEAT_SINGLE_MMAP){
+    r->sq_size = r->cq_size = r->sq_size > r->cq_size ? r->sq_size : r->cq_size;
+  }
+  
+  r->sq = mmap(NULL, r->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+  if(r->sq == MAP_FAILED){
+    close(r->fd);
     return -1;
   }
   
-  return len;
+  r->cq = r->sq;
+  if(!(p.features & IORING_FEAT_SINGLE_MMAP)){
+    r->cq = mmap(NULL, r->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+  }
+  
+  sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+  
+  if(r->cq == MAP_FAILED || sqes == MAP_FAILED){
+    if(r->cq != MAP_FAILED && r->cq != r->sq){
+      munmap(r->cq, r->cq_size);
+    }
+    munmap(r->sq, r->sq_size);
+    close(r->fd);
+    return -1;
+  }
+  
+  r->sqes = sqes;
+  r->sq_tail = (unsigned*)((char*)r->sq + p.sq_off.tail);
+  r->sq_mask = (unsigned*)((char*)r->sq + p.sq_off.ring_mask);
+  r->sq_array = (unsigned*)((char*)r->sq + p.sq_off.array);
+  r->cq_head = (unsigned*)((char*)r->cq + p.cq_off.head);
+  r->cq_tail = (unsigned*)((char*)r->cq + p.cq_off.tail);
+  r->cq_mask = (unsigned*)((char*)r->cq + p.cq_off.ring_mask);
+  r->cqes = (struct io_uring_cqe*)((char*)r->cq + p.cq_off.cqes);
+  
+  /* pinning may be refused by the memlock limit, plain reads and writes do without */
+  r->fixed = !syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_BUFFERS, bufs, n);
+  
+  return 0;
 }
 
-#else/*CHUNKED*/
-
-static int read_all(FILE *stm, char **raw){
-  int rbs, end = 0, len = 0;
+/* start reading or writing 'len' bytes at 'buf', registered buffer 'index' */
+static int ring_start(ring_t *r, int fd, int out, ECIES_byte_t *buf, unsigned len, int index){
+  struct io_uring_sqe *sqe;
+  unsigned tail = *r->sq_tail, slot = tail & *r->sq_mask;
+  
+  sqe = &r->sqes[slot];
+  memset(sqe, 0, sizeof(*sqe));
+  
+  if(r->fixed){
+    sqe->opcode = out ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+    sqe->buf_index = index;
+  }else{
+    sqe->opcode = out ? IORING_OP_WRITE : IORING_OP_READ;
+  }
+  sqe->fd = fd;
+  sqe->off = (uint64_t)-1; /* the current position of files, pipes have none */
+  sqe->addr = (uintptr_t)buf;
+  sqe->len = len;
   
-  *raw = NULL;
+  r->sq_array[slot] = slot;
+  __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
   
-  for(; !feof(stm); ){
-    if(end < 1){
-      end += chunk_size;
-      *raw = realloc(*raw, len + end);
+  for(; ; ){
+    if(syscall(__NR_io_uring_enter, r->fd, 1, 0, 0, NULL, 0) == 1){
+      r->busy = 1;
+      return 0;
     }
-    rbs = fread(*raw + len, 1, end, stm);
-    if(rbs < 0){
-      fprintf(stderr, "Read error\n");
+    if(errno != EINTR && errno != EAGAIN){
       return -1;
     }
-    len += rbs;
-    end -= rbs;
   }
-  
-  return len;
 }
 
-#endif/*CHUNKED*/
+/* the operation in flight has completed */
+static int ring_done(const ring_t *r){
+  return *r->cq_head != __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+}
 
-static void write_all(FILE *stm, const char *raw, int len){
-  int wbs, pos = 0;
+/* wait for the operation in flight, its result or -errno */
+static int ring_finish(ring_t *r){
+  unsigned head = *r->cq_head;
+  int res;
   
-  for(; len > 0; ){
-    wbs = fwrite(raw + pos, 1, len, stm);
-    if(wbs < 0){
-      fprintf(stderr, "Write error\n");
+  while(!ring_done(r)){
+    if(syscall(__NR_io_uring_enter, r->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR){
+      return -errno;
     }
-    pos += wbs;
-    len -= wbs;
   }
+  
+  res = r->cqes[head & *r->cq_mask].res;
+  __atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+  r->busy = 0;
+  
+  return res;
+}
+
+/* closing the ring cancels what is still in flight */
+static void ring_close(ring_t *r){
+  if(r->cq != r->sq){
+    munmap(r->cq, r->cq_size);
+  }
+  munmap(r->sq, r->sq_size);
+  close(r->fd);
 }
 
-static int encrypt(const char *pubkey){
-  ECIES_pubkey_t public = {
-    { 0x01, 0xc5, 0x6d, 0x30, 0x2c, 0xf6, 0x42, 0xa8, 0xe1, 0xba, 0x4b, 0x48, 0xcc, 0x4f, 0xbe, 0x28, 0x45, 0xee, 0x32, 0xdc, 0xe7 },
-    { 0x04, 0x5f, 0x46, 0xeb, 0x30, 0x3e, 0xdf, 0x2e, 0x62, 0xf7, 0x4b, 0xd6, 0x83, 0x68, 0xd9, 0x79, 0xe2, 0x65, 0xee, 0x3c, 0x03 },
-  };
+#endif/*URING*/
+
+typedef struct {
+  int fd;
+  const ECIES_byte_t *map; /* the whole file when mapped */
+  size_t size, pos;
+  size_t end;              /* the end of data in the mapping, a trailer may follow */
+  int eof;
+#if URING
+  ring_t ring;             /* reads ahead into ahead[cur ^ 1] while ahead[cur] is consumed */
+  int uring;
+  ECIES_byte_t *ahead[2];
+  int cur;
+  size_t have, used;       /* the bytes in ahead[cur] and those consumed */
+#endif
+} input_t;
+
+typedef struct {
+  int fd;
+  ECIES_byte_t *buf;       /* the whole file when mapped, else the staging buffer */
+  size_t size, pos;
+  int mapped;
+  int encoding;            /* text outputs are staged, encoded on flush */
+  char *text;
+#if URING
+  ring_t ring;             /* writes stage[cur ^ 1] behind while 'buf', stage[cur], is filled */
+  int uring;
+  ECIES_byte_t *stage[2];
+  int cur;
+  size_t pending;          /* the bytes in flight */
+#endif
+} output_t;
+
+#if URING
+
+/* read ahead into the spare buffer */
+static int input_ahead(input_t *in){
+  if(ring_start(&in->ring, in->fd, 0, in->ahead[in->cur ^ 1], IO_BUFFER, in->cur ^ 1) < 0){
+    fprintf(stderr, "Read error\n");
+    return -1;
+  }
   
-  if(pubkey){
-    int r = hex_load(public.x, ECIES_KEY_SIZE, pubkey);
-    if(0 > r){
-      fprintf(stderr, "Invalid public key x\n");
-      return 1;
-    }
-    if(0 > hex_load(public.y, ECIES_KEY_SIZE, pubkey + r + 1)){
-      fprintf(stderr, "Invalid public key y\n");
-      return 1;
+  return 0;
+}
+
+/* the pipe is read through a ring when one can be set up, else with read(2) */
+static void input_uring(input_t *in){
+  struct iovec bufs[2];
+  int i;
+  
+  for(i = 0; i < 2; i++){
+    if(!(in->ahead[i] = malloc(IO_BUFFER))){
+      return;
     }
+    bufs[i].iov_base = in->ahead[i];
+    bufs[i].iov_len = IO_BUFFER;
+  }
+  
+  if(ring_open(&in->ring, bufs, 2) < 0){
+    return;
+  }
+  
+  in->uring = 1;
+  
+  if(input_ahead(in) < 0){
+    ring_close(&in->ring);
+    in->uring = 0;
   }
+}
 
-#if CHUNKED
-  {
-    ECIES_stream_t stm;
-    
-    {
-      ECIES_byte_t enc[ECIES_START_OVERHEAD];
-      
-      ECIES_encrypt_start(&stm, enc, &public);
-      
-      write_all(stdout, (const char*)enc, ECIES_START_OVERHEAD);
+/* wait for the read ahead and start the next one, 0 at the end of input */
+static int input_next(input_t *in){
+  int res;
+  
+  for(; ; ){
+    res = ring_finish(&in->ring);
+    if(res != -EINTR && res != -EAGAIN){
+      break;
     }
-    
-    {
-      ECIES_byte_t enc[CHUNK_SIZE + ECIES_CHUNK_OVERHEAD];
-      int len;
-      
-      for(; ;){
-        len = read_chunk(stdin, (char*)enc, CHUNK_SIZE);
+    if(input_ahead(in) < 0){
+      return -1;
+    }
+  }
+  
+  if(res < 0){
+    fprintf(stderr, "Read error\n");
+    return -1;
+  }
+  
+  if(res == 0){
+    in->eof = 1;
+    return 0;
+  }
+  
+  in->cur ^= 1;
+  in->have = res;
+  in->used = 0;
+  
+  return input_ahead(in) < 0 ? -1 : res;
+}
 
-        if(len == 0){
-          break; /*eof*/
-        }
-        
-        if(len < 0){
-          return -1;
-        }
-        
-        ECIES_encrypt_chunk(&stm, enc, len);
-        
-        write_all(stdout, (const char*)enc, len + ECIES_CHUNK_OVERHEAD);
+/* copy up to len bytes, less when 'ready' is set and the input has to wait */
+static int input_copy(input_t *in, ECIES_byte_t *buf, int len, int ready){
+  int n, pos = 0;
+  
+  for(; pos < len; pos += n){
+    if(in->used == in->have){
+      if(in->eof || (ready && pos > 0 && !ring_done(&in->ring))){
+        break;
+      }
+      if((n = input_next(in)) < 0){
+        return -1;
+      }
+      if(n == 0){
+        break;
       }
     }
+    n = in->have - in->used < (size_t)(len - pos) ? (int)(in->have - in->used) : len - pos;
+    memcpy(buf + pos, in->ahead[in->cur] + in->used, n);
+    in->used += n;
   }
-#else/*CHUNKED*/
-  {
-    int raw_len, enc_len;
-    char *raw;
-    ECIES_byte_t *enc;
-    
-    raw_len = read_all(stdin, &raw);
+  
+  return pos;
+}
 
-    if(raw_len < 0){
-      return -1;
+#endif/*URING*/
+
+static int input_open(input_t *in, const char *path){
+  struct stat st;
+  void *map;
+  
+  memset(in, 0, sizeof(*in));
+  
+  in->fd = path ? open(path, O_RDONLY) : 0;
+  
+  if(in->fd < 0){
+    fprintf(stderr, "Cannot open %s\n", path);
+    return -1;
+  }
+  
+  if(!fstat(in->fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0){
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, in->fd, 0);
+    if(map != MAP_FAILED){
+      madvise(map, st.st_size, MADV_SEQUENTIAL);
+      in->map = map;
+      in->size = in->end = st.st_size;
     }
-    
-    enc_len = raw_len + ECIES_OVERHEAD;
-    enc = malloc(enc_len);
-    
-    ECIES_encrypt(enc, raw, raw_len, &public);
-    
-    free(raw);
-    
-    write_all(stdout, (const char*)enc, enc_len);
-    
-    free(enc);
   }
-#endif/*CHUNKED*/
+  
+#if URING
+  if(!in->map){
+    input_uring(in);
+  }
+#endif
   
   return 0;
 }
 
-static int decrypt(const char *privkey){
-  ECIES_privkey_t private = {
-    { 0x00, 0xe1, 0x0e, 0x78, 0x70, 0x36, 0x94, 0x1e, 0x6c, 0x78, 0xda, 0xf8, 0xa0, 0xe8, 0xe1, 0xdb, 0xfa, 0xc6, 0x8e, 0x26, 0xd2 },
-  };
+#if CHUNKED
+
+/* the input size, SIZE_UNKNOWN for streams */
+static size_t input_size(const input_t *in){
+  return in->map ? in->end : SIZE_UNKNOWN;
+}
+
+#endif/*CHUNKED*/
+
+/* read up to len bytes, less only at the end of input */
+static int input_read(input_t *in, ECIES_byte_t *buf, int len){
+  ssize_t rbs;
+  int pos = 0;
   
-  if(privkey){
-    if(0 > hex_load(private.k, ECIES_KEY_SIZE, privkey)){
-      fprintf(stderr, "Invalid private key\n");
-      return 1;
+  if(in->map){
+    if((size_t)len > in->end - in->pos){
+      len = in->end - in->pos;
+    }
+    memcpy(buf, in->map + in->pos, len);
+    in->pos += len;
+    return len;
+  }
+  
+#if URING
+  if(in->uring){
+    return input_copy(in, buf, len, 0);
+  }
+#endif
+  
+  for(; pos < len && !in->eof; ){
+    rbs = read(in->fd, buf + pos, len - pos);
+    if(rbs < 0){
+      if(errno == EINTR){
+        continue;
+      }
+      fprintf(stderr, "Read error\n");
+      return -1;
+    }
+    if(rbs == 0){
+      in->eof = 1;
     }
+    pos += rbs;
   }
+  
+  return pos;
+}
 
 #if CHUNKED
-  {
-    ECIES_stream_t stm;
-    
-    {
-      ECIES_byte_t enc[ECIES_START_OVERHEAD];
-      int len;
-      
-      len = read_chunk(stdin, (char*)enc, ECIES_START_OVERHEAD);
-      
-      if(len < ECIES_START_OVERHEAD){
-        return -1;
-      }
-      
-      len = ECIES_decrypt_start(&stm, enc, &private);
-      
-      if(len < 0){
-        return len;
+
+/* more input can be read without waiting; at the end of input read returns at once */
+static int input_ready(const input_t *in){
+  struct pollfd pfd;
+  
+  if(in->map || in->eof){
+    return 1;
+  }
+  
+#if URING
+  if(in->uring){
+    return in->used < in->have || ring_done(&in->ring);
+  }
+#endif
+  
+  pfd.fd = in->fd;
+  pfd.events = POLLIN;
+  
+  return poll(&pfd, 1, 0) > 0;
+}
+
+/* read up to len bytes, less when the input has to wait for more, so an interactive stream isn't held back */
+static int input_read_ready(input_t *in, ECIES_byte_t *buf, int len){
+  ssize_t rbs;
+  int pos = 0;
+  
+  if(in->map){
+    return input_read(in, buf, len);
+  }
+  
+#if URING
+  if(in->uring){
+    return input_copy(in, buf, len, 1);
+  }
+#endif
+  
+  for(; pos < len && !in->eof; ){
+    rbs = read(in->fd, buf + pos, len - pos);
+    if(rbs < 0){
+      if(errno == EINTR){
+        continue;
       }
+      fprintf(stderr, "Read error\n");
+      return -1;
     }
-    
-    {
-      ECIES_byte_t enc[CHUNK_SIZE + ECIES_CHUNK_OVERHEAD];
-      int len;
-      
-      for(; ;){
-        len = read_chunk(stdin, (char*)enc, CHUNK_SIZE + ECIES_CHUNK_OVERHEAD);
-        
-        if(len == 0){
-          break; /*eof*/
-        }
-        
-        if(len < ECIES_CHUNK_OVERHEAD){
-          return -1;
-        }
-        
-        ECIES_decrypt_chunk(&stm, enc, len - ECIES_CHUNK_OVERHEAD);
-        
-        write_all(stdout, (const char*)enc, len - ECIES_CHUNK_OVERHEAD);
-      }
+    if(rbs == 0){
+      in->eof = 1;
+    }
+    pos += rbs;
+    if(pos < len && !input_ready(in)){
+      break;
     }
   }
-#else/*CHUNKED*/
-  {
-    int raw_len, enc_len, res;
-    char *raw;
-    ECIES_byte_t *enc;
-    
-    enc_len = read_all(stdin, (char**)&enc);
-    
-    if(enc_len < 0){
+  
+  return pos;
+}
+
+#endif/*CHUNKED*/
+
+#if !CHUNKED
+
+/* the whole input: the mapping itself, or a heap copy returned in 'heap' too */
+static int input_all(input_t *in, const ECIES_byte_t **raw, ECIES_byte_t **heap){
+  size_t end = IO_BUFFER;
+  int rbs, len = 0;
+  
+  *heap = NULL;
+  
+  if(in->map){
+    *raw = in->map;
+    return in->size;
+  }
+  
+  for(; ; ){
+    *heap = realloc(*heap, end);
+    rbs = input_read(in, *heap + len, end - len);
+    if(rbs < 0){
       return -1;
     }
-    
-    raw_len = enc_len - ECIES_OVERHEAD;
-    raw = malloc(raw_len);
-    
-    if((res = ECIES_decrypt(raw, raw_len, enc, &private)) < 0){
-      fprintf(stderr, "Decryption failed %d\n", res);
-      
-      free(raw);
-      free(enc);
-      
-      return 1;
+    len += rbs;
+    if((size_t)len < end){
+      break;
     }
-    
-    free(enc);
-    
-    write_all(stdout, raw, raw_len);
-    
-    free(raw);
+    end *= 2;
+  }
+  
+  *raw = *heap;
+  
+  return len;
+}
+
+#endif/*!CHUNKED*/
+
+static void input_close(input_t *in){
+  if(in->map){
+    munmap((void*)in->map, in->size);
+  }
+#if URING
+  if(in->uring){
+    ring_close(&in->ring);
+  }
+  free(in->ahead[0]);
+  free(in->ahead[1]);
+#endif
+  if(in->fd > 0){
+    close(in->fd);
+  }
+}
+
+static int write_fd(int fd, const ECIES_byte_t *raw, size_t len){
+  ssize_t wbs;
+  
+  for(; len > 0; ){
+    wbs = write(fd, raw, len);
+    if(wbs < 0){
+      if(errno == EINTR){
+        continue;
+      }
+      fprintf(stderr, "Write error\n");
+      return -1;
+    }
+    raw += wbs;
+    len -= wbs;
   }
-#endif/*CHUNKED*/
   
   return 0;
 }
 
-int main(int argc, const char *argv[]){
-  if(argc < 2) goto usage;
+#if URING
+
+/* a binary stream is written behind through a ring when one can be set up */
+static void output_uring(output_t *out){
+  struct iovec bufs[2];
   
-  switch(argv[1][0]){
-  case 'k':
-    return keygen(argc > 2 ? argv[2] : NULL);
-  case 'e':
-    return encrypt(argv[2]);
-  case 'd':
-    return decrypt(argv[2]);
-  default:
-    goto usage;
+  if(!(out->stage[1] = malloc(out->size))){
+    return;
   }
+  out->stage[0] = out->buf;
   
+  bufs[0].iov_base = out->stage[0];
+  bufs[1].iov_base = out->stage[1];
+  bufs[0].iov_len = bufs[1].iov_len = out->size;
+  
+  if(ring_open(&out->ring, bufs, 2) < 0){
+    free(out->stage[1]);
+    out->stage[1] = NULL;
+    return;
+  }
+  
+  out->uring = 1;
+}
+
+/* wait for the write behind, the rest of a short write goes out with write(2) */
+static int output_wait(output_t *out){
+  int res;
+  
+  if(!out->ring.busy){
+    return 0;
+  }
+  
+  res = ring_finish(&out->ring);
+  
+  if(res < 0 && res != -EINTR && res != -EAGAIN){
+    fprintf(stderr, "Write error\n");
+    return -1;
+  }
+  
+  res = res > 0 ? res : 0;
+  
+  if(write_fd(out->fd, out->stage[out->cur ^ 1] + res, out->pending - res) < 0){
+    return -1;
+  }
+  
+  out->pending = 0;
+  
+  return 0;
+}
+
+/* back to write(2), so the staging buffer can grow */
+static int output_plain(output_t *out){
+  int res = output_wait(out);
+  
+  ring_close(&out->ring);
+  free(out->stage[out->cur ^ 1]);
+  out->uring = 0;
+  
+  return res;
+}
+
+/* start writing the staged bytes and stage into the other buffer */
+static int output_behind(output_t *out){
+  if(output_wait(out) < 0){
+    return -1;
+  }
+  
+  if(ring_start(&out->ring, out->fd, 1, out->buf, out->pos, out->cur) < 0){
+    /* the entry may still sit in the ring, which must not submit it later */
+    output_plain(out);
+    if(write_fd(out->fd, out->buf, out->pos) < 0){
+      return -1;
+    }
+    out->pos = 0;
+    return 0;
+  }
+  
+  out->pending = out->pos;
+  out->cur ^= 1;
+  out->buf = out->stage[out->cur];
+  out->pos = 0;
+  
+  return 0;
+}
+
+#endif/*URING*/
+
+/* a named binary output of known size is mapped, anything else is staged */
+static int output_open(output_t *out, const options_t *opt, size_t size){
+  const char *path = opt->output;
+  void *map;
+  
+  memset(out, 0, sizeof(*out));
+  
+  out->fd = path ? open(path, O_RDWR | O_CREAT | O_TRUNC, 0644) : 1;
+  
+  if(out->fd < 0){
+    fprintf(stderr, "Cannot open %s\n", path);
+    return -1;
+  }
+  
+  if(opt->encoding != OUTPUT_BINARY){
+    out->encoding = opt->encoding;
+    if(!(out->text = malloc(HEX_SIZE(TEXT_BLOCK)))){
+      return -1;
+    }
+  }else if(path && size != SIZE_UNKNOWN && size > 0 && !ftruncate(out->fd, size)){
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, out->fd, 0);
+    if(map != MAP_FAILED){
+      out->buf = map;
+      out->size = size;
+      out->mapped = 1;
+      return 0;
+    }
+  }
+  
+  out->size = IO_BUFFER;
+  
+  if(!(out->buf = malloc(out->size))){
+    return -1;
+  }
+  
+#if URING
+  if(out->encoding == OUTPUT_BINARY){
+    output_uring(out);
+  }
+#endif
+  
+  return 0;
+}
+
+/* base64 is encoded in whole groups, the rest waits for more data or the last flush */
+static int output_encode(output_t *out, int last){
+  size_t len = out->pos, off, n, chars;
+  
+  if(!last && out->encoding == OUTPUT_BASE64){
+    len -= len % 3;
+  }
+  
+  for(off = 0; off < len; off += n){
+    n = len - off < TEXT_BLOCK ? len - off : TEXT_BLOCK;
+    
+    if(out->encoding == OUTPUT_HEX){
+      chars = hex_encode(out->text, out->buf + off, n);
+    }else{
+      chars = base64_encode(out->text, out->buf + off, n);
+    }
+    
+    if(write_fd(out->fd, (const ECIES_byte_t*)out->text, chars) < 0){
+      return -1;
+    }
+  }
+  
+  memmove(out->buf, out->buf + len, out->pos - len);
+  out->pos -= len;
+  
+  return last ? write_fd(out->fd, (const ECIES_byte_t*)"\n", 1) : 0;
+}
+
+static int output_flush(output_t *out){
+  if(out->mapped || out->pos == 0){
+    return 0;
+  }
+  
+  if(out->encoding != OUTPUT_BINARY){
+    return output_encode(out, 0);
+  }
+  
+#if URING
+  if(out->uring){
+    return output_behind(out);
+  }
+#endif
+  
+  if(write_fd(out->fd, out->buf, out->pos) < 0){
+    return -1;
+  }
+  
+  out->pos = 0;
+  
+  return 0;
+}
+
+/* room for len more bytes, filled in place and then committed */
+static ECIES_byte_t *output_reserve(output_t *out, size_t len){
+  if(out->size - out->pos < len){
+    if(out->mapped){
+      fprintf(stderr, "Output size mismatch\n");
+      return NULL;
+    }
+    if(output_flush(out) < 0){
+      return NULL;
+    }
+    /* a base64 flush may leave a partial group behind */
+    if(out->size - out->pos < len){
+#if URING
+      if(out->uring && output_plain(out) < 0){
+        return NULL;
+      }
+#endif
+      out->size = out->pos + len;
+      if(!(out->buf = realloc(out->buf, out->size))){
+        fprintf(stderr, "Out of memory\n");
+        return NULL;
+      }
+    }
+  }
+  
+  return out->buf + out->pos;
+}
+
+static void output_commit(output_t *out, size_t len){
+  out->pos += len;
+}
+
+#if CHUNKED
+
+static int output_write(output_t *out, const ECIES_byte_t *raw, size_t len){
+  ECIES_byte_t *dst = output_reserve(out, len);
+  
+  if(!dst){
+    return -1;
+  }
+  
+  memcpy(dst, raw, len);
+  output_commit(out, len);
+  
+  return 0;
+}
+
+#endif/*CHUNKED*/
+
+/* a mapped output is cut to what was actually written */
+static int output_close(output_t *out){
+  int res = out->encoding != OUTPUT_BINARY ? output_encode(out, 1) : output_flush(out);
+  
+#if URING
+  if(out->uring && output_plain(out) < 0){
+    res = -1;
+  }
+#endif
+  
+  if(out->mapped){
+    munmap(out->buf, out->size);
+    if(ftruncate(out->fd, out->pos) < 0){
+      res = -1;
+    }
+  }else{
+    free(out->buf);
+  }
+  
+  free(out->text);
+  
+  if(out->fd != 1){
+    close(out->fd);
+  }
+  
+  return res;
+}
+
+#if CHUNKED
+
+/* the output size of a chunked stream with a start sequence of 'start' bytes, SIZE_UNKNOWN when the input size is unknown */
+static size_t chunked_size(size_t size, size_t start, int decrypt){
+  size_t chunks;
+  
+  if(size == SIZE_UNKNOWN){
+    return SIZE_UNKNOWN;
+  }
+  
+  if(!decrypt){
+    chunks = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    return start + size + chunks * ECIES_CHUNK_OVERHEAD;
+  }
+  
+  if(size < start){
+    return SIZE_UNKNOWN;
+  }
+  
+  size -= start;
+  chunks = (size + CHUNK_SIZE + ECIES_CHUNK_OVERHEAD - 1) / (CHUNK_SIZE + ECIES_CHUNK_OVERHEAD);
+  
+  return size < chunks * ECIES_CHUNK_OVERHEAD ? SIZE_UNKNOWN : size - chunks * ECIES_CHUNK_OVERHEAD;
+}
+
+/* the output size of a framed stream, a known input size is encrypted in FRAME_BULK frames and the empty one */
+static size_t framed_size(size_t size, size_t start){
+  size_t frames;
+  
+  if(size == SIZE_UNKNOWN){
+    return SIZE_UNKNOWN;
+  }
+  
+  frames = (size + FRAME_BULK - 1) / FRAME_BULK + 1;
+  
+  return start + size + frames * ECIES_FRAME_OVERHEAD;
+}
+
+/*
+ * Frames double in size while the input keeps them full, up to FRAME_BULK, and
+ * drop back to FRAME_MIN as soon as the input has to wait, when what there is
+ * goes out at once. A file is bulk from its first frame.
+ */
+static int encrypt_frames(const ECIES_stream_t *stm, input_t *in, output_t *out){
+  ECIES_byte_t *enc;
+  ECIES_size_t index;
+  size_t room;
+  int len, size = in->map ? FRAME_BULK : FRAME_MIN;
+  
+  for(index = 0; ; index++){
+    room = size + ECIES_FRAME_OVERHEAD;
+    if(out->mapped && out->size - out->pos < room){
+      room = out->size - out->pos;
+    }
+    
+    if(room < ECIES_FRAME_OVERHEAD || !(enc = output_reserve(out, room))){
+      fprintf(stderr, "Output size mismatch\n");
+      return -1;
+    }
+    
+    /* read straight into the output, the frame is encrypted in place */
+    if((len = input_read_ready(in, enc + ECIES_FRAME_HEADER, room - ECIES_FRAME_OVERHEAD)) < 0){
+      return -1;
+    }
+    
+    ECIES_encrypt_frame(stm, index, enc, len);
+    output_commit(out, len + ECIES_FRAME_OVERHEAD);
+    
+    if(len == 0){
+      return 0; /* the empty frame ends the stream */
+    }
+    
+    if(len == size){
+      size = size < FRAME_BULK / 2 ? size * 2 : FRAME_BULK;
+    }else if(!in->eof){
+      size = FRAME_MIN;
+      if(output_flush(out) < 0){
+        return -1;
+      }
+    }
+  }
+}
+
+#endif/*CHUNKED*/
+
+#if THREADS
+
+/*
+ * Parallel chunk pipeline: the calling thread reads chunks into a ring of
+ * slots, the workers encrypt or decrypt them in any order, and the writer
+ * thread emits them strictly in sequence, so the output is the same as the
+ * one of the sequential loop.
+ */
+
+#define SLOT_FREE 0
+#define SLOT_READ 1
+#define SLOT_DONE 2
+
+typedef struct {
+  ECIES_byte_t data[CHUNK_SIZE + ECIES_CHUNK_OVERHEAD];
+  int len;
+  int state;
+  int bad;             /* the MAC did not match */
+  ECIES_size_t index;  /* the chunk position in the stream */
+} slot_t;
+
+typedef struct {
+  const ECIES_stream_t *stm;
+  output_t *out;
+  int decrypt, indexed;
+  slot_t *slots;
+  unsigned long nslots;
+  unsigned long nread, next, nwritten; /* chunks read, taken by workers, written */
+  uint64_t length;                     /* raw bytes read */
+  int eof, failed;
+  int stopped;                         /* a bad chunk or a failed write was reached, nothing more is written */
+  pthread_mutex_t lock;
+  pthread_cond_t space, work, done;
+} pipeline_t;
+
+static void *pipeline_worker(void *arg){
+  pipeline_t *p = arg;
+  slot_t *slot;
+  int res;
+  
+  for(; ;){
+    pthread_mutex_lock(&p->lock);
+    while(p->next == p->nread && !p->eof){
+      pthread_cond_wait(&p->work, &p->lock);
+    }
+    if(p->next == p->nread){
+      pthread_mutex_unlock(&p->lock);
+      return NULL;
+    }
+    slot = &p->slots[p->next++ % p->nslots];
+    pthread_mutex_unlock(&p->lock);
+    
+    res = 1;
+    
+    if(p->decrypt && p->indexed){
+      res = ECIES_decrypt_chunk_at(p->stm, slot->index, slot->data, slot->len - ECIES_CHUNK_OVERHEAD);
+    }else if(p->decrypt){
+      res = ECIES_decrypt_chunk(p->stm, slot->data, slot->len - ECIES_CHUNK_OVERHEAD);
+    }else if(p->indexed){
+      ECIES_encrypt_chunk_at(p->stm, slot->index, slot->data, slot->len);
+    }else{
+      ECIES_encrypt_chunk(p->stm, slot->data, slot->len);
+    }
+    
+    pthread_mutex_lock(&p->lock);
+    if(res < 0){
+      fprintf(stderr, "Chunk %u is corrupted\n", slot->index);
+      p->failed = 1;
+    }
+    slot->bad = res < 0;
+    slot->state = SLOT_DONE;
+    pthread_cond_signal(&p->done);
+    pthread_mutex_unlock(&p->lock);
+  }
+}
+
+static void *pipeline_writer(void *arg){
+  pipeline_t *p = arg;
+  slot_t *slot;
+  int res;
+  
+  for(; ;){
+    pthread_mutex_lock(&p->lock);
+    slot = &p->slots[p->nwritten % p->nslots];
+    while(slot->state != SLOT_DONE && !(p->eof && p->nwritten == p->nread)){
+      pthread_cond_wait(&p->done, &p->lock);
+    }
+    if(slot->state != SLOT_DONE){
+      pthread_mutex_unlock(&p->lock);
+      return NULL;
+    }
+    /* the output ends where the sequential loop would stop, before the first bad chunk */
+    if(slot->bad){
+      p->stopped = 1;
+    }
+    res = p->stopped ? 0 : 1;
+    pthread_mutex_unlock(&p->lock);
+    
+    if(res > 0){
+      res = output_write(p->out, slot->data, p->decrypt ? slot->len - ECIES_CHUNK_OVERHEAD : slot->len + ECIES_CHUNK_OVERHEAD);
+    }
+    
+    pthread_mutex_lock(&p->lock);
+    if(res < 0){
+      p->failed = 1;
+      p->stopped = 1;
+    }
+    slot->state = SLOT_FREE;
+    p->nwritten++;
+    pthread_cond_signal(&p->space);
+    pthread_mutex_unlock(&p->lock);
+  }
+}
+
+/* indexed chunks are numbered from 0, the raw length goes to 'length' */
+static int pipeline_run(const ECIES_stream_t *stm, input_t *in, output_t *out, int decrypt, int indexed, int jobs, uint64_t *length){
+  pipeline_t p;
+  pthread_t *threads;
+  slot_t *slot;
+  int i, len, res = 0;
+  int size = decrypt ? CHUNK_SIZE + ECIES_CHUNK_OVERHEAD : CHUNK_SIZE;
+  
+  memset(&p, 0, sizeof(p));
+  p.stm = stm;
+  p.out = out;
+  p.decrypt = decrypt;
+  p.indexed = indexed;
+  p.nslots = 4 * jobs; /* enough to keep every worker busy while the writer lags */
+  p.slots = calloc(p.nslots, sizeof(slot_t));
+  threads = calloc(jobs + 1, sizeof(pthread_t));
+  
+  if(!p.slots || !threads){
+    fprintf(stderr, "Out of memory\n");
+    free(p.slots);
+    free(threads);
+    return -1;
+  }
+  
+  pthread_mutex_init(&p.lock, NULL);
+  pthread_cond_init(&p.space, NULL);
+  pthread_cond_init(&p.work, NULL);
+  pthread_cond_init(&p.done, NULL);
+  
+  for(i = 0; i < jobs; i++){
+    pthread_create(&threads[i], NULL, pipeline_worker, &p);
+  }
+  pthread_create(&threads[jobs], NULL, pipeline_writer, &p);
+  
+  for(; ;){
+    slot = &p.slots[p.nread % p.nslots];
+    
+    pthread_mutex_lock(&p.lock);
+    while(slot->state != SLOT_FREE){
+      pthread_cond_wait(&p.space, &p.lock);
+    }
+    res = p.failed ? -1 : 0;
+    pthread_mutex_unlock(&p.lock);
+    
+    if(res < 0){
+      break;
+    }
+    
+    len = input_read(in, slot->data, size);
+    
+    if(len == 0){
+      break; /*eof*/
+    }
+    
+    if(len < 0 || (decrypt && len < ECIES_CHUNK_OVERHEAD)){
+      res = -1;
+      break;
+    }
+    
+    slot->len = len;
+    slot->index = p.nread;
+    p.length += decrypt ? len - ECIES_CHUNK_OVERHEAD : len;
+    
+    pthread_mutex_lock(&p.lock);
+    slot->state = SLOT_READ;
+    p.nread++;
+    pthread_cond_signal(&p.work);
+    pthread_mutex_unlock(&p.lock);
+  }
+  
+  pthread_mutex_lock(&p.lock);
+  p.eof = 1;
+  pthread_cond_broadcast(&p.work);
+  pthread_cond_broadcast(&p.done);
+  pthread_mutex_unlock(&p.lock);
+  
+  for(i = 0; i <= jobs; i++){
+    pthread_join(threads[i], NULL);
+  }
+  
+  if(p.failed){
+    res = -1;
+  }
+  
+  *length = p.length;
+  
+  pthread_cond_destroy(&p.done);
+  pthread_cond_destroy(&p.work);
+  pthread_cond_destroy(&p.space);
+  pthread_mutex_destroy(&p.lock);
+  free(p.slots);
+  free(threads);
+  
+  return res;
+}
+
+#endif/*THREADS*/
+
+/* the stored tables of all keys, 0 when any of them isn't stored */
+static int store_lookup(const ECIES_store_t *store, const ECIES_pubkey_table_t **tabs, const ECIES_pubkey_t *public, ECIES_size_t n){
+  ECIES_size_t i;
+  
+  for(i = 0; store && i < n; i++){
+    if(!(tabs[i] = ECIES_store_lookup(store, &public[i]))){
+      return 0;
+    }
+  }
+  
+  return store != NULL;
+}
+
+/* more than one key encrypts for many recipients */
+static int encrypt_io(input_t *in, output_t *out, const options_t *opt, const ECIES_pubkey_t *public, ECIES_size_t n,
+                      const ECIES_pubkey_table_t **tabs){
+#if CHUNKED
+  ECIES_stream_t stm;
+  ECIES_byte_t *enc;
+  size_t room, size, start = n > 1 ? ECIES_MULTI_START_OVERHEAD(n) :
+                             opt->keyed ? ECIES_KEYED_START_OVERHEAD :
+                             opt->compact ? ECIES_COMPACT_START_OVERHEAD : ECIES_START_OVERHEAD;
+  uint64_t length = 0;
+  ECIES_size_t index;
+  int len;
+  
+  if(opt->seekable && opt->framed){
+    fprintf(stderr, "Seekable streams have chunks of one size\n");
+    return -1;
+  }
+  
+  /* a seekable stream is tagged and ends with the chunk index, a framed one is tagged */
+  if(opt->seekable || opt->framed){
+    start++;
+  }
+  
+  size = opt->framed ? framed_size(input_size(in), start) : chunked_size(input_size(in), start, 0);
+  
+  if(opt->seekable && size != SIZE_UNKNOWN){
+    size += ECIES_INDEX_SIZE;
+  }
+  
+  if(output_open(out, opt, size) < 0){
+    return -1;
+  }
+  
+  if(!(enc = output_reserve(out, start))){
+    return -1;
+  }
+  
+  if(opt->seekable){
+    *enc++ = ECIES_INDEXED_TAG;
+  }else if(opt->framed){
+    *enc++ = ECIES_FRAMED_TAG;
+  }
+  
+  if(n > 1 && tabs){
+    ECIES_encrypt_start_multi_prepared(&stm, enc, tabs, n);
+  }else if(n > 1){
+    ECIES_encrypt_start_multi(&stm, enc, public, n);
+  }else if(tabs && opt->keyed){
+    ECIES_encrypt_start_keyed_prepared(&stm, enc, tabs[0]);
+  }else if(tabs && opt->compact){
+    ECIES_encrypt_start_compact_prepared(&stm, enc, tabs[0]);
+  }else if(tabs){
+    ECIES_encrypt_start_prepared(&stm, enc, tabs[0]);
+  }else if(opt->keyed){
+    ECIES_encrypt_start_keyed(&stm, enc, public);
+  }else if(opt->compact){
+    ECIES_encrypt_start_compact(&stm, enc, public);
+  }else{
+    ECIES_encrypt_start(&stm, enc, public);
+  }
+  output_commit(out, start);
+  
+  if(opt->framed){
+    return encrypt_frames(&stm, in, out);
+  }
+
+#if THREADS
+  if(opt->jobs > 1){
+    if(pipeline_run(&stm, in, out, 0, opt->seekable, opt->jobs, &length) < 0){
+      return -1;
+    }
+    goto trailer;
+  }
+#endif
+
+  for(index = 0; ; index++){
+    /* read straight into the output, the chunk is encrypted in place */
+    room = CHUNK_SIZE + ECIES_CHUNK_OVERHEAD;
+    if(out->mapped && out->size - out->pos < room){
+      room = out->size - out->pos;
+    }
+    
+    if(!(enc = output_reserve(out, room))){
+      return -1;
+    }
+    
+    len = input_read(in, enc, room > ECIES_CHUNK_OVERHEAD ? room - ECIES_CHUNK_OVERHEAD : 0);
+    
+    if(len == 0){
+      break; /*eof*/
+    }
+    
+    if(len < 0){
+      return -1;
+    }
+    
+    if(opt->seekable){
+      ECIES_encrypt_chunk_at(&stm, index, enc, len);
+    }else{
+      ECIES_encrypt_chunk(&stm, enc, len);
+    }
+    output_commit(out, len + ECIES_CHUNK_OVERHEAD);
+    length += len;
+  }
+
+#if THREADS
+ trailer:
+#endif
+  if(opt->seekable){
+    if(!(enc = output_reserve(out, ECIES_INDEX_SIZE))){
+      return -1;
+    }
+    ECIES_index_encode(&stm, enc, CHUNK_SIZE, length);
+    output_commit(out, ECIES_INDEX_SIZE);
+  }
+#else/*CHUNKED*/
+  const ECIES_byte_t *raw;
+  ECIES_byte_t *heap, *enc;
+  int raw_len, overhead = n > 1 ? ECIES_MULTI_START_OVERHEAD(n) + ECIES_CHUNK_OVERHEAD :
+                         opt->keyed ? ECIES_KEYED_OVERHEAD :
+                         opt->compact ? ECIES_COMPACT_OVERHEAD : ECIES_OVERHEAD;
+  
+  if(opt->seekable || opt->framed){
+    fprintf(stderr, "Seekable and framed streams are chunked\n");
+    return -1;
+  }
+  
+  raw_len = input_all(in, &raw, &heap);
+  
+  if(raw_len < 0 || output_open(out, opt, raw_len + overhead) < 0){
+    free(heap);
+    return -1;
+  }
+  
+  if(!(enc = output_reserve(out, raw_len + overhead))){
+    free(heap);
+    return -1;
+  }
+  
+  if(n > 1){
+    ECIES_encrypt_multi(enc, (const char*)raw, raw_len, public, n);
+  }else if(tabs && opt->keyed){
+    ECIES_encrypt_keyed_prepared(enc, (const char*)raw, raw_len, tabs[0]);
+  }else if(tabs && opt->compact){
+    ECIES_encrypt_compact_prepared(enc, (const char*)raw, raw_len, tabs[0]);
+  }else if(tabs){
+    ECIES_encrypt_prepared(enc, (const char*)raw, raw_len, tabs[0]);
+  }else if(opt->keyed){
+    ECIES_encrypt_keyed(enc, (const char*)raw, raw_len, public);
+  }else if(opt->compact){
+    ECIES_encrypt_compact(enc, (const char*)raw, raw_len, public);
+  }else{
+    ECIES_encrypt(enc, (const char*)raw, raw_len, public);
+  }
+  output_commit(out, raw_len + overhead);
+  
+  free(heap);
+#endif/*CHUNKED*/
+
+  return 0;
+}
+
+/* load comma separated x:y keys */
+static int load_pubkeys(ECIES_pubkey_t *keys, ECIES_size_t n, const char *list){
+  ECIES_size_t i;
+  int r;
+  
+  for(i = 0; i < n; i++, list += r + 1){
+    r = hex_load(keys[i].x, ECIES_KEY_SIZE, list);
+    if(0 > r || list[r] != ':'){
+      fprintf(stderr, "Invalid public key x\n");
+      return -1;
+    }
+    list += r + 1;
+    r = hex_load(keys[i].y, ECIES_KEY_SIZE, list);
+    if(0 > r || (list[r] != ',' && list[r] != '\0')){
+      fprintf(stderr, "Invalid public key y\n");
+      return -1;
+    }
+  }
+  
+  return 0;
+}
+
+static int encrypt(const char *pubkey, const options_t *opt){
+  ECIES_pubkey_t public = {
+    { 0x01, 0xc5, 0x6d, 0x30, 0x2c, 0xf6, 0x42, 0xa8, 0xe1, 0xba, 0x4b, 0x48, 0xcc, 0x4f, 0xbe, 0x28, 0x45, 0xee, 0x32, 0xdc, 0xe7 },
+    { 0x04, 0x5f, 0x46, 0xeb, 0x30, 0x3e, 0xdf, 0x2e, 0x62, 0xf7, 0x4b, 0xd6, 0x83, 0x68, 0xd9, 0x79, 0xe2, 0x65, 0xee, 0x3c, 0x03 },
+  };
+  ECIES_pubkey_t *keys = &public;
+  ECIES_size_t n = 1;
+  ECIES_store_t *store = NULL;
+  const ECIES_pubkey_table_t **tabs = NULL;
+  input_t in;
+  output_t out;
+  int res;
+  
+  if(pubkey){
+    const char *c;
+    
+    for(c = pubkey; *c; c++){
+      n += *c == ',';
+    }
+    
+    if(n > ECIES_MULTI_MAX){
+      fprintf(stderr, "Too many public keys\n");
+      return 1;
+    }
+    
+    if(n > 1 && (opt->compact || opt->keyed)){
+      fprintf(stderr, "Compact and keyed start sequences are single-recipient\n");
+      return 1;
+    }
+    
+    if(n > 1 && !(keys = malloc(n * sizeof(ECIES_pubkey_t)))){
+      fprintf(stderr, "Out of memory\n");
+      return 1;
+    }
+    
+    if(load_pubkeys(keys, n, pubkey) < 0){
+      if(keys != &public){
+        free(keys);
+      }
+      return 1;
+    }
+  }
+  
+  /* keys missing from the store are used as given */
+  if(opt->store){
+    if(!(store = ECIES_store_open(opt->store))){
+      fprintf(stderr, "Invalid store %s\n", opt->store);
+      res = 1;
+      goto done;
+    }
+    if(!(tabs = malloc(n * sizeof(*tabs)))){
+      fprintf(stderr, "Out of memory\n");
+      res = 1;
+      goto done;
+    }
+    if(!store_lookup(store, tabs, keys, n)){
+      free(tabs);
+      tabs = NULL;
+    }
+  }
+  
+  if(input_open(&in, opt->input) < 0){
+    res = 1;
+    goto done;
+  }
+  
+  memset(&out, 0, sizeof(out));
+  out.fd = -1;
+  
+  res = encrypt_io(&in, &out, opt, keys, n, tabs);
+  
+  if(out.fd >= 0 && output_close(&out) < 0){
+    res = -1;
+  }
+  input_close(&in);
+  
+ done:
+  free(tabs);
+  if(store){
+    ECIES_store_close(store);
+  }
+  if(keys != &public){
+    free(keys);
+  }
+  
+  return res;
+}
+
+/* prepare the tables of the x:y public keys in input, one per line, into a store file */
+static int build_store(const char *path, const options_t *opt){
+  FILE *f = opt->input ? fopen(opt->input, "r") : stdin;
+  char line[4 * ECIES_KEY_SIZE + 16];
+  ECIES_pubkey_t *keys = NULL, *grown;
+  size_t n = 0, room = 0;
+  unsigned long lineno = 0;
+  int jobs = opt->jobs;
+  long res = 0;
+  
+  if(!path){
+    fprintf(stderr, "No store file\n");
+    return 1;
+  }
+  
+  if(!f){
+    fprintf(stderr, "Cannot open %s\n", opt->input);
+    return 1;
+  }
+  
+  while(fgets(line, sizeof(line), f)){
+    lineno++;
+    line[strcspn(line, "\r\n")] = '\0';
+    if(!line[0]){
+      continue;
+    }
+    
+    if(n == room){
+      room = room ? 2 * room : 1024;
+      if(!(grown = realloc(keys, room * sizeof(ECIES_pubkey_t)))){
+        fprintf(stderr, "Out of memory\n");
+        res = -1;
+        break;
+      }
+      keys = grown;
+    }
+    
+    if(load_pubkeys(&keys[n], 1, line) < 0){
+      fprintf(stderr, "at line %lu\n", lineno);
+      res = -1;
+      break;
+    }
+    n++;
+  }
+  
+  if(f != stdin){
+    fclose(f);
+  }
+  
+#if THREADS
+  if(jobs < 1){
+    jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  }
+#else
+  jobs = 1;
+#endif
+  
+  if(res == 0){
+    res = ECIES_store_build(path, keys, n, jobs);
+    if(res == -2){
+      fprintf(stderr, "Invalid public key\n");
+    }else if(res < 0){
+      fprintf(stderr, "Cannot write %s\n", path);
+    }else{
+      fprintf(stderr, "%ld keys stored\n", res);
+    }
+  }
+  
+  free(keys);
+  
+  return res < 0;
+}
+
+#if CHUNKED
+
+/* read the start sequence, 'start' gets its size including the tag of a seekable or framed stream */
+static int decrypt_head(input_t *in, ECIES_stream_t *stm, size_t *start, int *indexed, int *framed, const ECIES_privkey_t *private){
+  ECIES_byte_t head[ECIES_START_OVERHEAD], *enc = head;
+  int n, res;
+  
+  *start = ECIES_START_OVERHEAD;
+  *indexed = 0;
+  *framed = 0;
+  
+  if(input_read(in, head, 1) < 1){
+    return -1;
+  }
+  
+  if(head[0] == ECIES_INDEXED_TAG || head[0] == ECIES_FRAMED_TAG){
+    *indexed = head[0] == ECIES_INDEXED_TAG;
+    *framed = head[0] == ECIES_FRAMED_TAG;
+    if(input_read(in, head, 1) < 1){
+      return -1;
+    }
+  }
+  
+  /* the first bytes tell a multi-recipient start sequence and its size */
+  if(input_read(in, head + 1, 2) < 2){
+    return -1;
+  }
+  
+  if((n = ECIES_multi_count(head)) > 0){
+    *start = ECIES_MULTI_START_OVERHEAD(n);
+    if(!(enc = malloc(*start))){
+      return -1;
+    }
+    memcpy(enc, head, 3);
+  }else if((res = ECIES_start_size(head)) < 0){
+    return -1;
+  }else{
+    *start = res;
+  }
+  
+  res = input_read(in, enc + 3, *start - 3);
+  
+  if((size_t)res < *start - 3){
+    res = -1;
+  }else if(n > 0){
+    res = ECIES_decrypt_start_multi(stm, enc, private);
+  }else{
+    res = ECIES_decrypt_start(stm, enc, private);
+  }
+  
+  if(enc != head){
+    free(enc);
+  }
+  
+  *start += *indexed || *framed;
+  
+  return res;
+}
+
+/* check the index trailer of a mapped seekable stream and leave it out of the data */
+static int decrypt_index(input_t *in, const ECIES_stream_t *stm, size_t start, ECIES_size_t *chunk_size, uint64_t *length){
+  uint64_t chunks;
+  int res;
+  
+  if(in->end < start + ECIES_INDEX_SIZE){
+    return -1;
+  }
+  
+  in->end -= ECIES_INDEX_SIZE;
+  
+  if((res = ECIES_index_decode(stm, in->map + in->end, chunk_size, length)) < 0){
+    fprintf(stderr, "Invalid chunk index\n");
+    return res;
+  }
+  
+  chunks = (*length + *chunk_size - 1) / *chunk_size;
+  
+  if(chunks >= 0xffffffff || in->end - start != *length + chunks * ECIES_CHUNK_OVERHEAD){
+    fprintf(stderr, "Stream size mismatch\n");
+    return -1;
+  }
+  
+  return 0;
+}
+
+/* every chunk must be authentic, a legacy chunk carries its own MAC too, only its position isn't bound */
+static int decrypt_chunk(const ECIES_stream_t *stm, int indexed, ECIES_size_t index, ECIES_byte_t *msg, ECIES_size_t len){
+  int res;
+  
+  if(indexed){
+    res = ECIES_decrypt_chunk_at(stm, index, msg, len);
+  }else{
+    res = ECIES_decrypt_chunk(stm, msg, len);
+  }
+  
+  if(res < 0){
+    fprintf(stderr, "Chunk %u is corrupted\n", index);
+    return -2;
+  }
+  
+  return 1;
+}
+
+/* decrypt only the chunks which cover the range, the offsets follow from the chunk size */
+static int decrypt_range(input_t *in, output_t *out, const options_t *opt, const ECIES_stream_t *stm, size_t start, ECIES_size_t chunk_size, uint64_t length){
+  ECIES_byte_t *buf;
+  ECIES_size_t index, len, lo, hi;
+  uint64_t pos, from = opt->from, to = opt->to;
+  int res = 0;
+  
+  if(to > length){
+    to = length;
+  }
+  
+  if(from > to){
+    from = to;
+  }
+  
+  if(output_open(out, opt, to - from) < 0){
+    return -1;
+  }
+  
+  if(!(buf = malloc(chunk_size + ECIES_CHUNK_OVERHEAD))){
+    fprintf(stderr, "Out of memory\n");
+    return -1;
+  }
+  
+  madvise((void*)in->map, in->size, MADV_RANDOM);
+  
+  for(index = from / chunk_size; (pos = (uint64_t)index * chunk_size) < to; index++){
+    len = length - pos < chunk_size ? length - pos : chunk_size;
+    
+    memcpy(buf, in->map + start + (uint64_t)index * (chunk_size + ECIES_CHUNK_OVERHEAD), len + ECIES_CHUNK_OVERHEAD);
+    
+    if((res = decrypt_chunk(stm, 1, index, buf, len)) < 0){
+      break;
+    }
+    
+    lo = from > pos ? from - pos : 0;
+    hi = to - pos < len ? to - pos : len;
+    
+    if((res = output_write(out, buf + lo, hi - lo)) < 0){
+      break;
+    }
+  }
+  
+  free(buf);
+  
+  return res < 0 ? res : 0;
+}
+
+/* a seekable stream from a pipe, the index trailer shows up only at its end */
+static int decrypt_indexed_pipe(input_t *in, output_t *out, const ECIES_stream_t *stm){
+  ECIES_byte_t buf[CHUNK_SIZE + ECIES_CHUNK_OVERHEAD + ECIES_INDEX_SIZE];
+  ECIES_size_t index, chunk_size;
+  uint64_t length, total = 0;
+  int len, have = 0, res;
+  
+  for(index = 0; ; index++){
+    /* keep the last bytes back, they may be the trailer */
+    if((len = input_read(in, buf + have, sizeof(buf) - have)) < 0){
+      return -1;
+    }
+    
+    have += len;
+    
+    if(have <= ECIES_INDEX_SIZE){
+      break;
+    }
+    
+    len = have - ECIES_INDEX_SIZE;
+    
+    if(len > CHUNK_SIZE + ECIES_CHUNK_OVERHEAD){
+      len = CHUNK_SIZE + ECIES_CHUNK_OVERHEAD;
+    }
+    
+    if(len < ECIES_CHUNK_OVERHEAD){
+      return -1;
+    }
+    
+    if((res = decrypt_chunk(stm, 1, index, buf, len - ECIES_CHUNK_OVERHEAD)) < 0){
+      return res;
+    }
+    
+    if(output_write(out, buf, len - ECIES_CHUNK_OVERHEAD) < 0){
+      return -1;
+    }
+    
+    total += len - ECIES_CHUNK_OVERHEAD;
+    have -= len;
+    memmove(buf, buf + len, have);
+  }
+  
+  if(have < ECIES_INDEX_SIZE || (res = ECIES_index_decode(stm, buf, &chunk_size, &length)) < 0 ||
+     chunk_size != CHUNK_SIZE || length != total){
+    fprintf(stderr, "Invalid chunk index\n");
+    return -1;
+  }
+  
+  return 0;
+}
+
+/* frames of any size, each one read whole after its header */
+static int decrypt_frames(input_t *in, output_t *out, const ECIES_stream_t *stm){
+  ECIES_byte_t head[ECIES_FRAME_HEADER], *frame;
+  ECIES_size_t index;
+  int len;
+  
+  for(index = 0; ; index++){
+    if(input_read(in, head, ECIES_FRAME_HEADER) < ECIES_FRAME_HEADER){
+      fprintf(stderr, "Stream is truncated\n");
+      return -1;
+    }
+    
+    if((len = ECIES_frame_length(head)) < 0){
+      fprintf(stderr, "Chunk %u is corrupted\n", index);
+      return len;
+    }
+    
+    /* the raw data is moved over the header after the decryption in place */
+    if(!(frame = output_reserve(out, len + ECIES_FRAME_OVERHEAD))){
+      return -1;
+    }
+    
+    memcpy(frame, head, ECIES_FRAME_HEADER);
+    
+    if(input_read(in, frame + ECIES_FRAME_HEADER, len + ECIES_CHUNK_OVERHEAD) < len + ECIES_CHUNK_OVERHEAD){
+      fprintf(stderr, "Stream is truncated\n");
+      return -1;
+    }
+    
+    if((len = ECIES_decrypt_frame(stm, index, frame)) < 0){
+      fprintf(stderr, "Chunk %u is corrupted\n", index);
+      return len;
+    }
+    
+    if(len == 0){
+      break; /* the empty frame ends the stream */
+    }
+    
+    memmove(frame, frame + ECIES_FRAME_HEADER, len);
+    output_commit(out, len);
+    
+    /* the sender waits, pass on what there is */
+    if(!input_ready(in) && output_flush(out) < 0){
+      return -1;
+    }
+  }
+  
+  if(input_read(in, head, 1) != 0){
+    fprintf(stderr, "Data after the end of stream\n");
+    return -1;
+  }
+  
+  return 0;
+}
+
+#endif/*CHUNKED*/
+
+static int decrypt_io(input_t *in, output_t *out, const options_t *opt, const ECIES_privkey_t *private){
+#if CHUNKED
+  ECIES_stream_t stm;
+  ECIES_byte_t *raw;
+  ECIES_size_t index, chunk_size = CHUNK_SIZE;
+  uint64_t length = 0;
+  size_t start;
+  int len, indexed, framed;
+  
+  if((len = decrypt_head(in, &stm, &start, &indexed, &framed, private)) < 0){
+    return len;
+  }
+  
+  if(indexed && in->map && (len = decrypt_index(in, &stm, start, &chunk_size, &length)) < 0){
+    return len;
+  }
+  
+  if(opt->range){
+    if(!indexed || !in->map){
+      fprintf(stderr, "Range needs a seekable input file\n");
+      return -1;
+    }
+    return decrypt_range(in, out, opt, &stm, start, chunk_size, length);
+  }
+  
+  if(framed){
+    if(output_open(out, opt, SIZE_UNKNOWN) < 0){
+      return -1;
+    }
+    return decrypt_frames(in, out, &stm);
+  }
+  
+  if(chunk_size != CHUNK_SIZE){
+    fprintf(stderr, "Chunk size mismatch\n");
+    return -1;
+  }
+  
+  if(output_open(out, opt, chunked_size(input_size(in), start, 1)) < 0){
+    return -1;
+  }
+  
+  if(indexed && !in->map){
+    return decrypt_indexed_pipe(in, out, &stm);
+  }
+
+#if THREADS
+  if(opt->jobs > 1){
+    return pipeline_run(&stm, in, out, 1, indexed, opt->jobs, &length);
+  }
+#endif
+
+  for(index = 0; ; index++){
+    if(out->mapped && out->size - out->pos < CHUNK_SIZE + ECIES_CHUNK_OVERHEAD){
+      /* the MAC of the last chunks would run past the end of the mapping */
+      ECIES_byte_t tail[CHUNK_SIZE + ECIES_CHUNK_OVERHEAD];
+      
+      if((len = input_read(in, tail, sizeof(tail))) == 0){
+        break; /*eof*/
+      }
+      
+      if(len < ECIES_CHUNK_OVERHEAD || decrypt_chunk(&stm, indexed, index, tail, len - ECIES_CHUNK_OVERHEAD) < 0){
+        return -1;
+      }
+      
+      if(output_write(out, tail, len - ECIES_CHUNK_OVERHEAD) < 0){
+        return -1;
+      }
+      continue;
+    }
+    
+    /* read straight into the output, the chunk is decrypted in place */
+    if(!(raw = output_reserve(out, CHUNK_SIZE + ECIES_CHUNK_OVERHEAD))){
+      return -1;
+    }
+    
+    len = input_read(in, raw, CHUNK_SIZE + ECIES_CHUNK_OVERHEAD);
+    
+    if(len == 0){
+      break; /*eof*/
+    }
+    
+    if(len < ECIES_CHUNK_OVERHEAD || decrypt_chunk(&stm, indexed, index, raw, len - ECIES_CHUNK_OVERHEAD) < 0){
+      return -1;
+    }
+    
+    output_commit(out, len - ECIES_CHUNK_OVERHEAD);
+  }
+#else/*CHUNKED*/
+  const ECIES_byte_t *enc;
+  ECIES_byte_t *heap, *raw;
+  int raw_len, enc_len, res, n = -1, overhead = ECIES_OVERHEAD;
+  
+  if(opt->range){
+    fprintf(stderr, "Seekable streams are chunked\n");
+    return -1;
+  }
+  
+  enc_len = input_all(in, &enc, &heap);
+  
+  if(enc_len >= 3 && (n = ECIES_multi_count(enc)) > 0){
+    overhead = ECIES_MULTI_START_OVERHEAD(n) + ECIES_CHUNK_OVERHEAD;
+  }else if(enc_len >= 1 && ECIES_start_size(enc) > 0){
+    overhead = ECIES_start_size(enc) + ECIES_CHUNK_OVERHEAD;
+  }
+  
+  if(enc_len < overhead){
+    free(heap);
+    return -1;
+  }
+  
+  raw_len = enc_len - overhead;
+  
+  if(output_open(out, opt, raw_len) < 0 || !(raw = output_reserve(out, raw_len))){
+    free(heap);
+    return -1;
+  }
+  
+  if(n > 0){
+    res = ECIES_decrypt_multi((char*)raw, raw_len, enc, private);
+  }else{
+    res = ECIES_decrypt((char*)raw, raw_len, enc, private);
+  }
+  
+  if(res < 0){
+    fprintf(stderr, "Decryption failed %d\n", res);
+    
+    free(heap);
+    
+    return 1;
+  }
+  
+  output_commit(out, raw_len);
+  
+  free(heap);
+#endif/*CHUNKED*/
+
+  return 0;
+}
+
+static int decrypt(const char *privkey, const options_t *opt){
+  ECIES_privkey_t private = {
+    { 0x00, 0xe1, 0x0e, 0x78, 0x70, 0x36, 0x94, 0x1e, 0x6c, 0x78, 0xda, 0xf8, 0xa0, 0xe8, 0xe1, 0xdb, 0xfa, 0xc6, 0x8e, 0x26, 0xd2 },
+  };
+  input_t in;
+  output_t out;
+  int res;
+  
+  if(privkey){
+    if(0 > hex_load(private.k, ECIES_KEY_SIZE, privkey)){
+      fprintf(stderr, "Invalid private key\n");
+      return 1;
+    }
+  }
+  
+  if(input_open(&in, opt->input) < 0){
+    return 1;
+  }
+  
+  memset(&out, 0, sizeof(out));
+  out.fd = -1;
+  
+  res = decrypt_io(&in, &out, opt, &private);
+  
+  if(out.fd >= 0 && output_close(&out) < 0){
+    res = -1;
+  }
+  input_close(&in);
+  
+  return res;
+}
+
+/*
+ * Benchmark: every test gets a warm-up which also sizes its repetitions to
+ * about 'millis' each, then 'reps' repetitions on 1, 2, 4 ... 'jobs' threads.
+ * The repetitions are timed as a whole for the throughput, one more pass then
+ * times every operation into a fixed histogram for the latency percentiles.
+ */
+
+#define BENCH_KEYGEN 0
+#define BENCH_ENCRYPT_START 1
+#define BENCH_DECRYPT_START 2
+#define BENCH_CHUNK_ENCRYPT 3
+#define BENCH_CHUNK_DECRYPT 4
+#define BENCH_TESTS 5
+
+static const char *const bench_names[BENCH_TESTS] = {
+  "keygen", "encrypt_start", "decrypt_start", "chunk_encrypt", "chunk_decrypt"
+};
+
+static const size_t bench_sizes[] = { 64, 1024, CHUNK_SIZE, 64 * 1024, 1024 * 1024 };
+
+#define BENCH_SIZES (sizeof(bench_sizes) / sizeof(bench_sizes[0]))
+
+/* latency buckets: exact below 16 ns, then 16 per power of two (within 6%) */
+#define BENCH_SUB 16
+#define BENCH_BUCKETS ((64 - 3) * BENCH_SUB)
+
+/* shared read-only by all threads */
+static struct {
+  ECIES_privkey_t priv;
+  ECIES_pubkey_t pub;
+  ECIES_stream_t stm;
+  ECIES_byte_t start[ECIES_START_OVERHEAD];
+} bench;
+
+typedef struct {
+  int test;
+  size_t size;
+  long iters;
+  int timed;                  /* fill 'hist' and 'max' */
+  unsigned long long hist[BENCH_BUCKETS], max;
+  ECIES_byte_t *buf, *enc;
+#if THREADS
+  pthread_barrier_t *go;
+#endif
+} bench_job_t;
+
+static unsigned long long bench_now(void){
+  struct timespec ts;
+  
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int bench_bucket(unsigned long long ns){
+  int e = 4;
+  
+  if(ns < BENCH_SUB){
+    return ns;
+  }
+  while(ns >> (e + 1)){
+    e++;
+  }
+  
+  return (e - 3) * BENCH_SUB + (ns >> (e - 4) & (BENCH_SUB - 1));
+}
+
+/* the lowest latency falling into bucket 'b' */
+static unsigned long long bench_floor(int b){
+  if(b < BENCH_SUB){
+    return b;
+  }
+  
+  return (unsigned long long)(BENCH_SUB + b % BENCH_SUB) << (b / BENCH_SUB - 1);
+}
+
+/* the latency below which 'pct' percent of the 'count' operations fall */
+static unsigned long long bench_pct(const unsigned long long *hist, long count, int pct){
+  long rank = count * pct / 100, seen = 0;
+  int b;
+  
+  for(b = 0; b < BENCH_BUCKETS; b++){
+    if((seen += hist[b]) > rank){
+      break;
+    }
+  }
+  
+  return bench_floor(b < BENCH_BUCKETS ? b : BENCH_BUCKETS - 1);
+}
+
+static void *bench_thread(void *arg){
+  bench_job_t *job = arg;
+  ECIES_privkey_t priv;
+  ECIES_pubkey_t pub;
+  ECIES_stream_t stm;
+  ECIES_byte_t start[ECIES_START_OVERHEAD];
+  unsigned long long t = 0;
+  long i;
+  
+#if THREADS
+  if(job->go){
+    pthread_barrier_wait(job->go);
+  }
+#endif
+  
+  for(i = 0; i < job->iters; i++){
+    if(job->test == BENCH_CHUNK_DECRYPT){
+      /* decryption is in place, restore the ciphertext untimed */
+      memcpy(job->buf, job->enc, job->size + ECIES_CHUNK_OVERHEAD);
+    }
+    if(job->timed){
+      t = bench_now();
+    }
+    switch(job->test){
+    case BENCH_KEYGEN:
+      ECIES_generate_keys(&priv, &pub);
+      break;
+    case BENCH_ENCRYPT_START:
+      ECIES_encrypt_start(&stm, start, &bench.pub);
+      break;
+    case BENCH_DECRYPT_START:
+      ECIES_decrypt_start(&stm, bench.start, &bench.priv);
+      break;
+    case BENCH_CHUNK_ENCRYPT:
+      ECIES_encrypt_chunk(&bench.stm, job->buf, job->size);
+      break;
+    default:
+      ECIES_decrypt_chunk(&bench.stm, job->buf, job->size);
+      break;
+    }
+    if(job->timed){
+      t = bench_now() - t;
+      job->hist[bench_bucket(t)]++;
+      job->max = t > job->max ? t : job->max;
+    }
+  }
+  
+  return NULL;
+}
+
+/* one repetition, returns the wall time in ns */
+static unsigned long long bench_rep(bench_job_t *jobs, int threads){
+  unsigned long long t;
+#if THREADS
+  pthread_barrier_t go;
+  pthread_t tid[threads];
+  int i;
+  
+  if(threads > 1){
+    pthread_barrier_init(&go, NULL, threads + 1);
+    for(i = 0; i < threads; i++){
+      jobs[i].go = &go;
+      pthread_create(&tid[i], NULL, bench_thread, &jobs[i]);
+    }
+    pthread_barrier_wait(&go);
+    t = bench_now();
+    for(i = 0; i < threads; i++){
+      pthread_join(tid[i], NULL);
+    }
+    t = bench_now() - t;
+    pthread_barrier_destroy(&go);
+    return t;
+  }
+  
+  jobs[0].go = NULL;
+#endif
+  
+  t = bench_now();
+  bench_thread(&jobs[0]);
+  
+  return bench_now() - t;
+}
+
+static int bench_cmpd(const void *a, const void *b){
+  double x = *(const double*)a, y = *(const double*)b;
+  
+  return x < y ? -1 : x > y;
+}
+
+static int bench_test(int test, size_t size, int threads, const options_t *opt, int first){
+  bench_job_t *jobs = calloc(threads, sizeof(bench_job_t));
+  unsigned long long hist[BENCH_BUCKETS] = { 0 }, max = 0, wall;
+  double *rate = calloc(opt->reps, sizeof(double)), scale;
+  long iters, timed;
+  int i, b, r, res = -1;
+  
+  if(!jobs || !rate){
+    free(jobs);
+    free(rate);
+    return -1;
+  }
+  
+  for(i = 0; i < threads; i++){
+    jobs[i].test = test;
+    jobs[i].size = size;
+    jobs[i].buf = malloc(size + ECIES_CHUNK_OVERHEAD);
+    jobs[i].enc = malloc(size + ECIES_CHUNK_OVERHEAD);
+    if(!jobs[i].buf || !jobs[i].enc){
+      goto done;
+    }
+    memset(jobs[i].enc, 0x5a, size);
+    ECIES_encrypt_chunk(&bench.stm, jobs[i].enc, size);
+    memcpy(jobs[i].buf, jobs[i].enc, size + ECIES_CHUNK_OVERHEAD);
+  }
+  
+  /* warm-up, doubling until it takes a tenth of a repetition */
+  for(iters = 1; ; iters *= 2){
+    jobs[0].iters = iters;
+    wall = bench_rep(jobs, 1);
+    if(wall * 10 >= opt->millis * 1000000ULL){
+      break;
+    }
+  }
+  
+  iters = iters * (opt->millis * 1000000ULL) / (wall > 0 ? wall : 1);
+  iters = iters > 0 ? iters : 1;
+  
+  for(i = 0; i < threads; i++){
+    jobs[i].iters = iters;
+  }
+  
+  for(r = 0; r < opt->reps; r++){
+    wall = bench_rep(jobs, threads);
+    rate[r] = (double)threads * iters * 1e9 / (wall > 0 ? wall : 1);
+  }
+  
+  /* the latency pass, one more repetition with every operation timed */
+  for(i = 0; i < threads; i++){
+    jobs[i].timed = 1;
+  }
+  bench_rep(jobs, threads);
+  for(i = 0; i < threads; i++){
+    for(b = 0; b < BENCH_BUCKETS; b++){
+      hist[b] += jobs[i].hist[b];
+    }
+    max = jobs[i].max > max ? jobs[i].max : max;
+  }
+  timed = threads * iters;
+  
+  qsort(rate, opt->reps, sizeof(*rate), bench_cmpd);
+  
+  /* chunk tests report GB/s, the others operations per second */
+  scale = test >= BENCH_CHUNK_ENCRYPT ? size / 1e9 : 1;
+  
+  printf("%s    { \"test\": \"%s\", \"threads\": %d, \"size\": %lu, \"ops\": %ld,\n"
+         "      \"%s\": { \"median\": %.6g, \"min\": %.6g, \"max\": %.6g },\n"
+         "      \"latency_ns\": { \"median\": %llu, \"p99\": %llu, \"max\": %llu } }",
+         first ? "" : ",\n", bench_names[test], threads, (unsigned long)size, opt->reps * timed,
+         test >= BENCH_CHUNK_ENCRYPT ? "gb_per_sec" : "ops_per_sec",
+         rate[opt->reps / 2] * scale, rate[0] * scale, rate[opt->reps - 1] * scale,
+         bench_pct(hist, timed, 50), bench_pct(hist, timed, 99), max);
+  fflush(stdout);
+  res = 0;
+  
+ done:
+  for(i = 0; i < threads; i++){
+    free(jobs[i].buf);
+    free(jobs[i].enc);
+  }
+  free(jobs);
+  free(rate);
+  
+  if(res < 0){
+    fprintf(stderr, "Out of memory\n");
+  }
+  
+  return res;
+}
+
+static int benchmark(const options_t *opt){
+  ECIES_config_t cfg;
+  int test, threads, first = 1, max = opt->jobs;
+  size_t i;
+  
+#if THREADS
+  if(max < 1){
+    max = sysconf(_SC_NPROCESSORS_ONLN);
+  }
+#else
+  max = 1;
+#endif
+  
+  if(max < 1){
+    max = 1;
+  }
+  
+  ECIES_generate_keys(&bench.priv, &bench.pub);
+  ECIES_encrypt_start(&bench.stm, bench.start, &bench.pub);
+  
+  ECIES_config_get(&cfg);
+  
+  if(!ECIES_CONFIG_MATCHES(&cfg)){
+    fprintf(stderr, "Library built with another profile\n");
+    return -1;
+  }
+  
+  printf("{\n  \"chunk_size\": %d,\n  \"profile\": \"%s\",\n  \"comb_width\": %d,\n  \"threads\": %d,\n"
+         "  \"reps\": %d,\n  \"millis\": %d,\n  \"compiler\": \"%s\",\n  \"results\": [\n",
+         CHUNK_SIZE, cfg.profile, cfg.comb_width, max, opt->reps, opt->millis,
+#ifdef __VERSION__
+         __VERSION__
+#else
+         "unknown"
+#endif
+         );
+  
+  /* 1, 2, 4 ... max threads, max itself included */
+  for(threads = 1; ; threads = threads * 2 < max ? threads * 2 : max){
+    for(test = 0; test < BENCH_TESTS; test++){
+      if(test < BENCH_CHUNK_ENCRYPT){
+        if(bench_test(test, 0, threads, opt, first) < 0){
+          return -1;
+        }
+        first = 0;
+        continue;
+      }
+      for(i = 0; i < BENCH_SIZES; i++){
+        if(bench_test(test, bench_sizes[i], threads, opt, first) < 0){
+          return -1;
+        }
+        first = 0;
+      }
+    }
+    if(threads == max){
+      break;
+    }
+  }
+  
+  printf("\n  ]\n}\n");
+  
+  return 0;
+}
+
+int main(int argc, const char *argv[]){
+  options_t opt = { NULL, NULL, 0, 5, 100, 0, 0, 0, 0, OUTPUT_BINARY, NULL, 0, 0, 0 };
+  const char *param = NULL;
+  int i;
+  
+  if(argc < 2) goto usage;
+  
+  for(i = 2; i < argc; i++){
+    if(!strcmp(argv[i], "-j") && i + 1 < argc){
+      opt.jobs = atoi(argv[++i]);
+      if(opt.jobs < 1){
+        goto usage;
+      }
+    }else if(!strcmp(argv[i], "-r") && i + 1 < argc){
+      opt.reps = atoi(argv[++i]);
+      if(opt.reps < 1){
+        goto usage;
+      }
+    }else if(!strcmp(argv[i], "-t") && i + 1 < argc){
+      opt.millis = atoi(argv[++i]);
+      if(opt.millis < 1){
+        goto usage;
+      }
+    }else if(!strcmp(argv[i], "-i") && i + 1 < argc){
+      opt.input = argv[++i];
+    }else if(!strcmp(argv[i], "-o") && i + 1 < argc){
+      opt.output = argv[++i];
+    }else if(!strcmp(argv[i], "--hex")){
+      opt.encoding = OUTPUT_HEX;
+    }else if(!strcmp(argv[i], "--base64")){
+      opt.encoding = OUTPUT_BASE64;
+    }else if(!strcmp(argv[i], "--store") && i + 1 < argc){
+      opt.store = argv[++i];
+    }else if(!strcmp(argv[i], "--compact")){
+      opt.compact = 1;
+    }else if(!strcmp(argv[i], "--keyed")){
+      opt.keyed = 1;
+    }else if(!strcmp(argv[i], "--framed")){
+      opt.framed = 1;
+    }else if(!strcmp(argv[i], "--seekable")){
+      opt.seekable = 1;
+    }else if(!strcmp(argv[i], "--range") && i + 1 < argc){
+      char *end;
+      
+      opt.range = 1;
+      opt.from = strtoull(argv[++i], &end, 10);
+      if(*end++ != '-'){
+        goto usage;
+      }
+      opt.to = *end ? strtoull(end, &end, 10) : (uint64_t)-1;
+      if(*end || opt.to < opt.from){
+        goto usage;
+      }
+    }else{
+      param = argv[i];
+    }
+  }
+  
+  switch(argv[1][0]){
+  case 'k':
+    return keygen(param);
+  case 'e':
+    return encrypt(param, &opt);
+  case 'd':
+    return decrypt(param, &opt);
+  case 'b':
+    return benchmark(&opt);
+  case 's':
+    return build_store(param, &opt);
+  default:
+    goto usage;
+  }
+
  usage:
-  fprintf(stderr, "Usage: %s <command> [parameters]\n"
+  fprintf(stderr, "Usage: %s <command> [options] [parameters]\n"
           "  [k]eygen [random-seed] -- generate public/private key pair\n"
-          "  [e]ncrypt [public-key-x:public-key-y] -- encrypt stdin to stdout using public key\n"
-          "  [d]ecrypt [private-key] -- decript stdin to stdout using private key\n", argv[0]);
+          "  [e]ncrypt [public-key-x:public-key-y[,...]] -- encrypt input to output using public key(s)\n"
+          "  [d]ecrypt [private-key] -- decript input to output using private key\n"
+          "  [b]enchmark -- measure keygen, start and chunk speed, print JSON\n"
+          "  [s]tore file -- prepare the tables of the x:y public keys in input, one per line, into a store file\n"
+          "Options:\n"
+          "  -i file -- read file instead of stdin\n"
+          "  -o file -- write file instead of stdout\n"
+          "  -j N -- process chunks or build a store with N threads, benchmark up to N threads (all CPUs)\n"
+          "  -r N -- benchmark repetitions (5)\n"
+          "  -t ms -- benchmark time per repetition (100)\n"
+          "  --hex, --base64 -- write the output as text\n"
+          "  --store file -- encrypt with the prepared tables of a store file\n"
+          "  --compact -- encrypt with the compressed 22 byte start sequence, one public key only\n"
+          "  --keyed -- encrypt with the 26 byte start sequence naming the key ID, one public key only\n"
+          "  --seekable -- encrypt with chunk index, for random access\n"
+          "  --framed -- encrypt in frames carrying their size, small while the input waits, growing for bulk data\n"
+          "  --range A-B -- decrypt only bytes A up to B (excluded, end of data when omitted) of a seekable file\n", argv[0]);
   
   return 0;
 }